@@ -0,0 +1,421 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Headless batch renderer: runs a preset of PingPongDelayAudioProcessor over many WAV/FLAC files at once.
+
+     Every worker thread owns one processor (built without its editor, PINGPONG_HEADLESS) and one format manager,
+     and the files are spread over the workers by a work-stealing pool (WorkStealingPool.h). The workers share
+     nothing while they render, so the throughput grows with the number of cores until the disk can't keep up.
+
+     Each file is read a chunk at a time and every chunk goes through processBlock in blocks of --block samples,
+     the same calls a host would make. The processor runs in non-realtime mode, so the delay line is resized right
+     away instead of on the background thread, and the output of a file only depends on the file, the preset and
+     the block size. Written as 32-bit float WAV (the default) it is bit-identical to calling processBlock yourself.
+
+     WAV input is memory mapped one chunk at a time and the output is written as each chunk is done, so hours of
+     multitrack audio render in the same memory as a few seconds. With --tail the delay keeps running after the end
+     of each file until its echoes have decayed (getTailLengthSeconds, at most --max-tail seconds).
+
+     Usage: PingPongBatchRender [--preset <file>] [--set <parameter>=<value>]... [--output <folder>]
+                                [--threads <n>] [--block <samples>] [--chunk <samples>] [--no-mmap]
+                                [--tail] [--max-tail <seconds>]
+                                [--format wav|flac] [--bits 16|24|32] <file or folder>...
+
+  ==============================================================================
+*/
+
+#include "../../Source/PluginProcessor.h"
+#include "WorkStealingPool.h"
+
+#include <iostream>
+
+//==============================================================================
+
+namespace
+{
+    struct RenderOptions
+    {
+        File presetFile;
+        StringPairArray parameterValues;
+        File outputFolder = File::getCurrentWorkingDirectory().getChildFile ("rendered");
+        int numThreads = SystemStats::getNumCpus();
+        int blockSize = 512;
+        int chunkSize = 65536;
+        String format = "wav";
+        int bitsPerSample = 32;
+        bool memoryMap = true;
+        bool renderTail = false;
+        double maximumTailSeconds = 600.0;
+        StringArray inputs;
+    };
+
+    /*One file to render, and how it went*/
+    struct RenderJob
+    {
+        File input;
+        File output;
+        int64 lengthInSamples = 0;
+        double sampleRate = 0.0;
+
+        bool succeeded = false;
+        String error;
+        int64 renderedSamples = 0;
+        double renderSeconds = 0.0;
+    };
+
+    /*What every worker keeps for itself*/
+    struct RenderWorker
+    {
+        PingPongDelayAudioProcessor processor;
+        AudioFormatManager formatManager;
+        AudioBuffer<float> chunk;
+        MidiBuffer midiMessages;
+    };
+
+    //==============================================================================
+
+    /*Sets a parameter through the value tree state, exactly like host automation would*/
+    void setParameter (PingPongDelayAudioProcessor& processor, const String& paramID, float value)
+    {
+        if (auto* parameter = processor.parameters.apvts.getParameter (paramID))
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+    }
+
+    /*The preset is either the XML of the plugin's state or the binary blob that getStateInformation writes
+    (a host's saved plugin state), both go through setStateInformation*/
+    bool loadPreset (const File& presetFile, MemoryBlock& state)
+    {
+        std::unique_ptr<XmlElement> xml (XmlDocument::parse (presetFile));
+
+        if (xml != nullptr)
+        {
+            AudioProcessor::copyXmlToBinary (*xml, state);
+            return true;
+        }
+
+        return presetFile.loadFileAsData (state) && state.getSize() > 0;
+    }
+
+    void applySettings (PingPongDelayAudioProcessor& processor, const MemoryBlock& presetState, const StringPairArray& parameterValues)
+    {
+        if (presetState.getSize() > 0)
+            processor.setStateInformation (presetState.getData(), (int)presetState.getSize());
+
+        for (auto& paramID : parameterValues.getAllKeys())
+            setParameter (processor, paramID, parameterValues[paramID].getFloatValue());
+    }
+
+    //==============================================================================
+
+    /*Every file given on the command line, plus the WAV and FLAC files anywhere inside the given folders.
+    Files from a folder keep their place below it in the output folder.*/
+    Array<RenderJob> findJobs (const RenderOptions& options)
+    {
+        Array<RenderJob> jobs;
+        const String extension = "." + options.format;
+
+        auto addJob = [&] (const File& input, const String& relativePath)
+        {
+            RenderJob job;
+            job.input = input;
+            job.output = options.outputFolder.getChildFile (relativePath).withFileExtension (extension);
+            jobs.add (job);
+        };
+
+        for (auto& path : options.inputs)
+        {
+            const File input = File::getCurrentWorkingDirectory().getChildFile (path);
+
+            if (input.isDirectory())
+            {
+                for (DirectoryIterator it (input, true, "*.wav;*.flac", File::findFiles); it.next();)
+                    addJob (it.getFile(), it.getFile().getRelativePathFrom (input));
+            }
+            else if (input.existsAsFile())
+            {
+                addJob (input, input.getFileName());
+            }
+            else
+            {
+                std::cerr << "Can't find " << path << std::endl;
+            }
+        }
+
+        return jobs;
+    }
+
+    //==============================================================================
+
+    /*WAV files are memory mapped, so reading a chunk is just converting the samples out of the mapped pages, with no
+    copy through a file buffer. Formats that can't be mapped (FLAC) are read through a normal stream instead.*/
+    AudioFormatReader* createReader (AudioFormatManager& formatManager, const File& input, bool memoryMap,
+                                     MemoryMappedAudioFormatReader*& mappedReader)
+    {
+        mappedReader = nullptr;
+
+        if (memoryMap)
+            if (auto* format = formatManager.findFormatForFileExtension (input.getFileExtension()))
+                if ((mappedReader = format->createMemoryMappedReader (input)) != nullptr)
+                    return mappedReader;
+
+        return formatManager.createReaderFor (input);
+    }
+
+    void renderFile (RenderWorker& worker, RenderJob& job, const RenderOptions& options,
+                     const MemoryBlock& presetState)
+    {
+        MemoryMappedAudioFormatReader* mappedReader = nullptr;
+        std::unique_ptr<AudioFormatReader> reader (createReader (worker.formatManager, job.input, options.memoryMap, mappedReader));
+
+        if (reader == nullptr)
+        {
+            job.error = "not a readable audio file";
+            return;
+        }
+
+        const int numChannels = (int)reader->numChannels;
+
+        // the file's channels in the default layout for their count, without its LFE (see DelayKernels::LoopLayout)
+        if (! DelayKernels::isSupportedChannelCount (DelayKernels::LoopLayout::fromChannelSet (AudioChannelSet::canonicalChannelSet (numChannels)).numChannels))
+        {
+            job.error = String (numChannels) + " channels aren't supported";
+            return;
+        }
+
+        AudioFormat* format = worker.formatManager.findFormatForFileExtension (job.output.getFileExtension());
+        job.output.getParentDirectory().createDirectory();
+        job.output.deleteFile();
+        std::unique_ptr<FileOutputStream> stream (job.output.createOutputStream());
+
+        if (format == nullptr || stream == nullptr)
+        {
+            job.error = "can't write " + job.output.getFullPathName();
+            return;
+        }
+
+        std::unique_ptr<AudioFormatWriter> writer (format->createWriterFor (stream.get(), reader->sampleRate, (unsigned int)numChannels,
+                                                                            options.bitsPerSample, {}, 0));
+
+        if (writer == nullptr)
+        {
+            job.error = "the output format doesn't take " + String (options.bitsPerSample) + " bit " + String (numChannels) + " channel audio";
+            return;
+        }
+
+        stream.release(); // the writer owns it now
+
+        const int64 start = Time::getHighResolutionTicks();
+
+        // a fresh start for every file: same settings, empty delay line
+        PingPongDelayAudioProcessor& processor = worker.processor;
+        processor.setPlayConfigDetails (numChannels, numChannels, reader->sampleRate, options.blockSize);
+        processor.setNonRealtime (true);
+        applySettings (processor, presetState, options.parameterValues);
+        processor.prepareToPlay (reader->sampleRate, options.blockSize);
+
+        // past the end of the input the delay keeps running on silence until the echoes are below -90 dBFS
+        const double tailSeconds = options.renderTail ? jmin (processor.getTailLengthSeconds(), options.maximumTailSeconds) : 0.0;
+        const int64 outputLength = reader->lengthInSamples + (int64)std::ceil (tailSeconds * reader->sampleRate);
+
+        /*Memory stays the same however long the file is: one chunk of samples, one chunk of the file mapped at a
+        time (the previous section is unmapped when the next one is mapped) and the writer's stream buffer*/
+        worker.chunk.setSize (numChannels, options.chunkSize, false, false, true);
+
+        for (int64 position = 0; position < outputLength; position += options.chunkSize)
+        {
+            const int chunkLength = (int)jmin ((int64)options.chunkSize, outputLength - position);
+            const int inputLength = (int)jlimit ((int64)0, (int64)chunkLength, reader->lengthInSamples - position);
+
+            if (inputLength > 0)
+            {
+                if (mappedReader != nullptr && ! mappedReader->mapSectionOfFile ({ position, position + inputLength }))
+                {
+                    job.error = "can't map the file into memory";
+                    processor.releaseResources();
+                    return;
+                }
+
+                reader->read (&worker.chunk, 0, inputLength, position, true, true);
+            }
+
+            if (inputLength < chunkLength)
+                worker.chunk.clear (inputLength, chunkLength - inputLength);
+
+            for (int blockStart = 0; blockStart < chunkLength; blockStart += options.blockSize)
+            {
+                const int blockLength = jmin (options.blockSize, chunkLength - blockStart);
+                AudioBuffer<float> block (worker.chunk.getArrayOfWritePointers(), numChannels, blockStart, blockLength);
+                worker.midiMessages.clear();
+                processor.processBlock (block, worker.midiMessages);
+            }
+
+            if (! writer->writeFromAudioSampleBuffer (worker.chunk, 0, chunkLength))
+            {
+                job.error = "writing failed";
+                processor.releaseResources();
+                return;
+            }
+        }
+
+        writer.reset();
+        processor.releaseResources();
+
+        job.renderedSamples = outputLength;
+        job.renderSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        job.succeeded = true;
+    }
+
+    //==============================================================================
+
+    RenderOptions parseOptions (int argc, char* argv[])
+    {
+        RenderOptions options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const String arg (argv[i]);
+            auto nextValue = [&] { return i + 1 < argc ? String (argv[++i]) : String(); };
+
+            if (arg == "--preset")
+                options.presetFile = File::getCurrentWorkingDirectory().getChildFile (nextValue());
+            else if (arg == "--set")
+            {
+                const String assignment = nextValue();
+                options.parameterValues.set (assignment.upToFirstOccurrenceOf ("=", false, false).trim(),
+                                             assignment.fromFirstOccurrenceOf ("=", false, false).trim());
+            }
+            else if (arg == "--output")
+                options.outputFolder = File::getCurrentWorkingDirectory().getChildFile (nextValue());
+            else if (arg == "--threads")
+                options.numThreads = jmax (1, nextValue().getIntValue());
+            else if (arg == "--block")
+                options.blockSize = jmax (1, nextValue().getIntValue());
+            else if (arg == "--chunk")
+                options.chunkSize = jmax (1, nextValue().getIntValue());
+            else if (arg == "--format")
+                options.format = nextValue().toLowerCase();
+            else if (arg == "--bits")
+                options.bitsPerSample = nextValue().getIntValue();
+            else if (arg == "--no-mmap")
+                options.memoryMap = false;
+            else if (arg == "--tail")
+                options.renderTail = true;
+            else if (arg == "--max-tail")
+                options.maximumTailSeconds = jmax (0.0, nextValue().getDoubleValue());
+            else if (arg.startsWith ("--"))
+                std::cerr << "Ignoring unknown option " << arg << std::endl;
+            else
+                options.inputs.add (arg);
+        }
+
+        // whole blocks per chunk, so the blocks line up the same way whatever the chunk size
+        options.chunkSize = jmax (1, options.chunkSize / options.blockSize) * options.blockSize;
+
+        // FLAC stops at 24 bits
+        if (options.format == "flac")
+            options.bitsPerSample = jmin (options.bitsPerSample, 24);
+
+        return options;
+    }
+}
+
+//==============================================================================
+
+int main (int argc, char* argv[])
+{
+    const RenderOptions options = parseOptions (argc, argv);
+
+    if (options.format != "wav" && options.format != "flac")
+    {
+        std::cerr << "--format has to be wav or flac" << std::endl;
+        return 1;
+    }
+
+    MemoryBlock presetState;
+
+    if (options.presetFile != File() && ! loadPreset (options.presetFile, presetState))
+    {
+        std::cerr << "Can't read the preset " << options.presetFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    Array<RenderJob> jobs = findJobs (options);
+
+    if (jobs.isEmpty())
+    {
+        std::cerr << "Nothing to render" << std::endl;
+        return 1;
+    }
+
+    // the lengths are only needed to deal the files out, the longest first
+    Array<int64> jobSizes;
+    double totalAudioSeconds = 0.0;
+
+    {
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        for (auto& job : jobs)
+        {
+            std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor (job.input));
+
+            if (reader != nullptr)
+            {
+                job.lengthInSamples = reader->lengthInSamples;
+                job.sampleRate = reader->sampleRate;
+                totalAudioSeconds += (double)job.lengthInSamples / job.sampleRate;
+            }
+
+            jobSizes.add (job.lengthInSamples);
+        }
+    }
+
+    const int numWorkers = jmin (options.numThreads, jobs.size());
+    OwnedArray<RenderWorker> workers;
+
+    for (int worker = 0; worker < numWorkers; ++worker)
+        workers.add (new RenderWorker())->formatManager.registerBasicFormats();
+
+    std::cout << "Rendering " << jobs.size() << " files (" << String (totalAudioSeconds, 1) << " s of audio) on "
+              << numWorkers << " threads, " << options.blockSize << " sample blocks" << std::endl;
+
+    const int64 start = Time::getHighResolutionTicks();
+
+    WorkStealingPool::run (jobSizes, numWorkers, [&] (int worker, int job)
+    {
+        renderFile (*workers[worker], jobs.getReference (job), options, presetState);
+    });
+
+    const double wallSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+    int numFailed = 0;
+    double busySeconds = 0.0;
+    double renderedSeconds = 0.0;
+
+    for (auto& job : jobs)
+    {
+        if (job.succeeded)
+        {
+            const double audioSeconds = (double)job.renderedSamples / job.sampleRate;
+            busySeconds += job.renderSeconds;
+            renderedSeconds += audioSeconds;
+
+            std::cout << String (audioSeconds / jmax (job.renderSeconds, 1.0e-9), 1).paddedLeft (' ', 9) << "x  "
+                      << job.output.getFullPathName() << std::endl;
+        }
+        else
+        {
+            ++numFailed;
+            std::cerr << "Failed: " << job.input.getFullPathName() << ": " << job.error << std::endl;
+        }
+    }
+
+    // busy / wall is how many workers were rendering on average, numWorkers if nobody was left waiting
+    std::cout << "Total " << String (renderedSeconds / jmax (wallSeconds, 1.0e-9), 1) << "x realtime in "
+              << String (wallSeconds, 2) << " s, " << String (busySeconds / jmax (wallSeconds, 1.0e-9), 2)
+              << " of " << numWorkers << " workers busy on average" << std::endl;
+
+    return numFailed > 0 ? 1 : 0;
+}
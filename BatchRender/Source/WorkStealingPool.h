@@ -0,0 +1,135 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     A small work-stealing thread pool for the batch renderer.
+
+     Every worker owns a queue of jobs. It takes its next job from the front of its own queue, and once that
+     is empty it steals from the back of another worker's queue, so the workers that got the short files end up
+     helping with the long ones instead of going idle. Jobs are dealt out largest first, round robin, so each
+     worker starts on a big file and the small ones are left over for balancing at the end.
+
+     Each queue has its own lock, held only to take a job index out, so workers almost never wait for each
+     other. Jobs are whole files, so there are never more than a few thousand of them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+#include <deque>
+#include <functional>
+
+//==============================================================================
+
+class WorkStealingPool
+{
+public:
+    /*Called on a worker thread with the index of the worker (0 to numWorkers - 1) and of the job*/
+    using JobFunction = std::function<void (int worker, int job)>;
+
+    /*Runs every job once on numWorkers threads and returns when all of them are done. jobSizes gives the
+    relative cost of each job (the number of samples of a file, say), only used to deal the jobs out.*/
+    static void run (const Array<int64>& jobSizes, int numWorkers, const JobFunction& function)
+    {
+        WorkStealingPool pool (jmax (1, numWorkers));
+        pool.deal (jobSizes);
+        pool.runWorkers (function);
+    }
+
+private:
+    struct JobQueue
+    {
+        CriticalSection lock;
+        std::deque<int> jobs;
+    };
+
+    class Worker : public Thread
+    {
+    public:
+        Worker (WorkStealingPool& ownerPool, int workerIndex, const JobFunction& jobFunction)
+            : Thread ("Render worker " + String (workerIndex)), pool (ownerPool), index (workerIndex), function (jobFunction)
+        {
+        }
+
+        void run() override
+        {
+            for (int job = pool.takeJob (index); job >= 0; job = pool.takeJob (index))
+                function (index, job);
+        }
+
+    private:
+        WorkStealingPool& pool;
+        const int index;
+        const JobFunction& function;
+    };
+
+    explicit WorkStealingPool (int numWorkers)
+    {
+        for (int worker = 0; worker < numWorkers; ++worker)
+            queues.add (new JobQueue());
+    }
+
+    void deal (const Array<int64>& jobSizes)
+    {
+        Array<int> order;
+
+        for (int job = 0; job < jobSizes.size(); ++job)
+            order.add (job);
+
+        std::stable_sort (order.begin(), order.end(), [&jobSizes] (int a, int b) { return jobSizes[a] > jobSizes[b]; });
+
+        for (int position = 0; position < order.size(); ++position)
+            queues[position % queues.size()]->jobs.push_back (order[position]);
+    }
+
+    void runWorkers (const JobFunction& function)
+    {
+        OwnedArray<Worker> workers;
+
+        for (int worker = 0; worker < queues.size(); ++worker)
+            workers.add (new Worker (*this, worker, function))->startThread();
+
+        for (auto* worker : workers)
+            worker->waitForThreadToExit (-1);
+    }
+
+    /*The next job for the worker, its own or a stolen one, or -1 once every queue is empty.
+    Nothing is added while the workers run, so an empty sweep over all queues means the work is done.*/
+    int takeJob (int worker)
+    {
+        {
+            JobQueue& own = *queues[worker];
+            const ScopedLock sl (own.lock);
+
+            if (! own.jobs.empty())
+            {
+                const int job = own.jobs.front();
+                own.jobs.pop_front();
+                return job;
+            }
+        }
+
+        for (int offset = 1; offset < queues.size(); ++offset)
+        {
+            JobQueue& victim = *queues[(worker + offset) % queues.size()];
+            const ScopedLock sl (victim.lock);
+
+            if (! victim.jobs.empty())
+            {
+                const int job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return job;
+            }
+        }
+
+        return -1;
+    }
+
+    OwnedArray<JobQueue> queues;
+
+    JUCE_DECLARE_NON_COPYABLE (WorkStealingPool)
+};
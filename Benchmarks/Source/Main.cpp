@@ -0,0 +1,1117 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Headless throughput benchmark for PingPongDelayAudioProcessor::processBlock.
+
+     The processor is compiled without its editor (PINGPONG_HEADLESS) and driven the same way a host would:
+     prepareToPlay once, then processBlock over and over with fresh input. Every combination of sample rate,
+     block size, delay time and feedback in the matrix below is timed block by block, plus every interpolation
+     mode at one typical setting so the cost of each quality level can be compared, the other delay storage
+     formats at a short and a long delay, and double precision processing.
+
+     After the timings it prints the noise floor of each storage format: the same input is rendered with a
+     float delay line and with the reduced one, and the difference between the two is the added noise.
+     Then how many ping-pong voices one core runs as separate processor instances. Then a rhythmic pattern of
+     2 to 8 echoes played by a stack of instances and by one instance with that many taps. Then the feedback chain, the delay time modulation (its LFOs alone against
+     std::sin per sample, and the processor with each shape), a check that one processor renders the same input
+     the same way twice when it is prepared again in between, and the convolution: the convolver alone at every
+     impulse response length and partition size, and the processor with it on at a few block sizes. Last, the
+     multiband mode against the way it was done before: one instance per band behind a crossover of IIRFilters.
+
+     Usage: PingPongBenchmark [--quick] [--seconds <s>] [--label <text>] [--json <file>]
+                              [--baseline <file>] [--tolerance <percent>]
+
+  ==============================================================================
+*/
+
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/PartitionedConvolver.h"
+#include "../../Source/DelayModulation.h"
+
+#include <iostream>
+
+//==============================================================================
+
+namespace
+{
+    /*One point of the benchmark matrix*/
+    struct BenchmarkConfig
+    {
+        double sampleRate;
+        int blockSize;
+        float delayTime;
+        float feedback;
+        int interpolation;
+        int storage;
+        bool doublePrecision;
+        int numChannels;
+    };
+
+    /*Timings for one point of the matrix. Block times are in microseconds.*/
+    struct BenchmarkResult
+    {
+        BenchmarkConfig config;
+        double nsPerSample;
+        double instancesPerCore;
+        size_t memoryBytes;
+        double p50, p90, p99, max;
+    };
+
+    struct BenchmarkOptions
+    {
+        bool quick = false;
+        double secondsPerConfig = 1.0;
+        double tolerancePercent = 10.0;
+        String label;
+        File jsonFile;
+        File baselineFile;
+    };
+
+    //==============================================================================
+
+    /*Sets a parameter through the value tree state, exactly like host automation would*/
+    void setParameter (PingPongDelayAudioProcessor& processor, const String& paramID, float value)
+    {
+        if (auto* parameter = processor.parameters.apvts.getParameter (paramID))
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+    }
+
+    /*Nearest-rank percentile of an already sorted array*/
+    double percentile (const Array<double>& sortedTimes, double fraction)
+    {
+        const int index = jlimit (0, sortedTimes.size() - 1, (int) std::ceil (fraction * sortedTimes.size()) - 1);
+        return sortedTimes[index];
+    }
+
+    /*Item names of the Interpolation parameter, in the order of InterpolationType*/
+    const StringArray& getInterpolationNames()
+    {
+        static const StringArray names = PingPongDelayAudioProcessor().paramInterpolation.items;
+        return names;
+    }
+
+    /*Short names of the Delay storage formats, in the order of DelayStorage::Format*/
+    const StringArray& getStorageNames()
+    {
+        static const StringArray names { "float32", "int16", "half", "float64" };
+        return names;
+    }
+
+    /*Linear interpolation, float storage, single precision and stereo (the defaults) keep the keys they had before
+    those options existed, so older baselines still match*/
+    String getConfigKey (const BenchmarkConfig& config)
+    {
+        String key = String (config.sampleRate, 0) + "/" + String (config.blockSize) + "/"
+                   + String (config.delayTime, 3) + "/" + String (config.feedback, 2);
+
+        if (config.interpolation != (int)InterpolationType::linear)
+            key << "/" << getInterpolationNames()[config.interpolation];
+
+        if (config.storage != (int)DelayStorage::Format::float32)
+            key << "/" << getStorageNames()[config.storage];
+
+        if (config.doublePrecision)
+            key << "/double";
+
+        if (config.numChannels != 2)
+            key << "/" << config.numChannels << "ch";
+
+        return key;
+    }
+
+    //==============================================================================
+
+    /*Runs the warm-up and the timed blocks in the precision of SampleType and returns the time of each timed block
+    in microseconds*/
+    template <typename SampleType>
+    Array<double> timeBlocks (PingPongDelayAudioProcessor& processor, const BenchmarkConfig& config, int numWarmUpBlocks, int numBlocks)
+    {
+        // Pre-generated noise is copied into the buffer before every block, outside of the timed region,
+        // so the processor always sees fresh input and the delay line fills up the way it would in a session.
+        const int noiseLength = 1 << 16;
+        AudioBuffer<SampleType> noise (config.numChannels, noiseLength + config.blockSize);
+        Random random (0x5eed);
+
+        for (int channel = 0; channel < noise.getNumChannels(); ++channel)
+            for (int sample = 0; sample < noise.getNumSamples(); ++sample)
+                noise.setSample (channel, sample, (SampleType) (random.nextFloat() * 2.0f - 1.0f));
+
+        AudioBuffer<SampleType> buffer (config.numChannels, config.blockSize);
+        MidiBuffer midiMessages;
+
+        Array<double> blockTimes;
+        blockTimes.ensureStorageAllocated (numBlocks);
+
+        int noisePosition = 0;
+
+        for (int block = 0; block < numWarmUpBlocks + numBlocks; ++block)
+        {
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                buffer.copyFrom (channel, 0, noise, channel, noisePosition, config.blockSize);
+
+            noisePosition = (noisePosition + config.blockSize) % noiseLength;
+
+            const int64 start = Time::getHighResolutionTicks();
+            processor.processBlock (buffer, midiMessages);
+            const int64 end = Time::getHighResolutionTicks();
+
+            if (block >= numWarmUpBlocks)
+                blockTimes.add (Time::highResolutionTicksToSeconds (end - start) * 1.0e6);
+        }
+
+        return blockTimes;
+    }
+
+    BenchmarkResult runBenchmark (const BenchmarkConfig& config, double secondsPerConfig)
+    {
+        PingPongDelayAudioProcessor processor;
+        processor.setPlayConfigDetails (config.numChannels, config.numChannels, config.sampleRate, config.blockSize);
+        processor.setProcessingPrecision (config.doublePrecision ? AudioProcessor::doublePrecision
+                                                                 : AudioProcessor::singlePrecision);
+
+        // set before prepareToPlay, which sizes the delay line for the delay time
+        setParameter (processor, "balanceinput", 0.5f);
+        setParameter (processor, "delaytime", config.delayTime);
+        setParameter (processor, "feedback", config.feedback);
+        setParameter (processor, "mix", 0.5f);
+        setParameter (processor, "interpolation", (float) config.interpolation);
+        setParameter (processor, "delaystorage", (float) config.storage);
+
+        processor.prepareToPlay (config.sampleRate, config.blockSize);
+
+        const int numBlocks = jmax (64, (int) (secondsPerConfig * config.sampleRate / config.blockSize));
+        const int numWarmUpBlocks = jmax (16, numBlocks / 10);
+
+        Array<double> blockTimes = config.doublePrecision ? timeBlocks<double> (processor, config, numWarmUpBlocks, numBlocks)
+                                                          : timeBlocks<float> (processor, config, numWarmUpBlocks, numBlocks);
+
+        double totalSeconds = 0.0;
+
+        for (auto time : blockTimes)
+            totalSeconds += time * 1.0e-6;
+
+        const size_t memoryBytes = processor.getMemoryUsage();
+        processor.releaseResources();
+        blockTimes.sort();
+
+        BenchmarkResult result;
+        result.config = config;
+        result.nsPerSample = totalSeconds * 1.0e9 / ((double) numBlocks * config.blockSize);
+        result.instancesPerCore = (1.0e9 / config.sampleRate) / jmax (result.nsPerSample, 1.0e-3);
+        result.memoryBytes = memoryBytes;
+        result.p50 = percentile (blockTimes, 0.50);
+        result.p90 = percentile (blockTimes, 0.90);
+        result.p99 = percentile (blockTimes, 0.99);
+        result.max = blockTimes.getLast();
+        return result;
+    }
+
+    //==============================================================================
+
+    Array<BenchmarkConfig> createMatrix (bool quick)
+    {
+        const Array<double> sampleRates = quick ? Array<double> { 48000.0, 192000.0 }
+                                                : Array<double> { 44100.0, 48000.0, 96000.0, 192000.0 };
+        const Array<int> blockSizes = quick ? Array<int> { 1, 64, 4096 }
+                                            : Array<int> { 1, 16, 64, 256, 1024, 4096 };
+        const Array<float> delayTimes = quick ? Array<float> { 0.1f, 1.0f }
+                                              : Array<float> { 0.01f, 0.1f, 1.0f, 4.5f };
+        const Array<float> feedbacks = quick ? Array<float> { 0.7f }
+                                             : Array<float> { 0.0f, 0.5f, 0.9f };
+
+        Array<BenchmarkConfig> matrix;
+
+        for (auto sampleRate : sampleRates)
+            for (auto blockSize : blockSizes)
+                for (auto delayTime : delayTimes)
+                    for (auto feedback : feedbacks)
+                        matrix.add ({ sampleRate, blockSize, delayTime, feedback, (int)InterpolationType::linear, 0, false, 2 });
+
+        for (int interpolation = 0; interpolation < getInterpolationNames().size(); ++interpolation)
+            if (interpolation != (int)InterpolationType::linear)
+                matrix.add ({ 48000.0, 256, 0.1f, 0.7f, interpolation, 0, false, 2 });
+
+        // the short delay stays in cache whatever the format, the long one is where the smaller line should pay off
+        for (int storage = 1; storage < getStorageNames().size(); ++storage)
+            for (auto delayTime : { 0.1f, 4.5f })
+                matrix.add ({ 48000.0, 256, delayTime, 0.7f, (int)InterpolationType::linear, storage, false, 2 });
+
+        // double precision with the float line (converted every segment) and with the double one
+        for (auto storage : { DelayStorage::Format::float32, DelayStorage::Format::float64 })
+            for (auto delayTime : { 0.1f, 4.5f })
+                matrix.add ({ 48000.0, 256, delayTime, 0.7f, (int)InterpolationType::linear, (int)storage, true, 2 });
+
+        // the other channel counts the bus layout accepts, each with its own kernel
+        for (auto numChannels : { 1, 4, 6, 8 })
+            matrix.add ({ 48000.0, 256, 0.1f, 0.7f, (int)InterpolationType::linear, 0, false, numChannels });
+
+        return matrix;
+    }
+
+    //==============================================================================
+
+    /*Machine-readable results, one object per configuration, so runs from different commits can be diffed*/
+    var resultsToJson (const Array<BenchmarkResult>& results, const BenchmarkOptions& options)
+    {
+        Array<var> entries;
+
+        for (auto& result : results)
+        {
+            DynamicObject* blockTimes = new DynamicObject();
+            blockTimes->setProperty ("p50", result.p50);
+            blockTimes->setProperty ("p90", result.p90);
+            blockTimes->setProperty ("p99", result.p99);
+            blockTimes->setProperty ("max", result.max);
+
+            DynamicObject* entry = new DynamicObject();
+            entry->setProperty ("key", getConfigKey (result.config));
+            entry->setProperty ("sampleRate", result.config.sampleRate);
+            entry->setProperty ("blockSize", result.config.blockSize);
+            entry->setProperty ("delayTime", result.config.delayTime);
+            entry->setProperty ("feedback", result.config.feedback);
+            entry->setProperty ("interpolation", getInterpolationNames()[result.config.interpolation]);
+            entry->setProperty ("storage", getStorageNames()[result.config.storage]);
+            entry->setProperty ("precision", result.config.doublePrecision ? "double" : "float");
+            entry->setProperty ("numChannels", result.config.numChannels);
+            entry->setProperty ("nsPerSample", result.nsPerSample);
+            entry->setProperty ("instancesPerCore", result.instancesPerCore);
+            entry->setProperty ("memoryBytes", (int64) result.memoryBytes);
+            entry->setProperty ("blockTimeUs", var (blockTimes));
+            entries.add (var (entry));
+        }
+
+        DynamicObject* root = new DynamicObject();
+        root->setProperty ("benchmark", "PingPongDelayAudioProcessor::processBlock");
+        root->setProperty ("formatVersion", 1);
+        root->setProperty ("label", options.label);
+        root->setProperty ("date", Time::getCurrentTime().toISO8601 (true));
+        root->setProperty ("cpu", SystemStats::getCpuModel());
+        root->setProperty ("secondsPerConfig", options.secondsPerConfig);
+        root->setProperty ("results", entries);
+        return var (root);
+    }
+
+    /*Compares ns/sample against a previous --json run. Returns the number of configurations that got slower
+    than the tolerance allows.*/
+    int compareWithBaseline (const Array<BenchmarkResult>& results, const BenchmarkOptions& options)
+    {
+        const var baseline = JSON::parse (options.baselineFile);
+
+        if (! baseline["results"].isArray())
+        {
+            std::cerr << "Could not read baseline " << options.baselineFile.getFullPathName() << std::endl;
+            return 0;
+        }
+
+        int numRegressions = 0;
+        int numCompared = 0;
+
+        for (auto& result : results)
+        {
+            const String key = getConfigKey (result.config);
+
+            for (auto& entry : *baseline["results"].getArray())
+            {
+                if (entry["key"].toString() != key)
+                    continue;
+
+                const double before = entry["nsPerSample"];
+                const double change = 100.0 * (result.nsPerSample - before) / jmax (before, 1.0e-9);
+                ++numCompared;
+
+                if (change > options.tolerancePercent)
+                {
+                    ++numRegressions;
+                    std::cout << "REGRESSION " << key << ": " << String (before, 3) << " -> "
+                              << String (result.nsPerSample, 3) << " ns/sample (+" << String (change, 1) << "%)" << std::endl;
+                }
+                break;
+            }
+        }
+
+        std::cout << "Compared " << numCompared << " configurations against " << options.baselineFile.getFileName()
+                  << ", " << numRegressions << " regression(s) above " << String (options.tolerancePercent, 1) << "%" << std::endl;
+        return numRegressions;
+    }
+
+    //==============================================================================
+
+    /*Renders two seconds of input through the delay (wet only, so the echoes are all that is measured) with the
+    delay line stored in the given format*/
+    AudioSampleBuffer renderWet (const AudioSampleBuffer& input, float feedback, int storage)
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+
+        PingPongDelayAudioProcessor processor;
+        processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+
+        setParameter (processor, "balanceinput", 0.5f);
+        setParameter (processor, "delaytime", 0.1f);
+        setParameter (processor, "feedback", feedback);
+        setParameter (processor, "mix", 1.0f);
+        setParameter (processor, "delaystorage", (float) storage);
+
+        processor.prepareToPlay (sampleRate, blockSize);
+
+        AudioSampleBuffer output (input);
+        MidiBuffer midiMessages;
+
+        for (int start = 0; start < output.getNumSamples(); start += blockSize)
+        {
+            AudioSampleBuffer block (output.getArrayOfWritePointers(), 2, start, jmin (blockSize, output.getNumSamples() - start));
+            processor.processBlock (block, midiMessages);
+        }
+
+        processor.releaseResources();
+        return output;
+    }
+
+    /*RMS of a - b over both channels (or of a alone without b), in dBFS*/
+    double getRmsDecibels (const AudioSampleBuffer& a, const AudioSampleBuffer* b)
+    {
+        double sum = 0.0;
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int sample = 0; sample < a.getNumSamples(); ++sample)
+            {
+                const double value = a.getSample (channel, sample) - (b != nullptr ? b->getSample (channel, sample) : 0.0f);
+                sum += value * value;
+            }
+
+        return 10.0 * std::log10 (jmax (sum / (2.0 * a.getNumSamples()), 1.0e-30));
+    }
+
+    /*Error of each reduced precision format against the float delay line, for white noise at -6 dBFS peak and a
+    1 kHz sine at -12 dBFS, with no, some and a lot of feedback*/
+    void printNoiseFloor()
+    {
+        const int numSamples = 2 * 48000;
+        AudioSampleBuffer noise (2, numSamples);
+        AudioSampleBuffer sine (2, numSamples);
+        Random random (0x5eed);
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const float value = 0.25f * (float) std::sin (MathConstants<double>::twoPi * 1000.0 * sample / 48000.0);
+
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                noise.setSample (channel, sample, 0.5f * (random.nextFloat() * 2.0f - 1.0f));
+                sine.setSample (channel, sample, value);
+            }
+        }
+
+        std::cout << std::endl << "Delay storage noise floor (error against the float delay line, wet signal only)" << std::endl;
+        std::cout << "storage  signal  fb     signal(dBFS)  error(dBFS)  SNR(dB)" << std::endl;
+
+        for (auto storage : { (int)DelayStorage::Format::int16, (int)DelayStorage::Format::half })
+            for (int signal = 0; signal < 2; ++signal)
+                for (auto feedback : { 0.0f, 0.5f, 0.9f })
+                {
+                    const AudioSampleBuffer& input = signal == 0 ? noise : sine;
+                    const AudioSampleBuffer reference = renderWet (input, feedback, 0);
+                    const AudioSampleBuffer reduced = renderWet (input, feedback, storage);
+
+                    const double signalLevel = getRmsDecibels (reference, nullptr);
+                    const double errorLevel = getRmsDecibels (reduced, &reference);
+
+                    std::cout << getStorageNames()[storage].paddedRight (' ', 9)
+                              << String (signal == 0 ? "noise" : "sine").paddedRight (' ', 8)
+                              << String (feedback, 2).paddedRight (' ', 7)
+                              << String (signalLevel, 1).paddedRight (' ', 14)
+                              << String (errorLevel, 1).paddedRight (' ', 13)
+                              << String (signalLevel - errorLevel, 1) << std::endl;
+                }
+    }
+
+    //==============================================================================
+
+    /*Delay of voice number "voice" of the voices per core table: spread between 50 and 250 ms*/
+    float getVoiceDelayTime (int voice)
+    {
+        return 0.05f + 0.2f * (float) (voice % 16) / 15.0f;
+    }
+
+    /*Runs numBlocks blocks (after a tenth as many to warm up) and returns the ns spent per sample of one voice.
+    Only process() is timed, fillInput() puts fresh input into the buffers before every block.*/
+    template <typename FillFunction, typename ProcessFunction>
+    double timeVoices (int numVoices, int blockSize, int numBlocks, FillFunction fillInput, ProcessFunction process)
+    {
+        const int numWarmUpBlocks = jmax (4, numBlocks / 10);
+        int64 ticks = 0;
+
+        for (int block = 0; block < numWarmUpBlocks + numBlocks; ++block)
+        {
+            fillInput();
+
+            const int64 start = Time::getHighResolutionTicks();
+            process();
+            const int64 end = Time::getHighResolutionTicks();
+
+            if (block >= numWarmUpBlocks)
+                ticks += end - start;
+        }
+
+        return Time::highResolutionTicksToSeconds (ticks) * 1.0e9 / ((double) numBlocks * blockSize * numVoices);
+    }
+
+    /*How many ping-pong voices one core runs, one PingPongDelayAudioProcessor per voice as a render server hosts them.
+    Every voice gets the same block of noise each time, so none of them goes idle.*/
+    void printVoicesPerCore (bool quick, double secondsPerConfig)
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const int numBlocks = jmax (16, (int) (secondsPerConfig * sampleRate / blockSize));
+
+        std::cout << std::endl << "Voices per core (48 kHz, 256 sample blocks, 50-250 ms delays, feedback 0.7)" << std::endl;
+        std::cout << "voices  ns/sample  voices/core  mem(KB)" << std::endl;
+
+        for (auto numVoices : quick ? Array<int> { 16, 256 } : Array<int> { 1, 16, 64, 256, 1024 })
+        {
+            AudioSampleBuffer noise (2, blockSize);
+            Random random (0x5eed);
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int sample = 0; sample < blockSize; ++sample)
+                    noise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+            OwnedArray<AudioSampleBuffer> buffers;
+            OwnedArray<PingPongDelayAudioProcessor> processors;
+            MidiBuffer midiMessages;
+            size_t memory = 0;
+
+            for (int voice = 0; voice < numVoices; ++voice)
+            {
+                buffers.add (new AudioSampleBuffer (2, blockSize));
+
+                PingPongDelayAudioProcessor* processor = processors.add (new PingPongDelayAudioProcessor());
+                processor->setPlayConfigDetails (2, 2, sampleRate, blockSize);
+                setParameter (*processor, "balanceinput", 0.5f);
+                setParameter (*processor, "delaytime", getVoiceDelayTime (voice));
+                setParameter (*processor, "feedback", 0.7f);
+                setParameter (*processor, "mix", 0.5f);
+                processor->prepareToPlay (sampleRate, blockSize);
+                memory += processor->getMemoryUsage();
+            }
+
+            const double ns = timeVoices (numVoices, blockSize, numBlocks, [&]
+            {
+                for (auto* buffer : buffers)
+                    for (int channel = 0; channel < 2; ++channel)
+                        buffer->copyFrom (channel, 0, noise, channel, 0, blockSize);
+            }, [&]
+            {
+                for (int voice = 0; voice < numVoices; ++voice)
+                    processors[voice]->processBlock (*buffers[voice], midiMessages);
+            });
+
+            std::cout << String (numVoices).paddedRight (' ', 8)
+                      << String (ns, 3).paddedRight (' ', 11)
+                      << String (1.0e9 / sampleRate / ns, 0).paddedRight (' ', 13)
+                      << String ((double) memory / 1024.0, 0) << std::endl;
+        }
+    }
+
+    //==============================================================================
+
+    /*A pattern of numTaps echoes an eighth note (125 ms) apart, alternating between the sides, played the way it was
+    done before the taps (one instance per echo, all fed the same input and summed) and by one instance with numTaps
+    taps. The first echo feeds back in both, the others don't.*/
+    void printMultiTap (double secondsPerConfig)
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const int numBlocks = jmax (16, (int) (secondsPerConfig * sampleRate / blockSize));
+
+        std::cout << std::endl << "Multi-tap pattern (48 kHz, 256 sample blocks, echoes 125 ms apart)" << std::endl;
+        std::cout << "taps  stack(ns)  taps(ns)  stack mem(KB)  taps mem(KB)" << std::endl;
+
+        AudioSampleBuffer noise (2, blockSize);
+        Random random (0x5eed);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int sample = 0; sample < blockSize; ++sample)
+                noise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+        MidiBuffer midiMessages;
+
+        auto createProcessor = [&] (OwnedArray<PingPongDelayAudioProcessor>& processors, float delayTime, float feedback)
+        {
+            PingPongDelayAudioProcessor* processor = processors.add (new PingPongDelayAudioProcessor());
+            processor->setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            setParameter (*processor, "delaytime", delayTime);
+            setParameter (*processor, "feedback", feedback);
+            setParameter (*processor, "mix", 1.0f);
+            return processor;
+        };
+
+        for (int numTaps = 2; numTaps <= DelayTaps::maxTaps + 1; numTaps *= 2)
+        {
+            // the stack, one instance per echo
+            OwnedArray<PingPongDelayAudioProcessor> stack;
+            OwnedArray<AudioSampleBuffer> stackBuffers;
+            AudioSampleBuffer output (2, blockSize);
+            size_t stackMemory = 0;
+
+            for (int tap = 0; tap < numTaps; ++tap)
+            {
+                PingPongDelayAudioProcessor* processor = createProcessor (stack, 0.125f * (float) (tap + 1), tap == 0 ? 0.5f : 0.0f);
+                processor->prepareToPlay (sampleRate, blockSize);
+                stackMemory += processor->getMemoryUsage();
+                stackBuffers.add (new AudioSampleBuffer (2, blockSize));
+            }
+
+            const double stackNs = timeVoices (1, blockSize, numBlocks, [&]
+            {
+                for (auto* buffer : stackBuffers)
+                    buffer->makeCopyOf (noise, true);
+            }, [&]
+            {
+                output.clear();
+
+                for (int tap = 0; tap < numTaps; ++tap)
+                {
+                    stack[tap]->processBlock (*stackBuffers[tap], midiMessages);
+
+                    for (int channel = 0; channel < 2; ++channel)
+                        output.addFrom (channel, 0, *stackBuffers[tap], channel, 0, blockSize);
+                }
+            });
+
+            // one instance with the same echoes as taps
+            OwnedArray<PingPongDelayAudioProcessor> single;
+            PingPongDelayAudioProcessor* processor = createProcessor (single, 0.125f, 0.5f);
+            setParameter (*processor, "taps", (float) (numTaps - 1));
+
+            for (int tap = 2; tap <= numTaps; ++tap)
+            {
+                setParameter (*processor, "tap" + String (tap) + "time", 0.125f * (float) tap);
+                setParameter (*processor, "tap" + String (tap) + "gain", 1.0f);
+                setParameter (*processor, "tap" + String (tap) + "pan", (tap & 1) != 0 ? 0.0f : 1.0f);
+            }
+
+            processor->prepareToPlay (sampleRate, blockSize);
+            AudioSampleBuffer buffer (2, blockSize);
+
+            const double tapsNs = timeVoices (1, blockSize, numBlocks, [&] { buffer.makeCopyOf (noise, true); }, [&]
+            {
+                processor->processBlock (buffer, midiMessages);
+            });
+
+            std::cout << String (numTaps).paddedRight (' ', 6)
+                      << String (stackNs, 3).paddedRight (' ', 11)
+                      << String (tapsNs, 3).paddedRight (' ', 10)
+                      << String ((double) stackMemory / 1024.0, 0).paddedRight (' ', 15)
+                      << String ((double) processor->getMemoryUsage() / 1024.0, 0) << std::endl;
+        }
+    }
+
+    //==============================================================================
+
+    /*What the feedback chain adds to one instance, stage by stage, at a normal delay and at a delay shorter than the
+    block (where the chain cuts the block into pieces of one delay each)*/
+    void printFeedbackChain (double secondsPerConfig)
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const int numBlocks = jmax (16, (int) (secondsPerConfig * sampleRate / blockSize));
+
+        std::cout << std::endl << "Feedback chain (48 kHz, 256 sample blocks, feedback 0.7)" << std::endl;
+        std::cout << "chain                        delay(s)  ns/sample" << std::endl;
+
+        struct ChainConfig { const char* name; int damping; bool saturation, dcBlocker; };
+        const ChainConfig chains[] = { { "off",                         0, false, false },
+                                       { "one-pole",                    1, false, false },
+                                       { "biquad",                      2, false, false },
+                                       { "biquad + saturation + DC",    2, true,  true  } };
+
+        AudioSampleBuffer noise (2, blockSize);
+        Random random (0x5eed);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int sample = 0; sample < blockSize; ++sample)
+                noise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+        MidiBuffer midiMessages;
+
+        for (float delayTime : { 0.1f, 0.002f })
+        {
+            for (auto& chain : chains)
+            {
+                PingPongDelayAudioProcessor processor;
+                processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+                setParameter (processor, "delaytime", delayTime);
+                setParameter (processor, "feedback", 0.7f);
+                setParameter (processor, "mix", 0.5f);
+                setParameter (processor, "damping", (float) chain.damping);
+                setParameter (processor, "saturation", chain.saturation ? 1.0f : 0.0f);
+                setParameter (processor, "dcblocker", chain.dcBlocker ? 1.0f : 0.0f);
+                processor.prepareToPlay (sampleRate, blockSize);
+
+                AudioSampleBuffer buffer (2, blockSize);
+
+                const double ns = timeVoices (1, blockSize, numBlocks, [&] { buffer.makeCopyOf (noise, true); }, [&]
+                {
+                    processor.processBlock (buffer, midiMessages);
+                });
+
+                std::cout << String (chain.name).paddedRight (' ', 29)
+                          << String (delayTime, 3).paddedRight (' ', 10)
+                          << String (ns, 3) << std::endl;
+            }
+        }
+    }
+
+    //==============================================================================
+
+    /*What the modulation costs. First its LFOs alone, filled a block at a time, next to a sine LFO computed with
+    std::sin sample by sample; then one instance with each shape, where the read head is swept and read through the
+    sinc, against the sinc read head standing still.*/
+    void printModulation (double secondsPerConfig)
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const int numBlocks = jmax (16, (int) (secondsPerConfig * sampleRate / blockSize));
+        const char* shapeNames[] = { "off", "sine", "triangle", "random" };
+
+        std::cout << std::endl << "Modulation LFOs (48 kHz, stereo, 256 sample blocks)" << std::endl;
+        std::cout << "lfo                          ns/sample" << std::endl;
+
+        for (int shape = 1; shape <= 3; ++shape)
+        {
+            DelayModulation modulation;
+            modulation.prepare (sampleRate, 2, blockSize);
+
+            DelayModulation::Settings settings;
+            settings.shape = (DelayModulation::Shape) shape;
+            modulation.setSettings (settings);
+            modulation.jumpToTargets();
+
+            const double ns = timeVoices (1, blockSize, numBlocks, [] {}, [&]
+            {
+                modulation.fill (blockSize);
+            });
+
+            std::cout << String (shapeNames[shape]).paddedRight (' ', 29) << String (ns, 3) << std::endl;
+        }
+
+        {
+            HeapBlock<float> values (2 * blockSize);
+            double phase = 0.0;
+            const double increment = 0.8 / sampleRate;
+
+            const double ns = timeVoices (1, blockSize, numBlocks, [] {}, [&]
+            {
+                for (int channel = 0; channel < 2; ++channel)
+                    for (int sample = 0; sample < blockSize; ++sample)
+                        values[channel * blockSize + sample] = (float) std::sin (MathConstants<double>::twoPi * (phase + increment * (sample + 1) + 0.25 * channel));
+
+                phase += increment * blockSize;
+            });
+
+            std::cout << String ("std::sin per sample").paddedRight (' ', 29) << String (ns, 3) << std::endl;
+        }
+
+        std::cout << std::endl << "Modulated delay (48 kHz, 256 sample blocks, 100 ms delay, feedback 0.7, 2 ms depth)" << std::endl;
+        std::cout << "modulation                   ns/sample" << std::endl;
+
+        AudioSampleBuffer noise (2, blockSize);
+        Random random (0x5eed);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int sample = 0; sample < blockSize; ++sample)
+                noise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+        MidiBuffer midiMessages;
+
+        for (int shape = 0; shape <= 3; ++shape)
+        {
+            PingPongDelayAudioProcessor processor;
+            processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            setParameter (processor, "delaytime", 0.1f);
+            setParameter (processor, "feedback", 0.7f);
+            setParameter (processor, "mix", 0.5f);
+            setParameter (processor, "interpolation", (float) InterpolationType::sinc);
+            setParameter (processor, "modulation", (float) shape);
+            processor.prepareToPlay (sampleRate, blockSize);
+
+            AudioSampleBuffer buffer (2, blockSize);
+
+            const double ns = timeVoices (1, blockSize, numBlocks, [&] { buffer.makeCopyOf (noise, true); }, [&]
+            {
+                processor.processBlock (buffer, midiMessages);
+            });
+
+            std::cout << String (shapeNames[shape]).paddedRight (' ', 29) << String (ns, 3) << std::endl;
+        }
+    }
+
+    /*The same noise rendered twice through one processor with each modulation shape, released and prepared again in
+    between like the batch renderer does for every file. The second render has to match the first to the bit.
+    Returns the number of shapes where it doesn't.*/
+    int checkRepeatableRenders()
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const char* shapeNames[] = { "off", "sine", "triangle", "random" };
+
+        AudioSampleBuffer noise (2, 48000);
+        Random random (0x5eed);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int sample = 0; sample < noise.getNumSamples(); ++sample)
+                noise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+        std::cout << std::endl << "Rendered twice through one processor (48 kHz, 256 sample blocks, 2 ms depth)" << std::endl;
+        std::cout << "modulation                   result" << std::endl;
+
+        PingPongDelayAudioProcessor processor;
+        processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+        processor.setNonRealtime (true);
+        setParameter (processor, "delaytime", 0.1f);
+        setParameter (processor, "feedback", 0.7f);
+        setParameter (processor, "mix", 0.5f);
+
+        MidiBuffer midiMessages;
+        int numFailed = 0;
+
+        for (int shape = 0; shape <= 3; ++shape)
+        {
+            setParameter (processor, "modulation", (float) shape);
+            AudioSampleBuffer renders[2];
+
+            for (auto& output : renders)
+            {
+                processor.prepareToPlay (sampleRate, blockSize);
+                output.makeCopyOf (noise);
+
+                for (int start = 0; start < output.getNumSamples(); start += blockSize)
+                {
+                    AudioSampleBuffer block (output.getArrayOfWritePointers(), 2, start, jmin (blockSize, output.getNumSamples() - start));
+                    processor.processBlock (block, midiMessages);
+                }
+
+                processor.releaseResources();
+            }
+
+            bool same = true;
+
+            for (int channel = 0; channel < 2; ++channel)
+                same = same && std::memcmp (renders[0].getReadPointer (channel), renders[1].getReadPointer (channel),
+                                            sizeof (float) * (size_t) noise.getNumSamples()) == 0;
+
+            numFailed += same ? 0 : 1;
+            std::cout << String (shapeNames[shape]).paddedRight (' ', 29)
+                      << (same ? String ("same") : "differs, " + String (getRmsDecibels (renders[0], &renders[1]), 1) + " dBFS RMS") << std::endl;
+        }
+
+        return numFailed;
+    }
+
+    //==============================================================================
+
+    /*Exponentially decaying noise, the shape of a room's impulse response*/
+    AudioBuffer<float> createImpulseResponse (int numChannels, int length)
+    {
+        AudioBuffer<float> impulseResponse (numChannels, length);
+        Random random (0x1e5);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int sample = 0; sample < length; ++sample)
+                impulseResponse.setSample (channel, sample, (random.nextFloat() * 2.0f - 1.0f)
+                                                            * std::exp (-6.9f * (float) sample / (float) length));
+
+        return impulseResponse;
+    }
+
+    /*What the convolution costs: the convolver alone over a stereo line for every impulse response length and
+    partition size (the one getPartitionSizeFor picks is marked with a *), then one instance with the convolution on
+    at a few host block sizes*/
+    void printConvolution (double secondsPerConfig)
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const int partitionSizes[] = { 64, 128, 256, 512, 1024 };
+
+        std::cout << std::endl << "Convolver (48 kHz, stereo, 256 sample blocks, ns/sample)" << std::endl;
+        std::cout << "IR(ms)  ";
+
+        for (int partitionSize : partitionSizes)
+            std::cout << ("P=" + String (partitionSize)).paddedRight (' ', 10);
+
+        std::cout << std::endl;
+
+        AudioSampleBuffer noise (2, blockSize);
+        Random random (0x5eed);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int sample = 0; sample < blockSize; ++sample)
+                noise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+        const int numBlocks = jmax (16, (int) (secondsPerConfig * sampleRate / blockSize));
+
+        for (double milliseconds : { 10.0, 50.0, 100.0, 250.0, 500.0, 1000.0 })
+        {
+            const int length = (int) (milliseconds * sampleRate / 1000.0);
+            const AudioBuffer<float> impulseResponse = createImpulseResponse (2, length);
+
+            std::cout << String (milliseconds, 0).paddedRight (' ', 8);
+
+            for (int partitionSize : partitionSizes)
+            {
+                PartitionedConvolver convolver (impulseResponse, 2, partitionSize);
+                AudioSampleBuffer buffer (2, blockSize);
+
+                const double ns = timeVoices (1, blockSize, numBlocks, [&] { buffer.makeCopyOf (noise, true); }, [&]
+                {
+                    convolver.process (buffer.getArrayOfWritePointers(), blockSize);
+                });
+
+                const bool chosen = PartitionedConvolver::getPartitionSizeFor (length) == partitionSize;
+                std::cout << (String (ns, 1) + (chosen ? "*" : "")).paddedRight (' ', 10);
+            }
+
+            std::cout << std::endl;
+        }
+
+        std::cout << std::endl << "Convolution in the loop (48 kHz, 250 ms IR, 300 ms delay, feedback 0.7)" << std::endl;
+        std::cout << "block  off(ns/sample)  on(ns/sample)" << std::endl;
+
+        const AudioBuffer<float> impulseResponse = createImpulseResponse (2, (int) (0.25 * sampleRate));
+        MidiBuffer midiMessages;
+
+        for (int hostBlockSize : { 64, 256, 1024 })
+        {
+            const int numHostBlocks = jmax (16, (int) (secondsPerConfig * sampleRate / hostBlockSize));
+            AudioSampleBuffer hostNoise (2, hostBlockSize);
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int sample = 0; sample < hostBlockSize; ++sample)
+                    hostNoise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+            std::cout << String (hostBlockSize).paddedRight (' ', 7);
+
+            for (bool convolution : { false, true })
+            {
+                PingPongDelayAudioProcessor processor;
+                processor.setPlayConfigDetails (2, 2, sampleRate, hostBlockSize);
+                setParameter (processor, "delaytime", 0.3f);
+                setParameter (processor, "feedback", 0.7f);
+                setParameter (processor, "mix", 0.5f);
+                setParameter (processor, "convolution", convolution ? 1.0f : 0.0f);
+                processor.prepareToPlay (sampleRate, hostBlockSize);
+                processor.setImpulseResponse (impulseResponse, sampleRate, "benchmark");
+
+                AudioSampleBuffer buffer (2, hostBlockSize);
+
+                const double ns = timeVoices (1, hostBlockSize, numHostBlocks, [&] { buffer.makeCopyOf (hostNoise, true); }, [&]
+                {
+                    processor.processBlock (buffer, midiMessages);
+                });
+
+                std::cout << String (ns, 3).paddedRight (' ', convolution ? 0 : 16);
+            }
+
+            std::cout << std::endl;
+        }
+    }
+
+    //==============================================================================
+
+    /*2 to 4 bands with the plugin's default band settings, played the way it was done before the multiband mode (one
+    instance per band, each behind a Linkwitz-Riley crossover of IIRFilters like a crossover plugin would use, summed)
+    and by one instance with that many bands. The crossover of a band is the same chain of biquads MultibandDelay
+    runs for it: highpasses below it, lowpasses above it and allpasses for the crossovers further up, so both
+    split the input alike.*/
+    void printMultiband (double secondsPerConfig)
+    {
+        const double sampleRate = 48000.0;
+        const int blockSize = 256;
+        const int numBlocks = jmax (16, (int) (secondsPerConfig * sampleRate / blockSize));
+        const double butterworthQ = 1.0 / std::sqrt (2.0);
+
+        std::cout << std::endl << "Multiband (48 kHz, 256 sample blocks, crossovers at 250 Hz, 2 kHz and 6 kHz)" << std::endl;
+        std::cout << "bands  instances(ns)  multiband(ns)  instances mem(KB)  multiband mem(KB)" << std::endl;
+
+        AudioSampleBuffer noise (2, blockSize);
+        Random random (0x5eed);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int sample = 0; sample < blockSize; ++sample)
+                noise.setSample (channel, sample, random.nextFloat() * 2.0f - 1.0f);
+
+        MidiBuffer midiMessages;
+        PingPongDelayAudioProcessor defaults;
+
+        for (int numBands = 2; numBands <= MultibandDelay::maxBands; ++numBands)
+        {
+            // one instance per band, with its crossover in front
+            OwnedArray<PingPongDelayAudioProcessor> instances;
+            OwnedArray<AudioSampleBuffer> bandBuffers;
+            OwnedArray<IIRFilter> crossoverFilters[MultibandDelay::maxBands];
+            AudioSampleBuffer output (2, blockSize);
+            size_t instancesMemory = 0;
+
+            for (int band = 0; band < numBands; ++band)
+            {
+                PingPongDelayAudioProcessor* processor = instances.add (new PingPongDelayAudioProcessor());
+                processor->setPlayConfigDetails (2, 2, sampleRate, blockSize);
+                setParameter (*processor, "delaytime", defaults.bandParameters[band]->time.getValue());
+                setParameter (*processor, "feedback", defaults.bandParameters[band]->feedback.getValue());
+                setParameter (*processor, "mix", 1.0f);
+                processor->prepareToPlay (sampleRate, blockSize);
+                instancesMemory += processor->getMemoryUsage();
+                bandBuffers.add (new AudioSampleBuffer (2, blockSize));
+
+                for (int crossover = 0; crossover < numBands - 1; ++crossover)
+                {
+                    const double frequency = defaults.crossoverParameters[crossover]->getValue();
+                    const IIRCoefficients coefficients = crossover < band ? IIRCoefficients::makeHighPass (sampleRate, frequency, butterworthQ)
+                                                       : crossover == band ? IIRCoefficients::makeLowPass (sampleRate, frequency, butterworthQ)
+                                                       : IIRCoefficients::makeAllPass (sampleRate, frequency, butterworthQ);
+                    const int numSections = crossover <= band ? 2 : 1;
+
+                    for (int section = 0; section < numSections; ++section)
+                    {
+                        for (int channel = 0; channel < 2; ++channel)
+                        {
+                            IIRFilter* filter = crossoverFilters[band].add (new IIRFilter());
+                            filter->setCoefficients (coefficients);
+                        }
+                    }
+                }
+            }
+
+            const double instancesNs = timeVoices (1, blockSize, numBlocks, [&]
+            {
+                for (auto* buffer : bandBuffers)
+                    buffer->makeCopyOf (noise, true);
+            }, [&]
+            {
+                output.clear();
+
+                for (int band = 0; band < numBands; ++band)
+                {
+                    // the filters of a band take turns between the two channels
+                    for (int filter = 0; filter < crossoverFilters[band].size(); ++filter)
+                        crossoverFilters[band][filter]->processSamples (bandBuffers[band]->getWritePointer (filter & 1), blockSize);
+
+                    instances[band]->processBlock (*bandBuffers[band], midiMessages);
+
+                    for (int channel = 0; channel < 2; ++channel)
+                        output.addFrom (channel, 0, *bandBuffers[band], channel, 0, blockSize);
+                }
+            });
+
+            // one instance with the bands
+            PingPongDelayAudioProcessor processor;
+            processor.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+            setParameter (processor, "bands", (float) (numBands - 1));
+            setParameter (processor, "mix", 1.0f);
+            processor.prepareToPlay (sampleRate, blockSize);
+            AudioSampleBuffer buffer (2, blockSize);
+
+            const double multibandNs = timeVoices (1, blockSize, numBlocks, [&] { buffer.makeCopyOf (noise, true); }, [&]
+            {
+                processor.processBlock (buffer, midiMessages);
+            });
+
+            std::cout << String (numBands).paddedRight (' ', 7)
+                      << String (instancesNs, 3).paddedRight (' ', 15)
+                      << String (multibandNs, 3).paddedRight (' ', 15)
+                      << String ((double) instancesMemory / 1024.0, 0).paddedRight (' ', 19)
+                      << String ((double) processor.getMemoryUsage() / 1024.0, 0) << std::endl;
+        }
+    }
+
+    //==============================================================================
+
+    BenchmarkOptions parseOptions (int argc, char* argv[])
+    {
+        BenchmarkOptions options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const String arg (argv[i]);
+            auto nextValue = [&] { return i + 1 < argc ? String (argv[++i]) : String(); };
+
+            if (arg == "--quick")
+                options.quick = true;
+            else if (arg == "--seconds")
+                options.secondsPerConfig = jmax (0.01, nextValue().getDoubleValue());
+            else if (arg == "--tolerance")
+                options.tolerancePercent = nextValue().getDoubleValue();
+            else if (arg == "--label")
+                options.label = nextValue();
+            else if (arg == "--json")
+                options.jsonFile = File::getCurrentWorkingDirectory().getChildFile (nextValue());
+            else if (arg == "--baseline")
+                options.baselineFile = File::getCurrentWorkingDirectory().getChildFile (nextValue());
+            else
+                std::cerr << "Ignoring unknown option " << arg << std::endl;
+        }
+
+        return options;
+    }
+}
+
+//==============================================================================
+
+int main (int argc, char* argv[])
+{
+    const BenchmarkOptions options = parseOptions (argc, argv);
+    const Array<BenchmarkConfig> matrix = createMatrix (options.quick);
+
+    std::cout << "PingPongDelayAudioProcessor::processBlock on " << SystemStats::getCpuModel() << std::endl;
+    std::cout << "rate     block  delay(s)  fb     interp    store  prec    ch  ns/sample  inst/core   mem(KB)   p50(us)   p90(us)   p99(us)   max(us)" << std::endl;
+
+    Array<BenchmarkResult> results;
+
+    for (auto& config : matrix)
+    {
+        const BenchmarkResult result = runBenchmark (config, options.secondsPerConfig);
+        results.add (result);
+
+        std::cout << String (config.sampleRate, 0).paddedRight (' ', 9)
+                  << String (config.blockSize).paddedRight (' ', 7)
+                  << String (config.delayTime, 3).paddedRight (' ', 10)
+                  << String (config.feedback, 2).paddedRight (' ', 7)
+                  << getInterpolationNames()[config.interpolation].paddedRight (' ', 10)
+                  << getStorageNames()[config.storage].paddedRight (' ', 7)
+                  << String (config.doublePrecision ? "double" : "float").paddedRight (' ', 8)
+                  << String (config.numChannels).paddedRight (' ', 4)
+                  << String (result.nsPerSample, 3).paddedRight (' ', 11)
+                  << String (result.instancesPerCore, 0).paddedRight (' ', 12)
+                  << String ((double) result.memoryBytes / 1024.0, 0).paddedRight (' ', 10)
+                  << String (result.p50, 2).paddedRight (' ', 10)
+                  << String (result.p90, 2).paddedRight (' ', 10)
+                  << String (result.p99, 2).paddedRight (' ', 10)
+                  << String (result.max, 2) << std::endl;
+    }
+
+    printNoiseFloor();
+    printVoicesPerCore (options.quick, options.secondsPerConfig);
+    printMultiTap (options.secondsPerConfig);
+    printFeedbackChain (options.secondsPerConfig);
+    printModulation (options.secondsPerConfig);
+    const int numUnrepeatable = checkRepeatableRenders();
+    printConvolution (options.secondsPerConfig);
+    printMultiband (options.secondsPerConfig);
+
+    if (options.jsonFile != File())
+    {
+        options.jsonFile.replaceWithText (JSON::toString (resultsToJson (results, options)));
+        std::cout << "Wrote " << options.jsonFile.getFullPathName() << std::endl;
+    }
+
+    if (numUnrepeatable > 0)
+        return 1;
+
+    if (options.baselineFile.existsAsFile())
+        return compareWithBaseline (results, options) > 0 ? 1 : 0;
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Frame-time benchmark for PingPongDelayAudioProcessorEditor.
+
+     Opens a number of editors (one per plugin instance, like a session with many plugin windows open) and paints
+     them off screen into an image, the same way the windowing system would ask for it:
+
+      - first frame: the first paint after the editor is created or resized, which draws the cached layer
+      - full frame:  the whole editor, e.g. when the window is uncovered
+      - slider frame: only the area of one slider, which is what moving a slider or automating a parameter repaints
+
+     Every frame paints all editors once, so the times are what one UI refresh costs with that many windows open.
+     At 60 Hz a frame has 16.7 ms.
+
+     Usage: PingPongEditorBenchmark [--editors <n>] [--frames <n>]
+
+  ==============================================================================
+*/
+
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/PluginEditor.h"
+
+#include <iostream>
+
+//==============================================================================
+
+namespace
+{
+    struct EditorBenchmarkOptions
+    {
+        int numEditors = 24;
+        int numFrames = 500;
+    };
+
+    /*Nearest-rank percentile of an already sorted array*/
+    double percentile (const Array<double>& sortedTimes, double fraction)
+    {
+        const int index = jlimit (0, sortedTimes.size() - 1, (int) std::ceil (fraction * sortedTimes.size()) - 1);
+        return sortedTimes[index];
+    }
+
+    /*Paints the area of every editor into the frame image and returns the time it took in milliseconds*/
+    double paintFrame (const OwnedArray<AudioProcessorEditor>& editors, Image& frame, Rectangle<int> area)
+    {
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (auto* editor : editors)
+        {
+            Graphics g (frame);
+            g.reduceClipRegion (area);
+            editor->paintEntireComponent (g, true);
+        }
+
+        return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1.0e3;
+    }
+
+    void printFrameTimes (const String& name, Array<double> frameTimes)
+    {
+        frameTimes.sort();
+
+        double total = 0.0;
+
+        for (auto time : frameTimes)
+            total += time;
+
+        const double mean = total / jmax (1, frameTimes.size());
+
+        std::cout << name.paddedRight (' ', 15)
+                  << String (mean, 3).paddedRight (' ', 11)
+                  << String (percentile (frameTimes, 0.50), 3).paddedRight (' ', 10)
+                  << String (percentile (frameTimes, 0.99), 3).paddedRight (' ', 10)
+                  << String (frameTimes.getLast(), 3).paddedRight (' ', 10)
+                  << String (100.0 * mean / (1000.0 / 60.0), 1) << std::endl;
+    }
+
+    EditorBenchmarkOptions parseOptions (int argc, char* argv[])
+    {
+        EditorBenchmarkOptions options;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const String arg (argv[i]);
+            auto nextValue = [&] { return i + 1 < argc ? String (argv[++i]) : String(); };
+
+            if (arg == "--editors")
+                options.numEditors = jmax (1, nextValue().getIntValue());
+            else if (arg == "--frames")
+                options.numFrames = jmax (1, nextValue().getIntValue());
+            else
+                std::cerr << "Ignoring unknown option " << arg << std::endl;
+        }
+
+        return options;
+    }
+}
+
+//==============================================================================
+
+int main (int argc, char* argv[])
+{
+    const EditorBenchmarkOptions options = parseOptions (argc, argv);
+
+    // fonts, the image cache and components need JUCE's GUI side to be set up
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    OwnedArray<PingPongDelayAudioProcessor> processors;
+    OwnedArray<AudioProcessorEditor> editors;
+
+    for (int i = 0; i < options.numEditors; ++i)
+        editors.add (processors.add (new PingPongDelayAudioProcessor())->createEditor());
+
+    const Rectangle<int> bounds = editors.getFirst()->getLocalBounds();
+    Image frame (Image::RGB, bounds.getWidth(), bounds.getHeight(), true);
+
+    // the first slider stands for any control that repaints itself
+    Rectangle<int> sliderArea = bounds;
+
+    for (int i = 0; i < editors.getFirst()->getNumChildComponents(); ++i)
+    {
+        if (auto* slider = dynamic_cast<Slider*> (editors.getFirst()->getChildComponent (i)))
+        {
+            sliderArea = slider->getBounds();
+            break;
+        }
+    }
+
+    std::cout << "PingPongDelayAudioProcessorEditor::paint, " << options.numEditors << " editors of "
+              << bounds.getWidth() << "x" << bounds.getHeight() << " on " << SystemStats::getCpuModel() << std::endl;
+    std::cout << "frame          mean(ms)   p50(ms)   p99(ms)   max(ms)   of 60 Hz (%)" << std::endl;
+
+    Array<double> firstFrameTimes, fullFrameTimes, sliderFrameTimes;
+
+    for (int i = 0; i < jmax (1, options.numFrames / 10); ++i)
+    {
+        // resizing drops the cached layer, so the next paint draws it again
+        for (auto* editor : editors)
+            editor->resized();
+
+        firstFrameTimes.add (paintFrame (editors, frame, bounds));
+    }
+
+    for (int i = 0; i < options.numFrames; ++i)
+        fullFrameTimes.add (paintFrame (editors, frame, bounds));
+
+    for (int i = 0; i < options.numFrames; ++i)
+        sliderFrameTimes.add (paintFrame (editors, frame, sliderArea));
+
+    printFrameTimes ("first", firstFrameTimes);
+    printFrameTimes ("full", fullFrameTimes);
+    printFrameTimes ("slider", sliderFrameTimes);
+
+    editors.clear();
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     The segment loop of the ping-pong delay, written once for every instruction set.
+
+     DelayKernels.cpp includes this file several times, each time inside its own namespace that
+     first defines "Ops<float>" and "Ops<double>" (the vector types of one instruction set with their
+     loads, stores and arithmetic). That way the AVX2 copy can be compiled with AVX2 enabled while the rest of the
+     plugin isn't. There is deliberately no #pragma once.
+
+  ==============================================================================
+*/
+
+/*The input of a channel scaled as in getInputGain, for one vector*/
+template <typename O>
+static inline typename O::V applyInputGainVector (Side side, typename O::V one, typename O::V balance, typename O::V input)
+{
+    if (side == Side::both)
+        return input;
+
+    return O::mul (side == Side::left ? O::sub (one, balance) : balance, input);
+}
+
+/*Processes samples [start, end) of the segment, O::width samples at a time, and returns the first
+sample it didn't process. Taps are summed from newest to oldest in every version, so they all round the same way.
+numChannels is a constant, so the channel loops below are unrolled and in/out stay in registers.*/
+template <typename O, int numChannels, typename Interpolator, bool ramped, typename SampleType>
+static inline int processRange (const Segment<SampleType>& s, const SampleType* weights, int start, int end)
+{
+    using V = typename O::V;
+    const int numTaps = Interpolator::numTaps;
+
+    V tapWeights[numTaps];
+
+    for (int tap = 0; tap < numTaps; ++tap)
+        tapWeights[tap] = O::set1 (weights[tap]);
+
+    const V one = O::set1 (SampleType (1));
+    int sample = start;
+
+    for (; sample + O::width <= end; sample += O::width)
+    {
+        const V balance = ramped ? O::loadRamp (s.balanceRamp + sample) : O::set1 (s.balance);
+        const V feedback = ramped ? O::loadRamp (s.feedbackRamp + sample) : O::set1 (s.feedback);
+        const V mix = ramped ? O::loadRamp (s.mixRamp + sample) : O::set1 (s.mix);
+
+        V in[numChannels];
+        V out[numChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            in[channel] = applyInputGainVector<O> (s.sides[channel], one, balance, O::load (s.io[channel] + sample));
+
+            // read[channel][sample] is the newest tap, read[channel][sample - tap] the older ones
+            const SampleType* read = s.read[channel] + sample;
+            out[channel] = O::mul (tapWeights[0], O::load (read));
+
+            for (int tap = 1; tap < numTaps; ++tap)
+                out[channel] = O::add (out[channel], O::mul (tapWeights[tap], O::load (read - tap)));
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            O::store (s.io[channel] + sample, O::add (in[channel], O::mul (mix, O::sub (out[channel], in[channel]))));
+
+        // the delayed signal of each channel is fed back into the next one (ping-pong)
+        for (int channel = 0; channel < numChannels; ++channel)
+            O::store (s.write[channel] + sample, O::add (in[channel], O::mul (out[getPreviousChannel<numChannels> (channel)], feedback)));
+    }
+
+    return sample;
+}
+
+/*Whatever doesn't fill a whole vector at the end of the segment goes through the same code one sample at a time*/
+template <typename SampleType, int numChannels, typename Interpolator, bool ramped>
+static void processSegment (const Segment<SampleType>& s)
+{
+    SampleType weights[Interpolator::numTaps];
+    Interpolator::computeWeights (s.fraction, weights);
+
+    const int done = processRange<Ops<SampleType>, numChannels, Interpolator, ramped> (s, weights, 0, s.numSamples);
+    processRange<ScalarOps<SampleType>, numChannels, Interpolator, ramped> (s, weights, done, s.numSamples);
+    Ops<SampleType>::finish();
+}
+
+template <typename SampleType, int numChannels, typename Interpolator>
+static void process (const Segment<SampleType>& s)
+{
+    if (s.balanceRamp != nullptr)
+        processSegment<SampleType, numChannels, Interpolator, true> (s);
+    else
+        processSegment<SampleType, numChannels, Interpolator, false> (s);
+}
+
+//==============================================================================
+
+/*Samples [start, end) of a gather block, O::width samples at a time. weights holds each tap's interpolator weights
+times its gain, sendWeights the same times its cross-feed. All taps are summed in registers, so out and send are
+loaded and stored once however many taps there are.*/
+template <typename O, typename Interpolator, bool sending, typename SampleType>
+static inline int gatherRange (const GatherBlock<SampleType>& g, const SampleType (*weights)[Interpolator::numTaps],
+                               const SampleType (*sendWeights)[Interpolator::numTaps], int start, int end)
+{
+    using V = typename O::V;
+    int sample = start;
+
+    for (; sample + O::width <= end; sample += O::width)
+    {
+        V wet = O::set1 (SampleType (0));
+        V sent = O::set1 (SampleType (0));
+
+        for (int tap = 0; tap < g.numTaps; ++tap)
+        {
+            const SampleType* read = g.read[tap] + sample;
+
+            for (int weight = 0; weight < Interpolator::numTaps; ++weight)
+            {
+                const V delayed = O::load (read - weight);
+                wet = O::add (wet, O::mul (O::set1 (weights[tap][weight]), delayed));
+
+                if (sending)
+                    sent = O::add (sent, O::mul (O::set1 (sendWeights[tap][weight]), delayed));
+            }
+        }
+
+        O::store (g.out + sample, O::add (O::load (g.out + sample), wet));
+
+        if (sending)
+            O::store (g.send + sample, O::add (O::load (g.send + sample), sent));
+    }
+
+    return sample;
+}
+
+template <typename SampleType, typename Interpolator, bool sending>
+static void gatherTaps (const GatherBlock<SampleType>& g)
+{
+    SampleType weights[GatherBlock<SampleType>::maxTaps][Interpolator::numTaps];
+    SampleType sendWeights[GatherBlock<SampleType>::maxTaps][Interpolator::numTaps];
+
+    for (int tap = 0; tap < g.numTaps; ++tap)
+    {
+        SampleType tapWeights[Interpolator::numTaps];
+        Interpolator::computeWeights (g.fraction[tap], tapWeights);
+
+        for (int weight = 0; weight < Interpolator::numTaps; ++weight)
+        {
+            weights[tap][weight] = g.gain[tap] * tapWeights[weight];
+            sendWeights[tap][weight] = g.crossFeed[tap] * tapWeights[weight];
+        }
+    }
+
+    const int done = gatherRange<Ops<SampleType>, Interpolator, sending> (g, weights, sendWeights, 0, g.numSamples);
+    gatherRange<ScalarOps<SampleType>, Interpolator, sending> (g, weights, sendWeights, done, g.numSamples);
+    Ops<SampleType>::finish();
+}
+
+template <typename SampleType, typename Interpolator>
+static void gather (const GatherBlock<SampleType>& g)
+{
+    if (g.send != nullptr)
+        gatherTaps<SampleType, Interpolator, true> (g);
+    else
+        gatherTaps<SampleType, Interpolator, false> (g);
+}
+
+template <typename SampleType>
+static GatherKernel<SampleType> getGatherKernel (InterpolationType type)
+{
+    switch (type)
+    {
+        case InterpolationType::integer:  return gather<SampleType, IntegerInterpolation>;
+        case InterpolationType::lagrange: return gather<SampleType, LagrangeInterpolation>;
+        case InterpolationType::hermite:  return gather<SampleType, HermiteInterpolation>;
+        case InterpolationType::sinc:     return gather<SampleType, SincInterpolation>;
+        case InterpolationType::linear:
+        case InterpolationType::allpass:  break;
+    }
+
+    return gather<SampleType, LinearInterpolation>;
+}
+
+//==============================================================================
+
+/*The allpass is recursive and always runs on the scalar loop*/
+template <typename SampleType, int numChannels>
+static Kernel<SampleType> getKernelFor (InterpolationType type)
+{
+    switch (type)
+    {
+        case InterpolationType::integer:  return process<SampleType, numChannels, IntegerInterpolation>;
+        case InterpolationType::linear:   return process<SampleType, numChannels, LinearInterpolation>;
+        case InterpolationType::lagrange: return process<SampleType, numChannels, LagrangeInterpolation>;
+        case InterpolationType::hermite:  return process<SampleType, numChannels, HermiteInterpolation>;
+        case InterpolationType::sinc:     return process<SampleType, numChannels, SincInterpolation>;
+        case InterpolationType::allpass:  return processAllpass<SampleType, numChannels>;
+    }
+
+    return process<SampleType, numChannels, LinearInterpolation>;
+}
+
+template <typename SampleType>
+static Kernel<SampleType> getKernel (InterpolationType type, int numChannels)
+{
+    switch (numChannels)
+    {
+        case 1:  return getKernelFor<SampleType, 1> (type);
+        case 4:  return getKernelFor<SampleType, 4> (type);
+        case 5:  return getKernelFor<SampleType, 5> (type);
+        case 7:  return getKernelFor<SampleType, 7> (type);
+        default: return getKernelFor<SampleType, 2> (type);
+    }
+}
@@ -0,0 +1,764 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Scalar, SSE2, AVX2 and NEON versions of the ping-pong delay loop, in float and double.
+
+     Every version does exactly the same arithmetic in the same order as the scalar loop
+     (no fused multiply-add), so switching kernels never changes the output. The loop itself
+     lives in DelayKernelLoops.h and is compiled once for each instruction set below.
+
+  ==============================================================================
+*/
+
+#include "DelayKernels.h"
+
+#if JUCE_INTEL && (defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2))
+ #define PINGPONG_USE_SSE2 1
+ #include <immintrin.h>
+#endif
+
+#if JUCE_ARM && (defined (__ARM_NEON) || defined (__ARM_NEON__))
+ #define PINGPONG_USE_NEON 1
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+
+namespace DelayKernels
+{
+    /*Plain floats or doubles with the same interface as the vector types below. Also used for the tail of every
+    vector loop. loadRamp reads the (always float) parameter ramps.*/
+    template <typename SampleType>
+    struct ScalarOps
+    {
+        using V = SampleType;
+        enum { width = 1 };
+
+        static V load (const SampleType* p)     { return *p; }
+        static V loadRamp (const float* p)      { return (V)*p; }
+        static void store (SampleType* p, V v)  { *p = v; }
+        static V set1 (SampleType v)            { return v; }
+        static V add (V a, V b)                 { return a + b; }
+        static V sub (V a, V b)                 { return a - b; }
+        static V mul (V a, V b)                 { return a * b; }
+        static void finish()                    {}
+    };
+
+    /*The input of a channel scaled as in getInputGain, one sample at a time (the vector version is in DelayKernelLoops.h)*/
+    template <typename SampleType>
+    static inline SampleType applyInputGain (Side side, SampleType balance, SampleType input)
+    {
+        if (side == Side::both)
+            return input;
+
+        return (side == Side::left ? SampleType (1) - balance : balance) * input;
+    }
+
+    /*The channel whose echo is fed into this one*/
+    template <int numChannels>
+    static inline int getPreviousChannel (int channel)
+    {
+        return channel == 0 ? numChannels - 1 : channel - 1;
+    }
+
+    //==============================================================================
+
+    /*Thiran allpass. The fraction is moved into [0.5, 1.5) by starting one sample newer when it is below 0.5,
+    which is why the read pointers point one sample ahead of the near tap.*/
+    template <typename SampleType, int numChannels, bool ramped>
+    static void processAllpassImpl (const Segment<SampleType>& s)
+    {
+        const bool useNewerTap = s.fraction < SampleType (0.5);
+        const SampleType coefficient = AllpassInterpolation::getCoefficient (useNewerTap ? s.fraction + SampleType (1) : s.fraction);
+
+        const SampleType* read[numChannels];
+        SampleType last[numChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            read[channel] = useNewerTap ? s.read[channel] : s.read[channel] - 1;
+            last[channel] = (SampleType)s.allpassState[channel];
+        }
+
+        for (int sample = 0; sample < s.numSamples; ++sample)
+        {
+            const SampleType balance = ramped ? (SampleType)s.balanceRamp[sample] : s.balance;
+            const SampleType feedback = ramped ? (SampleType)s.feedbackRamp[sample] : s.feedback;
+            const SampleType mix = ramped ? (SampleType)s.mixRamp[sample] : s.mix;
+
+            SampleType in[numChannels];
+            SampleType out[numChannels];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                in[channel] = applyInputGain (s.sides[channel], balance, s.io[channel][sample]);
+                out[channel] = coefficient * read[channel][sample] + read[channel][sample - 1] - coefficient * last[channel];
+                last[channel] = out[channel];
+            }
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                s.io[channel][sample] = in[channel] + mix * (out[channel] - in[channel]);
+                s.write[channel][sample] = in[channel] + out[getPreviousChannel<numChannels> (channel)] * feedback;
+            }
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            s.allpassState[channel] = last[channel];
+    }
+
+    template <typename SampleType, int numChannels>
+    static void processAllpass (const Segment<SampleType>& s)
+    {
+        if (s.balanceRamp != nullptr)
+            processAllpassImpl<SampleType, numChannels, true> (s);
+        else
+            processAllpassImpl<SampleType, numChannels, false> (s);
+    }
+
+    //==============================================================================
+
+    namespace Scalar
+    {
+        template <typename SampleType>
+        using Ops = ScalarOps<SampleType>;
+
+        #include "DelayKernelLoops.h"
+    }
+
+   #if PINGPONG_USE_SSE2
+    namespace SSE2
+    {
+        template <typename SampleType>
+        struct Ops;
+
+        template <>
+        struct Ops<float>
+        {
+            using V = __m128;
+            enum { width = 4 };
+
+            static V load (const float* p)      { return _mm_loadu_ps (p); }
+            static V loadRamp (const float* p)  { return _mm_loadu_ps (p); }
+            static void store (float* p, V v)   { _mm_storeu_ps (p, v); }
+            static V set1 (float v)             { return _mm_set1_ps (v); }
+            static V add (V a, V b)             { return _mm_add_ps (a, b); }
+            static V sub (V a, V b)             { return _mm_sub_ps (a, b); }
+            static V mul (V a, V b)             { return _mm_mul_ps (a, b); }
+            static void finish()                {}
+        };
+
+        template <>
+        struct Ops<double>
+        {
+            using V = __m128d;
+            enum { width = 2 };
+
+            static V load (const double* p)     { return _mm_loadu_pd (p); }
+            static V loadRamp (const float* p)  { return _mm_cvtps_pd (_mm_castsi128_ps (_mm_loadl_epi64 ((const __m128i*)p))); }
+            static void store (double* p, V v)  { _mm_storeu_pd (p, v); }
+            static V set1 (double v)            { return _mm_set1_pd (v); }
+            static V add (V a, V b)             { return _mm_add_pd (a, b); }
+            static V sub (V a, V b)             { return _mm_sub_pd (a, b); }
+            static V mul (V a, V b)             { return _mm_mul_pd (a, b); }
+            static void finish()                {}
+        };
+
+        #include "DelayKernelLoops.h"
+    }
+
+    // GCC and Clang only emit AVX instructions inside functions that ask for them (MSVC always can),
+    // so everything in this namespace, including the template instantiations, is compiled for AVX2.
+   #if JUCE_CLANG
+    #pragma clang attribute push (__attribute__ ((target ("avx2"))), apply_to = function)
+   #elif JUCE_GCC
+    #pragma GCC push_options
+    #pragma GCC target ("avx2")
+   #endif
+
+    namespace AVX2
+    {
+        template <typename SampleType>
+        struct Ops;
+
+        template <>
+        struct Ops<float>
+        {
+            using V = __m256;
+            enum { width = 8 };
+
+            static V load (const float* p)      { return _mm256_loadu_ps (p); }
+            static V loadRamp (const float* p)  { return _mm256_loadu_ps (p); }
+            static void store (float* p, V v)   { _mm256_storeu_ps (p, v); }
+            static V set1 (float v)             { return _mm256_set1_ps (v); }
+            static V add (V a, V b)             { return _mm256_add_ps (a, b); }
+            static V sub (V a, V b)             { return _mm256_sub_ps (a, b); }
+            static V mul (V a, V b)             { return _mm256_mul_ps (a, b); }
+
+            // leaves the upper halves of the registers clean before any SSE code runs again
+            static void finish()                { _mm256_zeroupper(); }
+        };
+
+        template <>
+        struct Ops<double>
+        {
+            using V = __m256d;
+            enum { width = 4 };
+
+            static V load (const double* p)     { return _mm256_loadu_pd (p); }
+            static V loadRamp (const float* p)  { return _mm256_cvtps_pd (_mm_loadu_ps (p)); }
+            static void store (double* p, V v)  { _mm256_storeu_pd (p, v); }
+            static V set1 (double v)            { return _mm256_set1_pd (v); }
+            static V add (V a, V b)             { return _mm256_add_pd (a, b); }
+            static V sub (V a, V b)             { return _mm256_sub_pd (a, b); }
+            static V mul (V a, V b)             { return _mm256_mul_pd (a, b); }
+            static void finish()                { _mm256_zeroupper(); }
+        };
+
+        #include "DelayKernelLoops.h"
+    }
+
+   #if JUCE_CLANG
+    #pragma clang attribute pop
+   #elif JUCE_GCC
+    #pragma GCC pop_options
+   #endif
+   #endif
+
+   #if PINGPONG_USE_NEON
+    namespace Neon
+    {
+        template <typename SampleType>
+        struct Ops;
+
+        template <>
+        struct Ops<float>
+        {
+            using V = float32x4_t;
+            enum { width = 4 };
+
+            static V load (const float* p)      { return vld1q_f32 (p); }
+            static V loadRamp (const float* p)  { return vld1q_f32 (p); }
+            static void store (float* p, V v)   { vst1q_f32 (p, v); }
+            static V set1 (float v)             { return vdupq_n_f32 (v); }
+            static V add (V a, V b)             { return vaddq_f32 (a, b); }
+            static V sub (V a, V b)             { return vsubq_f32 (a, b); }
+            static V mul (V a, V b)             { return vmulq_f32 (a, b); }
+            static void finish()                {}
+        };
+
+        // 32-bit ARM has no double precision vectors
+       #if defined (__aarch64__)
+        template <>
+        struct Ops<double>
+        {
+            using V = float64x2_t;
+            enum { width = 2 };
+
+            static V load (const double* p)     { return vld1q_f64 (p); }
+            static V loadRamp (const float* p)  { return vcvt_f64_f32 (vld1_f32 (p)); }
+            static void store (double* p, V v)  { vst1q_f64 (p, v); }
+            static V set1 (double v)            { return vdupq_n_f64 (v); }
+            static V add (V a, V b)             { return vaddq_f64 (a, b); }
+            static V sub (V a, V b)             { return vsubq_f64 (a, b); }
+            static V mul (V a, V b)             { return vmulq_f64 (a, b); }
+            static void finish()                {}
+        };
+       #else
+        template <>
+        struct Ops<double> : public ScalarOps<double> {};
+       #endif
+
+        #include "DelayKernelLoops.h"
+    }
+   #endif
+
+    //==============================================================================
+
+    template <typename SampleType>
+    Kernel<SampleType> getScalarKernel (InterpolationType type, int numChannels)
+    {
+        return Scalar::getKernel<SampleType> (type, numChannels);
+    }
+
+    template <typename SampleType>
+    Kernel<SampleType> getVectorKernel (InterpolationType type, int numChannels)
+    {
+       #if PINGPONG_USE_SSE2
+        static const bool useAVX2 = SystemStats::hasAVX2();
+        return useAVX2 ? AVX2::getKernel<SampleType> (type, numChannels) : SSE2::getKernel<SampleType> (type, numChannels);
+       #elif PINGPONG_USE_NEON
+        return Neon::getKernel<SampleType> (type, numChannels);
+       #else
+        return Scalar::getKernel<SampleType> (type, numChannels);
+       #endif
+    }
+
+    template <typename SampleType>
+    GatherKernel<SampleType> getGatherKernel (InterpolationType type)
+    {
+       #if PINGPONG_USE_SSE2
+        static const bool useAVX2 = SystemStats::hasAVX2();
+        return useAVX2 ? AVX2::getGatherKernel<SampleType> (type) : SSE2::getGatherKernel<SampleType> (type);
+       #elif PINGPONG_USE_NEON
+        return Neon::getGatherKernel<SampleType> (type);
+       #else
+        return Scalar::getGatherKernel<SampleType> (type);
+       #endif
+    }
+
+    //==============================================================================
+
+    /*The ring is read and written one sample at a time here, so each sample is converted on its own through the codec
+    of the storage format. A tap reads the delayed sample of every channel at a given delay behind the write position.*/
+    template <typename SampleType, int numChannels, typename Codec, typename Interpolator>
+    struct InterpolatedTap
+    {
+        using Type = typename Codec::Type;
+
+        explicit InterpolatedTap (const double*) {}
+
+        void read (Type* const* delay, int writePosition, int mask, float delaySamples, SampleType* out)
+        {
+            const int delayWhole = (int)delaySamples;
+            const SampleType fraction = (SampleType)(delaySamples - (float)delayWhole);
+            const int newestPosition = (writePosition - delayWhole + Interpolator::tapsAhead) & mask;
+
+            SampleType weights[Interpolator::numTaps];
+            Interpolator::computeWeights (fraction, weights);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                out[channel] = weights[0] * (SampleType)Codec::decode (delay[channel][newestPosition]);
+
+                for (int tap = 1; tap < Interpolator::numTaps; ++tap)
+                    out[channel] += weights[tap] * (SampleType)Codec::decode (delay[channel][(newestPosition - tap) & mask]);
+            }
+        }
+
+        void save (double*) const {}
+
+        /*One channel at its own delay, for the swept read head*/
+        static SampleType readChannel (const Type* delay, int writePosition, int mask, float delaySamples)
+        {
+            const int delayWhole = (int)delaySamples;
+            const SampleType fraction = (SampleType)(delaySamples - (float)delayWhole);
+            const int newestPosition = (writePosition - delayWhole + Interpolator::tapsAhead) & mask;
+
+            SampleType weights[Interpolator::numTaps];
+            Interpolator::computeWeights (fraction, weights);
+
+            SampleType out = weights[0] * (SampleType)Codec::decode (delay[newestPosition]);
+
+            for (int tap = 1; tap < Interpolator::numTaps; ++tap)
+                out += weights[tap] * (SampleType)Codec::decode (delay[(newestPosition - tap) & mask]);
+
+            return out;
+        }
+    };
+
+    /*The allpass interpolator is recursive, so its tap carries the last output of every channel*/
+    template <typename SampleType, int numChannels, typename Codec>
+    struct AllpassTap
+    {
+        using Type = typename Codec::Type;
+
+        explicit AllpassTap (const double* state)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+                last[channel] = (SampleType)state[channel];
+        }
+
+        void read (Type* const* delay, int writePosition, int mask, float delaySamples, SampleType* out)
+        {
+            const int delayWhole = (int)delaySamples;
+            const SampleType fraction = (SampleType)(delaySamples - (float)delayWhole);
+
+            const bool useNewerTap = fraction < SampleType (0.5);
+            const SampleType coefficient = AllpassInterpolation::getCoefficient (useNewerTap ? fraction + SampleType (1) : fraction);
+            const int position = (writePosition - delayWhole + (useNewerTap ? 1 : 0)) & mask;
+            const int previousPosition = (position - 1) & mask;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                out[channel] = coefficient * (SampleType)Codec::decode (delay[channel][position])
+                             + (SampleType)Codec::decode (delay[channel][previousPosition]) - coefficient * last[channel];
+                last[channel] = out[channel];
+            }
+        }
+
+        void save (double* state) const
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+                state[channel] = last[channel];
+        }
+
+        SampleType last[numChannels];
+    };
+
+    template <typename SampleType, int numChannels, typename Codec, typename Tap>
+    static void processModulatedImpl (const ModulatedBlock<SampleType>& b)
+    {
+        using Type = typename Codec::Type;
+
+        Type* delay[numChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            delay[channel] = (Type*)b.delay[channel];
+
+        Tap tap (b.allpassState);
+
+        for (int sample = 0; sample < b.numSamples; ++sample)
+        {
+            const SampleType balance = (SampleType)b.balance[sample];
+            const int writePosition = (b.writePosition + sample) & b.mask;
+
+            SampleType in[numChannels];
+            SampleType out[numChannels];
+
+            tap.read (delay, writePosition, b.mask, b.delaySamples[sample], out);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                in[channel] = applyInputGain (b.sides[channel], balance, b.io[channel][sample]);
+
+            const SampleType mix = (SampleType)b.mix[sample];
+            const SampleType feedback = (SampleType)b.feedback[sample];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                b.io[channel][sample] = in[channel] + mix * (out[channel] - in[channel]);
+                delay[channel][writePosition] = Codec::encode (in[channel] + out[getPreviousChannel<numChannels> (channel)] * feedback);
+            }
+        }
+
+        tap.save (b.allpassState);
+    }
+
+    /*The modulated loop with the old tap faded out under the new one*/
+    template <typename SampleType, int numChannels, typename Codec, typename Tap>
+    static void processCrossfadeImpl (const CrossfadeBlock<SampleType>& b)
+    {
+        using Type = typename Codec::Type;
+
+        Type* delay[numChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            delay[channel] = (Type*)b.delay[channel];
+
+        Tap tap (b.allpassState);
+        Tap fadeTap (b.fadeAllpassState);
+
+        for (int sample = 0; sample < b.numSamples; ++sample)
+        {
+            const SampleType balance = (SampleType)b.balance[sample];
+            const int writePosition = (b.writePosition + sample) & b.mask;
+
+            SampleType in[numChannels];
+            SampleType out[numChannels];
+            SampleType faded[numChannels];
+
+            tap.read (delay, writePosition, b.mask, b.delaySamples[sample], out);
+            fadeTap.read (delay, writePosition, b.mask, b.fadeDelaySamples, faded);
+
+            const SampleType fade = (SampleType)b.fade[sample];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                in[channel] = applyInputGain (b.sides[channel], balance, b.io[channel][sample]);
+                out[channel] = faded[channel] + fade * (out[channel] - faded[channel]);
+            }
+
+            const SampleType mix = (SampleType)b.mix[sample];
+            const SampleType feedback = (SampleType)b.feedback[sample];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                b.io[channel][sample] = in[channel] + mix * (out[channel] - in[channel]);
+                delay[channel][writePosition] = Codec::encode (in[channel] + out[getPreviousChannel<numChannels> (channel)] * feedback);
+            }
+        }
+
+        tap.save (b.allpassState);
+        fadeTap.save (b.fadeAllpassState);
+    }
+
+    /*The modulated loop with a read position of its own for every channel. The weights are computed per channel,
+    the channels don't share a fraction any more.*/
+    template <typename SampleType, int numChannels, typename Codec, bool crossfading>
+    static void processVibratoImpl (const VibratoBlock<SampleType>& b)
+    {
+        using Type = typename Codec::Type;
+        using Tap = InterpolatedTap<SampleType, numChannels, Codec, SincInterpolation>;
+
+        Type* delay[numChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            delay[channel] = (Type*)b.delay[channel];
+
+        for (int sample = 0; sample < b.numSamples; ++sample)
+        {
+            const SampleType balance = (SampleType)b.balance[sample];
+            const int writePosition = (b.writePosition + sample) & b.mask;
+            const float delaySamples = b.delaySamples[sample];
+
+            SampleType in[numChannels];
+            SampleType out[numChannels];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const float offset = b.modulation[channel][sample];
+                out[channel] = Tap::readChannel (delay[channel], writePosition, b.mask,
+                                                 jlimit (b.minimumDelay, b.maximumDelay, delaySamples + offset));
+
+                if (crossfading)
+                {
+                    const SampleType faded = Tap::readChannel (delay[channel], writePosition, b.mask,
+                                                               jlimit (b.minimumDelay, b.maximumDelay, b.fadeDelaySamples + offset));
+                    out[channel] = faded + (SampleType)b.fade[sample] * (out[channel] - faded);
+                }
+
+                in[channel] = applyInputGain (b.sides[channel], balance, b.io[channel][sample]);
+            }
+
+            const SampleType mix = (SampleType)b.mix[sample];
+            const SampleType feedback = (SampleType)b.feedback[sample];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                b.io[channel][sample] = in[channel] + mix * (out[channel] - in[channel]);
+                delay[channel][writePosition] = Codec::encode (in[channel] + out[getPreviousChannel<numChannels> (channel)] * feedback);
+            }
+        }
+    }
+
+    /*The crossfade is picked here rather than per sample, so the loop without one doesn't carry its second tap*/
+    template <typename SampleType, int numChannels, typename Codec>
+    static void processVibrato (const VibratoBlock<SampleType>& b)
+    {
+        if (b.fade != nullptr)
+            processVibratoImpl<SampleType, numChannels, Codec, true> (b);
+        else
+            processVibratoImpl<SampleType, numChannels, Codec, false> (b);
+    }
+
+    template <typename SampleType, typename Codec>
+    static VibratoKernel<SampleType> getVibratoKernelFor (int numChannels)
+    {
+        switch (numChannels)
+        {
+            case 1:  return processVibrato<SampleType, 1, Codec>;
+            case 4:  return processVibrato<SampleType, 4, Codec>;
+            case 5:  return processVibrato<SampleType, 5, Codec>;
+            case 7:  return processVibrato<SampleType, 7, Codec>;
+            default: return processVibrato<SampleType, 2, Codec>;
+        }
+    }
+
+    /*Only reads, for the extra taps. Taps are never allpass taps (see getTapKernel), so there is no state to keep.*/
+    template <typename SampleType, int numChannels, typename Codec, typename Tap>
+    static void processTapImpl (const TapBlock<SampleType>& b)
+    {
+        using Type = typename Codec::Type;
+
+        Type* delay[numChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            delay[channel] = (Type*)b.delay[channel];
+
+        const double state[numChannels] = {};
+        Tap tap (state);
+
+        for (int sample = 0; sample < b.numSamples; ++sample)
+        {
+            SampleType out[numChannels];
+            tap.read (delay, (b.writePosition + sample) & b.mask, b.mask, b.delaySamples[sample], out);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                b.out[channel][sample] = out[channel];
+        }
+    }
+
+    /*Picks the modulated, the crossfading or the tap loop, by the type of kernel asked for*/
+    template <typename SampleType, int numChannels, typename Codec, typename Tap>
+    static ModulatedKernel<SampleType> getLoop (ModulatedKernel<SampleType>)
+    {
+        return processModulatedImpl<SampleType, numChannels, Codec, Tap>;
+    }
+
+    template <typename SampleType, int numChannels, typename Codec, typename Tap>
+    static CrossfadeKernel<SampleType> getLoop (CrossfadeKernel<SampleType>)
+    {
+        return processCrossfadeImpl<SampleType, numChannels, Codec, Tap>;
+    }
+
+    template <typename SampleType, int numChannels, typename Codec, typename Tap>
+    static TapKernel<SampleType> getLoop (TapKernel<SampleType>)
+    {
+        return processTapImpl<SampleType, numChannels, Codec, Tap>;
+    }
+
+    template <typename KernelType, typename SampleType, int numChannels, typename Codec>
+    static KernelType getModulatedKernelFor (InterpolationType type)
+    {
+        switch (type)
+        {
+            case InterpolationType::integer:  return getLoop<SampleType, numChannels, Codec, InterpolatedTap<SampleType, numChannels, Codec, IntegerInterpolation>> (KernelType());
+            case InterpolationType::linear:   return getLoop<SampleType, numChannels, Codec, InterpolatedTap<SampleType, numChannels, Codec, LinearInterpolation>> (KernelType());
+            case InterpolationType::lagrange: return getLoop<SampleType, numChannels, Codec, InterpolatedTap<SampleType, numChannels, Codec, LagrangeInterpolation>> (KernelType());
+            case InterpolationType::hermite:  return getLoop<SampleType, numChannels, Codec, InterpolatedTap<SampleType, numChannels, Codec, HermiteInterpolation>> (KernelType());
+            case InterpolationType::sinc:     return getLoop<SampleType, numChannels, Codec, InterpolatedTap<SampleType, numChannels, Codec, SincInterpolation>> (KernelType());
+            case InterpolationType::allpass:  return getLoop<SampleType, numChannels, Codec, AllpassTap<SampleType, numChannels, Codec>> (KernelType());
+        }
+
+        return getLoop<SampleType, numChannels, Codec, InterpolatedTap<SampleType, numChannels, Codec, LinearInterpolation>> (KernelType());
+    }
+
+    template <typename KernelType, typename SampleType, typename Codec>
+    static KernelType getModulatedKernelFor (InterpolationType type, int numChannels)
+    {
+        switch (numChannels)
+        {
+            case 1:  return getModulatedKernelFor<KernelType, SampleType, 1, Codec> (type);
+            case 4:  return getModulatedKernelFor<KernelType, SampleType, 4, Codec> (type);
+            case 5:  return getModulatedKernelFor<KernelType, SampleType, 5, Codec> (type);
+            case 7:  return getModulatedKernelFor<KernelType, SampleType, 7, Codec> (type);
+            default: return getModulatedKernelFor<KernelType, SampleType, 2, Codec> (type);
+        }
+    }
+
+    template <typename KernelType, typename SampleType>
+    static KernelType getModulatedKernelFor (InterpolationType type, int numChannels, DelayStorage::Format format)
+    {
+        switch (format)
+        {
+            case DelayStorage::Format::float32: return getModulatedKernelFor<KernelType, SampleType, DelayStorage::Float32Codec> (type, numChannels);
+            case DelayStorage::Format::int16:   return getModulatedKernelFor<KernelType, SampleType, DelayStorage::Int16Codec> (type, numChannels);
+            case DelayStorage::Format::half:    return getModulatedKernelFor<KernelType, SampleType, DelayStorage::HalfCodec> (type, numChannels);
+            case DelayStorage::Format::float64: return getModulatedKernelFor<KernelType, SampleType, DelayStorage::Float64Codec> (type, numChannels);
+        }
+
+        return getModulatedKernelFor<KernelType, SampleType, DelayStorage::Float32Codec> (type, numChannels);
+    }
+
+    template <typename SampleType>
+    ModulatedKernel<SampleType> getModulatedKernel (InterpolationType type, int numChannels, DelayStorage::Format format)
+    {
+        return getModulatedKernelFor<ModulatedKernel<SampleType>, SampleType> (type, numChannels, format);
+    }
+
+    template <typename SampleType>
+    CrossfadeKernel<SampleType> getCrossfadeKernel (InterpolationType type, int numChannels, DelayStorage::Format format)
+    {
+        return getModulatedKernelFor<CrossfadeKernel<SampleType>, SampleType> (type, numChannels, format);
+    }
+
+    template <typename SampleType>
+    TapKernel<SampleType> getTapKernel (InterpolationType type, int numChannels, DelayStorage::Format format)
+    {
+        if (type == InterpolationType::allpass)
+            type = InterpolationType::linear;
+
+        return getModulatedKernelFor<TapKernel<SampleType>, SampleType> (type, numChannels, format);
+    }
+
+    template <typename SampleType>
+    VibratoKernel<SampleType> getVibratoKernel (int numChannels, DelayStorage::Format format)
+    {
+        switch (format)
+        {
+            case DelayStorage::Format::float32: return getVibratoKernelFor<SampleType, DelayStorage::Float32Codec> (numChannels);
+            case DelayStorage::Format::int16:   return getVibratoKernelFor<SampleType, DelayStorage::Int16Codec> (numChannels);
+            case DelayStorage::Format::half:    return getVibratoKernelFor<SampleType, DelayStorage::HalfCodec> (numChannels);
+            case DelayStorage::Format::float64: return getVibratoKernelFor<SampleType, DelayStorage::Float64Codec> (numChannels);
+        }
+
+        return getVibratoKernelFor<SampleType, DelayStorage::Float32Codec> (numChannels);
+    }
+
+    //==============================================================================
+
+    LoopLayout LoopLayout::fromChannelSet (const AudioChannelSet& channelSet)
+    {
+        // clockwise from the front left, the surrounds of 5.1 sitting between the sides and the rears of 7.1
+        static const AudioChannelSet::ChannelType ring[] = {
+            AudioChannelSet::wideLeft, AudioChannelSet::left, AudioChannelSet::leftCentre, AudioChannelSet::centre,
+            AudioChannelSet::rightCentre, AudioChannelSet::right, AudioChannelSet::wideRight,
+            AudioChannelSet::rightSurroundSide, AudioChannelSet::rightSurround, AudioChannelSet::rightSurroundRear,
+            AudioChannelSet::centreSurround, AudioChannelSet::leftSurroundRear, AudioChannelSet::leftSurround,
+            AudioChannelSet::leftSurroundSide
+        };
+
+        static const AudioChannelSet::ChannelType leftTypes[] = {
+            AudioChannelSet::wideLeft, AudioChannelSet::left, AudioChannelSet::leftCentre, AudioChannelSet::leftSurroundSide,
+            AudioChannelSet::leftSurround, AudioChannelSet::leftSurroundRear
+        };
+
+        static const AudioChannelSet::ChannelType rightTypes[] = {
+            AudioChannelSet::wideRight, AudioChannelSet::right, AudioChannelSet::rightCentre, AudioChannelSet::rightSurroundSide,
+            AudioChannelSet::rightSurround, AudioChannelSet::rightSurroundRear
+        };
+
+        const Array<AudioChannelSet::ChannelType> types = channelSet.getChannelTypes();
+        LoopLayout layout;
+
+        auto add = [&layout, &types] (int hostChannel)
+        {
+            if (layout.numChannels == maxChannels)
+                return;
+
+            const AudioChannelSet::ChannelType type = types[hostChannel];
+            Side side = Side::both;
+
+            if (std::find (std::begin (leftTypes), std::end (leftTypes), type) != std::end (leftTypes))
+                side = Side::left;
+            else if (std::find (std::begin (rightTypes), std::end (rightTypes), type) != std::end (rightTypes))
+                side = Side::right;
+            else if (type >= AudioChannelSet::discreteChannel0 && types.size() > 1)
+                side = (hostChannel & 1) == 0 ? Side::left : Side::right;
+
+            if (type == AudioChannelSet::left)
+                layout.left = layout.numChannels;
+
+            if (type == AudioChannelSet::right)
+                layout.right = layout.numChannels;
+
+            layout.hostChannels[layout.numChannels] = hostChannel;
+            layout.sides[layout.numChannels] = side;
+            ++layout.numChannels;
+        };
+
+        for (auto type : ring)
+            if (types.contains (type))
+                add (types.indexOf (type));
+
+        for (int hostChannel = 0; hostChannel < types.size(); ++hostChannel)
+        {
+            const AudioChannelSet::ChannelType type = types[hostChannel];
+            const bool lfe = type == AudioChannelSet::LFE || type == AudioChannelSet::LFE2;
+
+            if (! lfe && std::find (std::begin (ring), std::end (ring), type) == std::end (ring))
+                add (hostChannel);
+        }
+
+        return layout;
+    }
+
+    //==============================================================================
+
+    template Kernel<float> getScalarKernel<float> (InterpolationType, int);
+    template Kernel<double> getScalarKernel<double> (InterpolationType, int);
+    template Kernel<float> getVectorKernel<float> (InterpolationType, int);
+    template Kernel<double> getVectorKernel<double> (InterpolationType, int);
+    template GatherKernel<float> getGatherKernel<float> (InterpolationType);
+    template GatherKernel<double> getGatherKernel<double> (InterpolationType);
+    template ModulatedKernel<float> getModulatedKernel<float> (InterpolationType, int, DelayStorage::Format);
+    template ModulatedKernel<double> getModulatedKernel<double> (InterpolationType, int, DelayStorage::Format);
+    template CrossfadeKernel<float> getCrossfadeKernel<float> (InterpolationType, int, DelayStorage::Format);
+    template CrossfadeKernel<double> getCrossfadeKernel<double> (InterpolationType, int, DelayStorage::Format);
+    template VibratoKernel<float> getVibratoKernel<float> (int, DelayStorage::Format);
+    template VibratoKernel<double> getVibratoKernel<double> (int, DelayStorage::Format);
+    template TapKernel<float> getTapKernel<float> (InterpolationType, int, DelayStorage::Format);
+    template TapKernel<double> getTapKernel<double> (InterpolationType, int, DelayStorage::Format);
+}
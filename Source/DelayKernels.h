@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Inner loops of the ping-pong delay, one per instruction set and interpolation mode.
+
+     processBlock hands over one contiguous segment at a time (see DelayLine.h). When the delay is at least
+     as long as the segment, nothing written inside the segment is read back inside it, so the feedback
+     recursion can be computed several samples at once. The scalar kernels handle every other case.
+     Each interpolator in Interpolators.h gets its own copy of every loop, picked once per block.
+     Everything is a template on the sample type, so float and double processing share the same loops.
+
+     The loops handle the channels of every supported layout (mono, stereo, quad, 5.1, 7.1), each count with
+     its own copy compiled for exactly that many channels. The channels come in the order the echoes go round
+     the speakers (see LoopLayout), and every channel's echo is fed back into the next one (0 -> 1 -> ... ->
+     N-1 -> 0). With two channels that is the classic ping-pong, in mono it is a plain feedback delay. The LFE
+     of 5.1 and 7.1 isn't one of them, so 5.1 runs five channels and 7.1 seven.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Interpolators.h"
+#include "DelayStorage.h"
+
+//==============================================================================
+
+namespace DelayKernels
+{
+    enum { maxChannels = 8 };
+
+    /*Channel counts that have their own loops: mono, stereo, quad, and 5.1 and 7.1 without their LFE*/
+    inline bool isSupportedChannelCount (int numChannels)
+    {
+        return numChannels == 1 || numChannels == 2 || numChannels == 4 || numChannels == 5 || numChannels == 7;
+    }
+
+    /*Which side of the balance the input of a channel is on. A centre (or mono) channel carries both sides.*/
+    enum class Side : uint8 { left, right, both };
+
+    /*Gain of the input of a channel before it goes into the delay. Balance weights the left channels against the
+    right ones and leaves the centre alone.*/
+    template <typename SampleType>
+    inline SampleType getInputGain (Side side, SampleType balance)
+    {
+        if (side == Side::both)
+            return SampleType (1);
+
+        return side == Side::left ? SampleType (1) - balance : balance;
+    }
+
+    /*The channels of a host layout that go round the loop, built once when the processor is prepared. They are put
+    in order clockwise around the listener, starting at the front left (L, C, R, Rs, Ls for 5.1), so the echoes
+    circle the room instead of criss-crossing it, and the LFE is left out: a full-band echo doesn't belong in the sub.
+    Channels whose place isn't known (discrete layouts) follow in the host's order, alternating left and right.*/
+    struct LoopLayout
+    {
+        static LoopLayout fromChannelSet (const AudioChannelSet& channelSet);
+
+        int numChannels = 0;
+        int hostChannels[maxChannels] = {};     // the host channel of every loop channel
+        Side sides[maxChannels] = {};
+
+        /*Loop channels of the left and the right speaker, for the meters (both 0 in mono)*/
+        int left = 0;
+        int right = 0;
+
+        bool operator== (const LoopLayout& other) const
+        {
+            return numChannels == other.numChannels
+                && std::equal (hostChannels, hostChannels + numChannels, other.hostChannels);
+        }
+    };
+
+    /*One contiguous segment of a block. All pointers already point at the first sample of the segment.
+    The read pointers point at the newest tap of the interpolator, the older taps are read behind them
+    (up to numTaps - 1 samples, which the delay line guard covers).*/
+    template <typename SampleType>
+    struct Segment
+    {
+        SampleType* io[maxChannels];
+        const SampleType* read[maxChannels];
+        SampleType* write[maxChannels];
+        const Side* sides;
+        int numSamples;
+
+        SampleType balance;
+        SampleType fraction;
+        SampleType feedback;
+        SampleType mix;
+
+        /*Per-sample values while balance, feedback or mix are being smoothed (all three set, or all nullptr
+        when the constants above hold for the whole segment). The parameter ramps are always float.*/
+        const float* balanceRamp;
+        const float* feedbackRamp;
+        const float* mixRamp;
+
+        /*Last output of the allpass interpolator for every channel, carried from one segment to the next.
+        Kept as double so that one state serves both processing types.*/
+        double* allpassState;
+    };
+
+    /*A block in which the delay time itself is moving. The read position changes by a fraction every sample,
+    so the ring is indexed through the mask instead of being cut into segments. The delay pointers point at
+    samples of the format the kernel was picked for.*/
+    template <typename SampleType>
+    struct ModulatedBlock
+    {
+        SampleType* io[maxChannels];
+        void* delay[maxChannels];
+        const Side* sides;
+        int writePosition;
+        int mask;
+        int numSamples;
+
+        const float* balance;
+        const float* delaySamples;
+        const float* feedback;
+        const float* mix;
+
+        double* allpassState;
+    };
+
+    /*A block in which a program change crossfades from one delay time to another. Besides the tap of the modulated
+    block (the new delay) a second tap keeps reading at the old delay, and the echo fed back and sent to the output
+    goes over from the old tap to the new one. Both taps read the same ring, so there is no jump in what is written
+    either and the delay time changes without the pitch sweep of a ramp.*/
+    template <typename SampleType>
+    struct CrossfadeBlock : ModulatedBlock<SampleType>
+    {
+        float fadeDelaySamples;     // the old delay, fixed for the whole fade
+        const float* fade;          // 0 = only the old tap, 1 = only the new one
+        double* fadeAllpassState;   // allpass state of the old tap
+    };
+
+    /*A block in which the modulation (see DelayModulation.h) sweeps the read head. Every channel reads at the delay
+    of the modulated block plus its own offset, limited to [minimumDelay, maximumDelay], so each side wavers on its
+    own. During a program change the old tap is swept by the same offsets, otherwise fade is nullptr.*/
+    template <typename SampleType>
+    struct VibratoBlock : CrossfadeBlock<SampleType>
+    {
+        const float* modulation[maxChannels];
+        float minimumDelay;
+        float maximumDelay;
+    };
+
+    /*One of the extra taps of the multi-tap mode (see DelayTaps.h) while its delay is moving. Every channel is read
+    at a per-sample delay behind the write head into out, nothing is written.*/
+    template <typename SampleType>
+    struct TapBlock
+    {
+        const void* delay[maxChannels];
+        SampleType* out[maxChannels];
+        int writePosition;          // ring index of the first sample of the block
+        int mask;
+        int numSamples;
+        const float* delaySamples;
+    };
+
+    /*The extra taps of one channel whose delay, gain, pan and cross-feed all hold still, gathered into one pass.
+    Every tap reads a contiguous run: read[tap][sample] is its newest interpolator tap, the older ones are behind it.
+    Each tap is added to out with its gain and to send with its cross-feed.*/
+    template <typename SampleType>
+    struct GatherBlock
+    {
+        enum { maxTaps = 8 };
+
+        const SampleType* read[maxTaps];
+        SampleType fraction[maxTaps];
+        SampleType gain[maxTaps];       // gain times the pan of this channel
+        SampleType crossFeed[maxTaps];
+        int numTaps;
+        SampleType* out;
+        SampleType* send;               // nullptr if none of the taps feeds back
+        int numSamples;
+    };
+
+    template <typename SampleType>
+    using Kernel = void (*) (const Segment<SampleType>&);
+
+    template <typename SampleType>
+    using ModulatedKernel = void (*) (const ModulatedBlock<SampleType>&);
+
+    template <typename SampleType>
+    using CrossfadeKernel = void (*) (const CrossfadeBlock<SampleType>&);
+
+    template <typename SampleType>
+    using VibratoKernel = void (*) (const VibratoBlock<SampleType>&);
+
+    template <typename SampleType>
+    using TapKernel = void (*) (const TapBlock<SampleType>&);
+
+    template <typename SampleType>
+    using GatherKernel = void (*) (const GatherBlock<SampleType>&);
+
+    // the getters below exist for float and double (instantiated in DelayKernels.cpp)
+
+    /*Sample-by-sample loop. Always correct, also when the delay is shorter than the segment.*/
+    template <typename SampleType>
+    Kernel<SampleType> getScalarKernel (InterpolationType type, int numChannels);
+
+    /*Returns the widest vector loop this CPU can run (AVX2, SSE2 or NEON, falling back to the scalar loop).
+    Only valid for segments where the newest tap is at least segment.numSamples behind the write head.*/
+    template <typename SampleType>
+    Kernel<SampleType> getVectorKernel (InterpolationType type, int numChannels);
+
+    /*Scalar loop for blocks with a smoothed delay time, reading and writing a ring stored in the given format.
+    Delays must already be clamped to [taps ahead + 1, ring length - guard].*/
+    template <typename SampleType>
+    ModulatedKernel<SampleType> getModulatedKernel (InterpolationType type, int numChannels, DelayStorage::Format format);
+
+    /*The same with the second tap of a program change. Both delays must be clamped like the modulated ones.*/
+    template <typename SampleType>
+    CrossfadeKernel<SampleType> getCrossfadeKernel (InterpolationType type, int numChannels, DelayStorage::Format format);
+
+    /*Scalar loop for blocks swept by the modulation. It always reads through the windowed sinc, whatever the
+    Interpolation parameter says: the read position moves all the time, and the polynomial interpolators would dull
+    the treble more or less with every fraction it passes, which turns into a flutter of the high end at the rate of
+    the LFO. minimumDelay has to be at least SincInterpolation::tapsAhead + 1.*/
+    template <typename SampleType>
+    VibratoKernel<SampleType> getVibratoKernel (int numChannels, DelayStorage::Format format);
+
+    /*Scalar loop reading one moving tap of the multi-tap mode, with the same interpolation as the modulated loops.
+    The allpass keeps a state per read position, so allpass taps are read with linear interpolation instead.*/
+    template <typename SampleType>
+    TapKernel<SampleType> getTapKernel (InterpolationType type, int numChannels, DelayStorage::Format format);
+
+    /*Widest vector loop for the taps that hold still, like getVectorKernel. Allpass taps are read linearly here too.*/
+    template <typename SampleType>
+    GatherKernel<SampleType> getGatherKernel (InterpolationType type);
+}
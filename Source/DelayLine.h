@@ -0,0 +1,244 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Ring buffer used as the delay line of the ping-pong delay.
+
+     The length is always a power of two, so positions wrap with "& mask" instead of modulo.
+     A few samples in front of index 0 (the guard) mirror the end of the ring, which lets the
+     interpolating read head look one or more samples behind index 0 without wrapping.
+     Samples are stored as 32 or 64-bit floats or in one of the 16-bit formats of DelayStorage.h.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayStorage.h"
+
+//==============================================================================
+
+class DelayLine
+{
+public:
+    /*Number of samples mirrored in front of the ring. Interpolation may read this far behind a read position
+    (the longest interpolator, the 8-tap sinc, reads 7 samples behind its newest tap).*/
+    enum { guardSamples = 8 };
+
+    /*Allocates at least minimumLength samples per channel (rounded up to a power of two) and clears them*/
+    void setSize (int newNumChannels, int minimumLength, DelayStorage::Format newFormat = DelayStorage::Format::float32)
+    {
+        numChannels = newNumChannels;
+        length = nextPowerOfTwo (jmax (minimumLength, (int)guardSamples));
+        mask = length - 1;
+        format = newFormat;
+        bytesPerSample = DelayStorage::getBytesPerSample (format);
+
+        data.allocate (getSizeInBytes(), true);
+        writePosition = 0;
+    }
+
+    void clear()
+    {
+        data.clear (getSizeInBytes());
+        writePosition = 0;
+    }
+
+    /*Frees the memory. The line has no channels until setSize is called again.*/
+    void release()
+    {
+        data.free();
+        numChannels = 0;
+        length = 0;
+        mask = 0;
+        writePosition = 0;
+    }
+
+    int getNumChannels() const { return numChannels; }
+    int getLength() const { return length; }
+    int getMask() const { return mask; }
+    DelayStorage::Format getFormat() const { return format; }
+    size_t getSizeInBytes() const { return (size_t)numChannels * (size_t)(guardSamples + length) * (size_t)bytesPerSample; }
+
+    /*Smallest power-of-two length whose longest allowed delay (length - guardSamples) is at least delaySamples*/
+    static int getLengthForDelay (double delaySamples)
+    {
+        return nextPowerOfTwo ((int)std::ceil (delaySamples) + guardSamples);
+    }
+
+    /*Pointer to ring index 0, in whatever format the line stores. Indices -guardSamples to -1 are valid for reading.*/
+    void* getChannelData (int channel) const
+    {
+        return data + ((size_t)channel * (size_t)(guardSamples + length) + guardSamples) * (size_t)bytesPerSample;
+    }
+
+    /*Ring index 0 of a line stored in the native format of SampleType (float32 for float, float64 for double)*/
+    template <typename SampleType>
+    SampleType* getWritePointer (int channel) const
+    {
+        jassert (format == DelayStorage::getNativeFormat<SampleType>());
+        return (SampleType*)getChannelData (channel);
+    }
+
+    /*Decodes numSamples samples starting at ring index start (which may be in the guard) into floats or doubles*/
+    template <typename SampleType>
+    void readSamples (int channel, int start, SampleType* destination, int numSamples) const
+    {
+        jassert (start >= -(int)guardSamples && start + numSamples <= length);
+        DelayStorage::decode (format, getSamplePointer (channel, start), destination, numSamples);
+    }
+
+    /*Encodes numSamples floats or doubles into the ring, starting at ring index start*/
+    template <typename SampleType>
+    void writeSamples (int channel, int start, const SampleType* source, int numSamples)
+    {
+        jassert (start >= 0 && start + numSamples <= length);
+        DelayStorage::encode (format, source, getSamplePointer (channel, start), numSamples);
+    }
+
+    /*Copies the last samples of the ring into the guard. Has to be called every time the write position wraps to 0,
+    before anything reads behind index 0 again.*/
+    void updateGuard()
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+            updateGuard (channel);
+    }
+
+    /*The same for one channel, for callers that process the channels one after the other*/
+    void updateGuard (int channel)
+    {
+        std::memcpy (getSamplePointer (channel, -(int)guardSamples), getSamplePointer (channel, length - guardSamples),
+                     (size_t)guardSamples * (size_t)bytesPerSample);
+    }
+
+    /*Copies the newest samples of another line (as many as fit) so that every delay both lines can hold reads
+    the same sample afterwards, then takes over its write position. Used when the line is resized or changes its
+    format while playing, doesn't allocate. The rest of this line has to be clear already.*/
+    void copyHistoryFrom (const DelayLine& source)
+    {
+        jassert (source.getNumChannels() == getNumChannels());
+
+        writePosition = source.writePosition & mask;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            // walks backwards from both write heads in contiguous chunks, each ends where one of the rings wraps
+            int remaining = jmin (length, source.length);
+            int sourceEnd = source.writePosition == 0 ? source.length : source.writePosition;
+            int destinationEnd = writePosition == 0 ? length : writePosition;
+
+            while (remaining > 0)
+            {
+                const int chunk = jmin (remaining, sourceEnd, destinationEnd);
+                copySamples (source, channel, sourceEnd - chunk, destinationEnd - chunk, chunk);
+
+                remaining -= chunk;
+                sourceEnd = sourceEnd == chunk ? source.length : sourceEnd - chunk;
+                destinationEnd = destinationEnd == chunk ? length : destinationEnd - chunk;
+            }
+        }
+
+        updateGuard();
+    }
+
+    /*Fills this line with the history of a line recorded at another sample rate, ratio being the new rate over the
+    old one, so every echo still comes back after the same time. Each new sample is read from the old history at
+    its age in old samples with a windowed sinc. When the rate goes down, the cutoff moves down with it so nothing
+    above the new Nyquist frequency folds back. As much of the old history as fits is kept, the rest of this line
+    has to be clear already. Allocates scratch memory, so only for the message thread (prepareToPlay).*/
+    void resampleHistoryFrom (const DelayLine& source, double ratio)
+    {
+        jassert (source.getNumChannels() == getNumChannels() && ratio > 0.0);
+
+        const int zeroCrossings = 8;
+        const double cutoff = jmin (1.0, ratio) * 0.95;
+        const double halfWidth = zeroCrossings / cutoff;
+
+        // age 1 (the newest sample) is history[0]
+        const int sourceCount = source.length;
+        const int count = jmin (length, (int)((double)(sourceCount - 1) * ratio));
+        HeapBlock<double> history ((size_t)sourceCount);
+        HeapBlock<double> resampled ((size_t)jmax (1, count));
+
+        writePosition = 0;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            for (int age = 1; age <= sourceCount; ++age)
+                source.readSamples (channel, (source.writePosition - age) & source.mask, history + (age - 1), 1);
+
+            // the newest sample goes just before the write position, at the end of the ring
+            for (int i = 0; i < count; ++i)
+            {
+                const double position = (double)(count - i) / ratio - 1.0;
+                const int first = jmax (0, (int)std::ceil (position - halfWidth));
+                const int last = jmin (sourceCount - 1, (int)std::floor (position + halfWidth));
+                double sum = 0.0;
+
+                for (int k = first; k <= last; ++k)
+                {
+                    const double x = position - (double)k;
+                    const double sinc = x == 0.0 ? 1.0 : std::sin (MathConstants<double>::pi * cutoff * x) / (MathConstants<double>::pi * cutoff * x);
+                    const double window = 0.5 + 0.5 * std::cos (MathConstants<double>::pi * x / halfWidth);
+                    sum += history[k] * cutoff * sinc * window;
+                }
+
+                resampled[i] = sum;
+            }
+
+            writeSamples (channel, length - count, resampled.get(), count);
+        }
+
+        updateGuard();
+    }
+
+    /*Exchanges the memory and the state of two lines without allocating*/
+    void swapWith (DelayLine& other) noexcept
+    {
+        data.swapWith (other.data);
+        std::swap (numChannels, other.numChannels);
+        std::swap (length, other.length);
+        std::swap (mask, other.mask);
+        std::swap (format, other.format);
+        std::swap (bytesPerSample, other.bytesPerSample);
+        std::swap (writePosition, other.writePosition);
+    }
+
+    int writePosition = 0;
+
+private:
+    char* getSamplePointer (int channel, int index) const
+    {
+        return (char*)getChannelData (channel) + (ptrdiff_t)index * bytesPerSample;
+    }
+
+    /*Same format: a plain copy. Different formats go through doubles (which hold every format exactly),
+    a small piece at a time on the stack.*/
+    void copySamples (const DelayLine& source, int channel, int sourceStart, int destinationStart, int numSamples)
+    {
+        if (source.format == format)
+        {
+            std::memcpy (getSamplePointer (channel, destinationStart), source.getSamplePointer (channel, sourceStart),
+                         (size_t)numSamples * (size_t)bytesPerSample);
+            return;
+        }
+
+        double converted[128];
+
+        for (int done = 0; done < numSamples; done += numElementsInArray (converted))
+        {
+            const int count = jmin (numSamples - done, (int)numElementsInArray (converted));
+            source.readSamples (channel, sourceStart + done, converted, count);
+            writeSamples (channel, destinationStart + done, converted, count);
+        }
+    }
+
+    HeapBlock<char> data;
+    int numChannels = 0;
+    int length = 0;
+    int mask = 0;
+    DelayStorage::Format format = DelayStorage::Format::float32;
+    int bytesPerSample = (int)sizeof (float);
+};
@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Resizes a delay line while the plugin is playing, without the audio thread ever allocating.
+
+     The audio thread asks for a new length with requestLength(). A background thread shared by every
+     instance of the plugin allocates and clears a DelayLine of that length and hands it back.
+     At the start of a block the audio thread picks it up with takeReadyLine(), copies the history
+     over and swaps it in (see DelayLine::copyHistoryFrom), then gives the old memory back with retire()
+     so the background thread frees it. All hand-overs are single atomic pointer exchanges.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayLine.h"
+
+//==============================================================================
+
+class DelayLineResizer : private TimeSliceClient
+{
+public:
+    DelayLineResizer()
+    {
+        thread->addTimeSliceClient (this);
+    }
+
+    ~DelayLineResizer()
+    {
+        // waits for a running allocation to finish, so nothing below can be used by the thread any more
+        thread->removeTimeSliceClient (this);
+
+        delete readyLine.exchange (nullptr);
+        delete retiredLine.exchange (nullptr);
+    }
+
+    /*Audio thread. Asks for a line of exactly this many samples per channel, stored in the given format. A newer
+    request replaces an older one that hasn't been served yet. The three values are separate atomics, so the line
+    that comes back has to be checked against what is needed before it is used.*/
+    void requestLength (int numChannels, int length, DelayStorage::Format format)
+    {
+        requestedChannels.store (numChannels);
+        requestedFormat.store ((int)format);
+        requestedLength.store (length);
+    }
+
+    /*Audio thread. Returns the requested line once it has been allocated (cleared, never played), or nullptr.
+    The caller owns it until it passes it to retire(). Nothing is handed out while retired memory is still waiting
+    to be freed, so retire() never has to free anything itself.*/
+    DelayLine* takeReadyLine()
+    {
+        if (retiredLine.load() != nullptr)
+            return nullptr;
+
+        return readyLine.exchange (nullptr);
+    }
+
+    /*Audio thread. Hands memory that is no longer used to the background thread to be freed.*/
+    void retire (DelayLine* line)
+    {
+        jassert (retiredLine.load() == nullptr);
+        retiredLine.store (line);
+    }
+
+    /*Not the audio thread. Forgets an unserved request and frees a line that is waiting to be picked up, for when
+    the processor releases its resources.*/
+    void discardReadyLine()
+    {
+        requestedLength.store (0);
+        delete readyLine.exchange (nullptr);
+    }
+
+    /*Any thread. True while a request hasn't been served yet.*/
+    bool isPending() const
+    {
+        return requestedLength.load() != 0;
+    }
+
+private:
+    /*The one background thread every instance shares*/
+    struct AllocationThread : public TimeSliceThread
+    {
+        AllocationThread() : TimeSliceThread ("Delay line allocation")
+        {
+            startThread (3);
+        }
+
+        ~AllocationThread()
+        {
+            stopThread (1000);
+        }
+    };
+
+    int useTimeSlice() override
+    {
+        delete retiredLine.exchange (nullptr);
+
+        const int length = requestedLength.load();
+
+        if (length != 0 && readyLine.load() == nullptr)
+        {
+            DelayLine* line = new DelayLine();
+            line->setSize (requestedChannels.load(), length, (DelayStorage::Format)requestedFormat.load());
+
+            delete readyLine.exchange (line);
+
+            // only marks the request as served if the audio thread hasn't asked for something else meanwhile
+            int served = length;
+            requestedLength.compare_exchange_strong (served, 0);
+        }
+
+        return 10;
+    }
+
+    SharedResourcePointer<AllocationThread> thread;
+
+    std::atomic<int> requestedLength { 0 };
+    std::atomic<int> requestedChannels { 0 };
+    std::atomic<int> requestedFormat { 0 };
+    std::atomic<DelayLine*> readyLine { nullptr };
+    std::atomic<DelayLine*> retiredLine { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLineResizer)
+};
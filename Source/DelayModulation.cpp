@@ -0,0 +1,199 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     The LFOs of the delay time modulation, see DelayModulation.h.
+
+  ==============================================================================
+*/
+
+#include "DelayModulation.h"
+
+//==============================================================================
+
+namespace
+{
+    /*How long the depth and the stereo phase take to follow their parameters. A change of depth moves the read
+    head, so it is as slow as the delay time ramp.*/
+    const double smoothTime = 50e-3;
+
+    /*Triangle in [-1, 1] with the phase of a sine: 0 at phase 0, 1 at a quarter, -1 at three quarters. The phase is
+    never negative, so the cast truncates like a floor, and both it and the absolute value become single
+    instructions in a vector loop.*/
+    inline float getTriangle (float phase)
+    {
+        float shifted = phase + 0.25f;
+        shifted -= (float)(int)shifted;
+        return 1.0f - 4.0f * std::abs (shifted - 0.5f);
+    }
+
+    /*sin (pi / 2 * x) for x in [-1, 1], an odd polynomial fitted for the smallest largest error (below 1e-6, far
+    below anything a few milliseconds of depth can show). Applied to the triangle it gives the sine of the phase.*/
+    inline float getQuarterSine (float x)
+    {
+        const float x2 = x * x;
+        return x * (1.5707910f + x2 * (-0.64589284f + x2 * (0.079434320f + x2 * -0.0043330790f)));
+    }
+
+    /*3 p^2 - 2 p^3, which leaves one target and arrives at the next with a flat slope*/
+    inline float getSmoothStep (float phase)
+    {
+        return phase * phase * (3.0f - 2.0f * phase);
+    }
+}
+
+//==============================================================================
+
+void DelayModulation::prepare (double newSampleRate, int newNumChannels, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+    numChannels = jlimit (1, (int)DelayKernels::maxChannels, newNumChannels);
+    capacity = 0;
+    setMaximumBlockSize (maximumBlockSize);
+
+    depthRamp.prepare (sampleRate, smoothTime, maximumBlockSize);
+    stereoPhaseRamp.prepare (sampleRate, smoothTime, maximumBlockSize);
+    depthRamp.setCurrentAndTargetValue (0.0f);
+    shape = Shape::off;
+    phase = 0.0;
+    random.setSeed (randomSeed);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        randomFrom[channel] = 0.0f;
+        randomTo[channel] = random.nextFloat() * 2.0f - 1.0f;
+        lastPhase[channel] = 0.0f;
+    }
+}
+
+void DelayModulation::setMaximumBlockSize (int maximumBlockSize)
+{
+    if (maximumBlockSize <= capacity)
+        return;
+
+    capacity = maximumBlockSize;
+    offsets.allocate ((size_t)numChannels * (size_t)capacity, true);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        channelOffsets[channel] = offsets + (size_t)channel * (size_t)capacity;
+
+    depthRamp.setMaximumBlockSize (maximumBlockSize);
+    stereoPhaseRamp.setMaximumBlockSize (maximumBlockSize);
+}
+
+void DelayModulation::release()
+{
+    offsets.free();
+    capacity = 0;
+    depthRamp.release();
+    stereoPhaseRamp.release();
+}
+
+size_t DelayModulation::getSizeInBytes() const
+{
+    return ((size_t)numChannels + 2) * (size_t)capacity * sizeof (float);
+}
+
+/*A shape is only changed while the depth is zero, so the LFO never jumps from one shape to the other*/
+void DelayModulation::setSettings (const Settings& newSettings)
+{
+    if (newSettings.shape != shape && depthRamp.getCurrentValue() == 0.0f && ! depthRamp.isSmoothing())
+        shape = newSettings.shape;
+
+    const bool sweeping = shape != Shape::off && shape == newSettings.shape;
+
+    depthRamp.setTargetValue (sweeping ? (float)(newSettings.depth * 1.0e-3 * sampleRate) : 0.0f);
+    stereoPhaseRamp.setTargetValue (newSettings.stereoPhase / 360.0f);
+    increment = (double)newSettings.rate / sampleRate;
+}
+
+void DelayModulation::jumpToTargets()
+{
+    depthRamp.setCurrentAndTargetValue (depthRamp.getTargetValue());
+    stereoPhaseRamp.setCurrentAndTargetValue (stereoPhaseRamp.getTargetValue());
+}
+
+/*Every loop below computes each sample from values of the same sample only, so they are all vector loops. The phase
+of the block's start is kept in double and wrapped once per block, so the float phases stay exact enough however
+long the LFO has been running.*/
+const float* const* DelayModulation::fill (int numSamples)
+{
+    jassert (numSamples <= capacity);
+
+    const float* depth = depthRamp.fillRamp (numSamples);
+    const float* stereoPhase = stereoPhaseRamp.fillRamp (numSamples);
+    const float start = (float)phase;
+    const float step = (float)increment;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* values = channelOffsets[channel];
+        const float channelPhase = (float)channel;
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const float position = start + step * (float)(sample + 1) + channelPhase * stereoPhase[sample];
+            values[sample] = position - (float)(int)position;
+        }
+
+        switch (shape)
+        {
+            case Shape::sine:
+                for (int sample = 0; sample < numSamples; ++sample)
+                    values[sample] = getQuarterSine (getTriangle (values[sample])) * depth[sample];
+                break;
+
+            case Shape::triangle:
+                for (int sample = 0; sample < numSamples; ++sample)
+                    values[sample] = getTriangle (values[sample]) * depth[sample];
+                break;
+
+            case Shape::random:
+                fillRandom (channel, values, depth, numSamples);
+                break;
+
+            case Shape::off:
+                FloatVectorOperations::clear (values, numSamples);
+                break;
+        }
+    }
+
+    phase += increment * (double)numSamples;
+    phase -= std::floor (phase);
+
+    return channelOffsets;
+}
+
+/*A cycle ends where the phase wraps around. The runs between wraps are found first, then each run is shaped in one
+vector loop. A stereo phase that is being turned down moves the phase back a little, only a drop of more than half a
+cycle counts as a wrap.*/
+void DelayModulation::fillRandom (int channel, float* values, const float* depth, int numSamples)
+{
+    float previous = lastPhase[channel];
+    lastPhase[channel] = values[numSamples - 1];
+
+    for (int runStart = 0; runStart < numSamples;)
+    {
+        if (values[runStart] < previous - 0.5f)
+        {
+            randomFrom[channel] = randomTo[channel];
+            randomTo[channel] = random.nextFloat() * 2.0f - 1.0f;
+        }
+
+        int runEnd = runStart + 1;
+
+        while (runEnd < numSamples && values[runEnd] >= values[runEnd - 1] - 0.5f)
+            ++runEnd;
+
+        previous = values[runEnd - 1];
+
+        const float from = randomFrom[channel];
+        const float distance = randomTo[channel] - from;
+
+        for (int sample = runStart; sample < runEnd; ++sample)
+            values[sample] = (from + distance * getSmoothStep (values[sample])) * depth[sample];
+
+        runStart = runEnd;
+    }
+}
@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     LFOs that sweep the delay time, for chorus on the repeats and the wow and flutter of a tape echo.
+
+     Every channel of the delay line has its own LFO, and each one runs the stereo phase ahead of the one of the
+     channel before, so with two channels the left and the right repeats waver independently. Three shapes:
+      - sine: the smooth, even swing of a chorus;
+      - triangle: the pitch jumps between two values instead of gliding, the sound of a vibrato pedal;
+      - random: a new random target every cycle, reached along a smooth curve, for the irregular wow of a worn tape.
+        Every channel draws its own targets.
+
+     The LFOs aren't run sample by sample inside the delay loop. fill writes the offset of every channel for a
+     whole block into buffers first (like ParameterRamp does for the parameters), with loops that have no
+     dependency from one sample to the next, so the compiler turns them into vector code. The phase of every sample
+     is computed from the start of the block, and the sine is a polynomial of the triangle, so there is no std::sin
+     and no table lookup anywhere. The delay loop reads the offsets back, see DelayKernels::VibratoBlock.
+
+     The depth and the stereo phase are smoothed. Switching the modulation off, or to another shape, first fades the
+     depth out, so the read head never jumps.
+
+     Everything is allocated in prepare. The other functions are for the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayKernels.h"
+#include "ParameterRamp.h"
+
+//==============================================================================
+
+class DelayModulation
+{
+public:
+    /*Order matches the items of the "Modulation" parameter*/
+    enum class Shape { off, sine, triangle, random };
+
+    /*Settings in the units of the parameters*/
+    struct Settings
+    {
+        Shape shape = Shape::off;
+        float rate = 0.8f;          // Hz
+        float depth = 2.0f;         // ms the read head swings to either side of the delay time
+        float stereoPhase = 90.0f;  // degrees the LFO of a channel runs ahead of the one of the channel before
+    };
+
+    /*Allocates the offsets for blocks of up to maximumBlockSize samples. The LFOs start again from the beginning.*/
+    void prepare (double sampleRate, int numChannels, int maximumBlockSize);
+
+    /*Grows the buffers for longer blocks without touching the LFOs, see PingPongDelayAudioProcessor::reprepare*/
+    void setMaximumBlockSize (int maximumBlockSize);
+
+    void release();
+    size_t getSizeInBytes() const;
+
+    /*Once per block. A new shape waits until the depth has faded out.*/
+    void setSettings (const Settings& newSettings);
+
+    /*The depth and the stereo phase jump to their targets, for the idle path*/
+    void jumpToTargets();
+
+    /*True while the read head is swept, including while the depth fades out*/
+    bool isActive() const { return shape != Shape::off && (depthRamp.isSmoothing() || depthRamp.getTargetValue() > 0.0f); }
+
+    /*Furthest the read head is or will be from the delay time, in samples*/
+    float getLongestDepth() const { return jmax (depthRamp.getCurrentValue(), depthRamp.getTargetValue()); }
+
+    /*Writes the offset of every channel's read head from the delay time, in samples, for the next numSamples
+    samples (at most the maximum block size) and moves the LFOs on. Returns one array per channel.*/
+    const float* const* fill (int numSamples);
+
+private:
+    /*Shapes the phases of one channel (in [0, 1)) into its random LFO, scaled by the depth*/
+    void fillRandom (int channel, float* values, const float* depth, int numSamples);
+
+    double sampleRate = 44100.0;
+    int numChannels = 2;
+    int capacity = 0;
+
+    /*Shape the LFOs have, which only follows the parameter while the depth is zero*/
+    Shape shape = Shape::off;
+
+    /*Phase of the first channel at the start of the next block, in cycles, and how far it moves per sample*/
+    double phase = 0.0;
+    double increment = 0.0;
+
+    /*Depth in samples, and the stereo phase in cycles*/
+    ParameterRamp depthRamp;
+    ParameterRamp stereoPhaseRamp;
+
+    /*The random LFO of every channel glides from one target to the next over a cycle. The phase it had at the end
+    of the last block tells where a new cycle begins.*/
+    float randomFrom[DelayKernels::maxChannels] = {};
+    float randomTo[DelayKernels::maxChannels] = {};
+    float lastPhase[DelayKernels::maxChannels] = {};
+
+    /*prepare starts the random LFO from here again, so a render doesn't depend on what was rendered before it*/
+    enum { randomSeed = 0x70f1 };
+    Random random { randomSeed };
+
+    HeapBlock<float> offsets;
+    float* channelOffsets[DelayKernels::maxChannels] = {};
+};
@@ -0,0 +1,300 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Bulk conversions between the processing types (float, double) and the delay line formats.
+
+  ==============================================================================
+*/
+
+#include "DelayStorage.h"
+
+#if JUCE_INTEL && (defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2))
+ #define PINGPONG_USE_SSE2 1
+ #include <immintrin.h>
+#endif
+
+// the conversion instructions used below only exist on 64-bit ARM
+#if JUCE_ARM && defined (__aarch64__)
+ #define PINGPONG_USE_NEON 1
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+
+namespace DelayStorage
+{
+    int getBytesPerSample (Format format)
+    {
+        switch (format)
+        {
+            case Format::float32: return (int)sizeof (float);
+            case Format::float64: return (int)sizeof (double);
+            case Format::int16:
+            case Format::half:    return (int)sizeof (int16);
+        }
+
+        return (int)sizeof (float);
+    }
+
+    /*Sample by sample, for whatever the vector loops leave at the end and for CPUs without them*/
+    template <typename Codec, typename SampleType>
+    static void encodeScalar (const SampleType* source, typename Codec::Type* destination, int start, int numSamples)
+    {
+        for (int sample = start; sample < numSamples; ++sample)
+            destination[sample] = Codec::encode (source[sample]);
+    }
+
+    template <typename Codec, typename SampleType>
+    static void decodeScalar (const typename Codec::Type* source, SampleType* destination, int start, int numSamples)
+    {
+        for (int sample = start; sample < numSamples; ++sample)
+            destination[sample] = (SampleType)Codec::decode (source[sample]);
+    }
+
+    //==============================================================================
+
+   #if PINGPONG_USE_SSE2
+    static int encodeInt16SSE2 (const float* source, int16* destination, int numSamples)
+    {
+        const __m128 scale = _mm_set1_ps (32767.0f / int16FullScale);
+        const __m128 lowest = _mm_set1_ps (-32767.0f);
+        const __m128 highest = _mm_set1_ps (32767.0f);
+
+        int sample = 0;
+
+        for (; sample + 8 <= numSamples; sample += 8)
+        {
+            const __m128 a = _mm_min_ps (_mm_max_ps (_mm_mul_ps (_mm_loadu_ps (source + sample), scale), lowest), highest);
+            const __m128 b = _mm_min_ps (_mm_max_ps (_mm_mul_ps (_mm_loadu_ps (source + sample + 4), scale), lowest), highest);
+            _mm_storeu_si128 ((__m128i*)(destination + sample), _mm_packs_epi32 (_mm_cvtps_epi32 (a), _mm_cvtps_epi32 (b)));
+        }
+
+        return sample;
+    }
+
+    static int decodeInt16SSE2 (const int16* source, float* destination, int numSamples)
+    {
+        const __m128 scale = _mm_set1_ps (int16FullScale / 32767.0f);
+
+        int sample = 0;
+
+        for (; sample + 8 <= numSamples; sample += 8)
+        {
+            // sign-extends each 16-bit value into the top half of a 32-bit lane and shifts it back down
+            const __m128i packed = _mm_loadu_si128 ((const __m128i*)(source + sample));
+            const __m128i low = _mm_srai_epi32 (_mm_unpacklo_epi16 (packed, packed), 16);
+            const __m128i high = _mm_srai_epi32 (_mm_unpackhi_epi16 (packed, packed), 16);
+            _mm_storeu_ps (destination + sample, _mm_mul_ps (_mm_cvtepi32_ps (low), scale));
+            _mm_storeu_ps (destination + sample + 4, _mm_mul_ps (_mm_cvtepi32_ps (high), scale));
+        }
+
+        return sample;
+    }
+
+    // F16C came with the same CPUs as AVX2 on every Intel and AMD line, so it is only used where AVX2 is
+   #if JUCE_CLANG
+    #pragma clang attribute push (__attribute__ ((target ("avx2,f16c"))), apply_to = function)
+   #elif JUCE_GCC
+    #pragma GCC push_options
+    #pragma GCC target ("avx2,f16c")
+   #endif
+
+    static int encodeHalfF16C (const float* source, uint16* destination, int numSamples)
+    {
+        int sample = 0;
+
+        for (; sample + 8 <= numSamples; sample += 8)
+            _mm_storeu_si128 ((__m128i*)(destination + sample), _mm256_cvtps_ph (_mm256_loadu_ps (source + sample), _MM_FROUND_TO_NEAREST_INT));
+
+        _mm256_zeroupper();
+        return sample;
+    }
+
+    static int decodeHalfF16C (const uint16* source, float* destination, int numSamples)
+    {
+        int sample = 0;
+
+        for (; sample + 8 <= numSamples; sample += 8)
+            _mm256_storeu_ps (destination + sample, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*)(source + sample))));
+
+        _mm256_zeroupper();
+        return sample;
+    }
+
+   #if JUCE_CLANG
+    #pragma clang attribute pop
+   #elif JUCE_GCC
+    #pragma GCC pop_options
+   #endif
+   #endif
+
+    //==============================================================================
+
+   #if PINGPONG_USE_NEON
+    static int encodeInt16Neon (const float* source, int16* destination, int numSamples)
+    {
+        const float32x4_t scale = vdupq_n_f32 (32767.0f / int16FullScale);
+        const float32x4_t lowest = vdupq_n_f32 (-32767.0f);
+        const float32x4_t highest = vdupq_n_f32 (32767.0f);
+
+        int sample = 0;
+
+        for (; sample + 8 <= numSamples; sample += 8)
+        {
+            const float32x4_t a = vminq_f32 (vmaxq_f32 (vmulq_f32 (vld1q_f32 (source + sample), scale), lowest), highest);
+            const float32x4_t b = vminq_f32 (vmaxq_f32 (vmulq_f32 (vld1q_f32 (source + sample + 4), scale), lowest), highest);
+            vst1q_s16 (destination + sample, vcombine_s16 (vqmovn_s32 (vcvtnq_s32_f32 (a)), vqmovn_s32 (vcvtnq_s32_f32 (b))));
+        }
+
+        return sample;
+    }
+
+    static int decodeInt16Neon (const int16* source, float* destination, int numSamples)
+    {
+        const float32x4_t scale = vdupq_n_f32 (int16FullScale / 32767.0f);
+
+        int sample = 0;
+
+        for (; sample + 8 <= numSamples; sample += 8)
+        {
+            const int16x8_t packed = vld1q_s16 (source + sample);
+            vst1q_f32 (destination + sample, vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (packed))), scale));
+            vst1q_f32 (destination + sample + 4, vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (packed))), scale));
+        }
+
+        return sample;
+    }
+
+    static int encodeHalfNeon (const float* source, uint16* destination, int numSamples)
+    {
+        int sample = 0;
+
+        for (; sample + 4 <= numSamples; sample += 4)
+            vst1_u16 (destination + sample, vreinterpret_u16_f16 (vcvt_f16_f32 (vld1q_f32 (source + sample))));
+
+        return sample;
+    }
+
+    static int decodeHalfNeon (const uint16* source, float* destination, int numSamples)
+    {
+        int sample = 0;
+
+        for (; sample + 4 <= numSamples; sample += 4)
+            vst1q_f32 (destination + sample, vcvt_f32_f16 (vreinterpret_f16_u16 (vld1_u16 (source + sample))));
+
+        return sample;
+    }
+   #endif
+
+    //==============================================================================
+
+    void encode (Format format, const float* source, void* destination, int numSamples)
+    {
+        if (format == Format::float32)
+        {
+            FloatVectorOperations::copy ((float*)destination, source, numSamples);
+        }
+        else if (format == Format::float64)
+        {
+            encodeScalar<Float64Codec> (source, (double*)destination, 0, numSamples);
+        }
+        else if (format == Format::int16)
+        {
+            int16* data = (int16*)destination;
+            int done = 0;
+
+           #if PINGPONG_USE_SSE2
+            done = encodeInt16SSE2 (source, data, numSamples);
+           #elif PINGPONG_USE_NEON
+            done = encodeInt16Neon (source, data, numSamples);
+           #endif
+
+            encodeScalar<Int16Codec> (source, data, done, numSamples);
+        }
+        else
+        {
+            uint16* data = (uint16*)destination;
+            int done = 0;
+
+           #if PINGPONG_USE_SSE2
+            static const bool useF16C = SystemStats::hasAVX2();
+
+            if (useF16C)
+                done = encodeHalfF16C (source, data, numSamples);
+           #elif PINGPONG_USE_NEON
+            done = encodeHalfNeon (source, data, numSamples);
+           #endif
+
+            encodeScalar<HalfCodec> (source, data, done, numSamples);
+        }
+    }
+
+    void decode (Format format, const void* source, float* destination, int numSamples)
+    {
+        if (format == Format::float32)
+        {
+            FloatVectorOperations::copy (destination, (const float*)source, numSamples);
+        }
+        else if (format == Format::float64)
+        {
+            decodeScalar<Float64Codec> ((const double*)source, destination, 0, numSamples);
+        }
+        else if (format == Format::int16)
+        {
+            const int16* data = (const int16*)source;
+            int done = 0;
+
+           #if PINGPONG_USE_SSE2
+            done = decodeInt16SSE2 (data, destination, numSamples);
+           #elif PINGPONG_USE_NEON
+            done = decodeInt16Neon (data, destination, numSamples);
+           #endif
+
+            decodeScalar<Int16Codec> (data, destination, done, numSamples);
+        }
+        else
+        {
+            const uint16* data = (const uint16*)source;
+            int done = 0;
+
+           #if PINGPONG_USE_SSE2
+            static const bool useF16C = SystemStats::hasAVX2();
+
+            if (useF16C)
+                done = decodeHalfF16C (data, destination, numSamples);
+           #elif PINGPONG_USE_NEON
+            done = decodeHalfNeon (data, destination, numSamples);
+           #endif
+
+            decodeScalar<HalfCodec> (data, destination, done, numSamples);
+        }
+    }
+
+    //==============================================================================
+
+    /*A double precision loop with a narrower line. Rare enough that the plain loops (which the compiler
+    vectorises where it can) are fast enough.*/
+    void encode (Format format, const double* source, void* destination, int numSamples)
+    {
+        switch (format)
+        {
+            case Format::float32: encodeScalar<Float32Codec> (source, (float*)destination, 0, numSamples); break;
+            case Format::int16:   encodeScalar<Int16Codec> (source, (int16*)destination, 0, numSamples); break;
+            case Format::half:    encodeScalar<HalfCodec> (source, (uint16*)destination, 0, numSamples); break;
+            case Format::float64: std::memcpy (destination, source, (size_t)numSamples * sizeof (double)); break;
+        }
+    }
+
+    void decode (Format format, const void* source, double* destination, int numSamples)
+    {
+        switch (format)
+        {
+            case Format::float32: decodeScalar<Float32Codec> ((const float*)source, destination, 0, numSamples); break;
+            case Format::int16:   decodeScalar<Int16Codec> ((const int16*)source, destination, 0, numSamples); break;
+            case Format::half:    decodeScalar<HalfCodec> ((const uint16*)source, destination, 0, numSamples); break;
+            case Format::float64: std::memcpy (destination, source, (size_t)numSamples * sizeof (double)); break;
+        }
+    }
+}
@@ -0,0 +1,152 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Sample formats the delay line can be stored in.
+
+     Processing runs in float or double, whatever the host asks for. A line stored in any other format
+     than the one native to the processing type is converted: the read side of each segment is decoded
+     into a scratch buffer, processed, and the written side is encoded back. The 16-bit formats halve the
+     memory (and the memory bandwidth) of long delays, the 64-bit one keeps a double precision loop exact.
+     encode() and decode() convert whole runs of samples (the float <-> 16-bit ones with SSE2/F16C/NEON),
+     the codec structs convert single samples for the loops that index the ring sample by sample.
+
+     Vector and scalar conversions round the same way (to nearest, ties to even), so the result
+     doesn't depend on which one ran.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+
+namespace DelayStorage
+{
+    /*Order matches the items of the "Delay storage" parameter*/
+    enum class Format
+    {
+        float32 = 0,
+        int16,
+        half,
+        float64
+    };
+
+    /*The format that holds samples of the processing type as they are*/
+    template <typename SampleType>
+    inline Format getNativeFormat()
+    {
+        return std::is_same<SampleType, double>::value ? Format::float64 : Format::float32;
+    }
+
+    /*Full scale of the 16-bit integer format. Input plus feedback can go well above 0 dBFS inside the loop,
+    so it keeps 18 dB of headroom, and louder samples are clipped.*/
+    const float int16FullScale = 8.0f;
+
+    int getBytesPerSample (Format format);
+
+    /*Converts numSamples floats or doubles into the given format / back*/
+    void encode (Format format, const float* source, void* destination, int numSamples);
+    void encode (Format format, const double* source, void* destination, int numSamples);
+    void decode (Format format, const void* source, float* destination, int numSamples);
+    void decode (Format format, const void* source, double* destination, int numSamples);
+
+    //==============================================================================
+
+    /*decode() returns float, or double for the 64-bit format. encode() takes either processing type.*/
+    struct Float32Codec
+    {
+        using Type = float;
+
+        static float decode (float value) { return value; }
+
+        template <typename SampleType>
+        static float encode (SampleType value) { return (float)value; }
+    };
+
+    struct Float64Codec
+    {
+        using Type = double;
+
+        static double decode (double value) { return value; }
+
+        template <typename SampleType>
+        static double encode (SampleType value) { return (double)value; }
+    };
+
+    struct Int16Codec
+    {
+        using Type = int16;
+
+        static float decode (int16 value)
+        {
+            return (float)value * (int16FullScale / 32767.0f);
+        }
+
+        template <typename SampleType>
+        static int16 encode (SampleType value)
+        {
+            const float scaled = jlimit (-32767.0f, 32767.0f, (float)value * (32767.0f / int16FullScale));
+            return (int16)std::lrint (scaled);
+        }
+    };
+
+    /*IEEE 754 binary16: 11 significant bits and a range of +-65504, so the noise follows the level of the signal*/
+    struct HalfCodec
+    {
+        using Type = uint16;
+
+        static float decode (uint16 value)
+        {
+            uint32 bits = (uint32)(value & 0x7fff) << 13;
+            const uint32 exponent = bits & (0x7c00u << 13);
+            bits += (127 - 15) << 23;
+
+            if (exponent == (0x7c00u << 13))        // infinity or NaN
+            {
+                bits += (128 - 16) << 23;
+            }
+            else if (exponent == 0)                 // zero or subnormal, renormalised through a float subtraction
+            {
+                bits += 1 << 23;
+                bits = toBits (fromBits (bits) - fromBits (113u << 23));
+            }
+
+            return fromBits (bits | ((uint32)(value & 0x8000) << 16));
+        }
+
+        template <typename SampleType>
+        static uint16 encode (SampleType value)
+        {
+            uint32 bits = toBits ((float)value);
+            const uint32 sign = bits & 0x80000000u;
+            bits ^= sign;
+
+            uint32 result;
+
+            if (bits >= (143u << 23))               // too big for a half: infinity (or NaN)
+            {
+                result = bits > (255u << 23) ? 0x7e00 : 0x7c00;
+            }
+            else if (bits < (113u << 23))           // subnormal half, rounded by a float addition
+            {
+                result = toBits (fromBits (bits) + 0.5f) - toBits (0.5f);
+            }
+            else
+            {
+                const uint32 mantissaIsOdd = (bits >> 13) & 1;
+                bits += ((uint32)(15 - 127) << 23) + 0xfff + mantissaIsOdd;
+                result = bits >> 13;
+            }
+
+            return (uint16)(result | (sign >> 16));
+        }
+
+    private:
+        static uint32 toBits (float value)    { uint32 bits; std::memcpy (&bits, &value, sizeof (bits)); return bits; }
+        static float fromBits (uint32 bits)   { float value; std::memcpy (&value, &bits, sizeof (value)); return value; }
+    };
+}
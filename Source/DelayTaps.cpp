@@ -0,0 +1,584 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Extra read taps of the delay line, see DelayTaps.h.
+
+  ==============================================================================
+*/
+
+#include "DelayTaps.h"
+
+//==============================================================================
+
+namespace
+{
+    /*Weights of the interpolator for a fixed fraction, newest tap first. Returns the number of taps and sets how
+    many of them are newer than the near sample.*/
+    template <typename SampleType>
+    int getTapWeights (InterpolationType type, SampleType fraction, SampleType* weights, int& tapsAhead)
+    {
+        switch (type)
+        {
+            case InterpolationType::integer:
+                IntegerInterpolation::computeWeights (fraction, weights);
+                tapsAhead = IntegerInterpolation::tapsAhead;
+                return IntegerInterpolation::numTaps;
+
+            case InterpolationType::lagrange:
+                LagrangeInterpolation::computeWeights (fraction, weights);
+                tapsAhead = LagrangeInterpolation::tapsAhead;
+                return LagrangeInterpolation::numTaps;
+
+            case InterpolationType::hermite:
+                HermiteInterpolation::computeWeights (fraction, weights);
+                tapsAhead = HermiteInterpolation::tapsAhead;
+                return HermiteInterpolation::numTaps;
+
+            case InterpolationType::sinc:
+                SincInterpolation::computeWeights (fraction, weights);
+                tapsAhead = SincInterpolation::tapsAhead;
+                return SincInterpolation::numTaps;
+
+            case InterpolationType::linear:
+            case InterpolationType::allpass:
+                break;
+        }
+
+        LinearInterpolation::computeWeights (fraction, weights);
+        tapsAhead = LinearInterpolation::tapsAhead;
+        return LinearInterpolation::numTaps;
+    }
+
+    /*Like the input balance, but a centred tap plays at full level on both sides. A centre speaker only gets as much
+    as the quieter side, so a tap panned hard to one side stays there. Mono has no sides.*/
+    inline float getPanGain (DelayKernels::Side side, int numChannels, float pan)
+    {
+        const float left = jmin (1.0f, 2.0f * (1.0f - pan));
+        const float right = jmin (1.0f, 2.0f * pan);
+
+        if (numChannels == 1)
+            return 1.0f;
+
+        if (side == DelayKernels::Side::both)
+            return jmin (left, right);
+
+        return side == DelayKernels::Side::left ? left : right;
+    }
+}
+
+//==============================================================================
+
+void DelayTaps::prepare (double sampleRate, int maximumBlockSize, const DelayKernels::LoopLayout& layout, bool doublePrecision)
+{
+    numChannels = layout.numChannels;
+    std::copy (layout.sides, layout.sides + numChannels, sides);
+
+    // the smoothing times of the read head, see PingPongDelayAudioProcessor::prepareRamps
+    for (auto& tapRamps : ramps)
+    {
+        tapRamps[delayRamp].prepare (sampleRate, 50e-3, maximumBlockSize);
+        tapRamps[gainRamp].prepare (sampleRate, 1e-3, maximumBlockSize);
+        tapRamps[panRamp].prepare (sampleRate, 1e-3, maximumBlockSize);
+        tapRamps[crossFeedRamp].prepare (sampleRate, 1e-3, maximumBlockSize);
+    }
+
+    setMaximumBlockSize (maximumBlockSize, doublePrecision);
+    updateAudibleTaps();
+}
+
+void DelayTaps::setMaximumBlockSize (int maximumBlockSize, bool doublePrecision)
+{
+    for (auto& tapRamps : ramps)
+        for (auto& ramp : tapRamps)
+            ramp.setMaximumBlockSize (maximumBlockSize);
+
+    const int bufferLength = maximumBlockSize + DelayLine::guardSamples;
+    const int numBuffers = 3 * numChannels + maxTaps;
+    buffers.setSize (doublePrecision ? 0 : numBuffers, bufferLength, false, false, true);
+    buffersDouble.setSize (doublePrecision ? numBuffers : 0, bufferLength, false, false, true);
+}
+
+void DelayTaps::release()
+{
+    for (auto& tapRamps : ramps)
+        for (auto& ramp : tapRamps)
+            ramp.release();
+
+    buffers.setSize (0, 0);
+    buffersDouble.setSize (0, 0);
+    numAudibleTaps = 0;
+}
+
+size_t DelayTaps::getSizeInBytes() const
+{
+    return (size_t)ramps[0][0].getMaximumBlockSize() * sizeof (float) * maxTaps * numRamps
+         + (size_t)buffers.getNumChannels() * (size_t)buffers.getNumSamples() * sizeof (float)
+         + (size_t)buffersDouble.getNumChannels() * (size_t)buffersDouble.getNumSamples() * sizeof (double);
+}
+
+//==============================================================================
+
+void DelayTaps::setTargets (int numActiveTaps, const float* delaySamples, const TapSettings* settings, float feedback)
+{
+    float totalCrossFeed = 0.0f;
+
+    for (int tap = 0; tap < numActiveTaps; ++tap)
+        totalCrossFeed += settings[tap].crossFeed;
+
+    const float crossFeedRoom = jmax (0.0f, maximumLoopGain - feedback);
+    const float crossFeedScale = totalCrossFeed > crossFeedRoom ? crossFeedRoom / totalCrossFeed : 1.0f;
+
+    for (int tap = 0; tap < maxTaps; ++tap)
+    {
+        const bool active = tap < numActiveTaps;
+
+        // a tap that can't be heard starts at its new place instead of sweeping there
+        if (isAudible (tap))
+        {
+            ramps[tap][delayRamp].setTargetValue (delaySamples[tap]);
+            ramps[tap][panRamp].setTargetValue (settings[tap].pan);
+        }
+        else
+        {
+            ramps[tap][delayRamp].setCurrentAndTargetValue (delaySamples[tap]);
+            ramps[tap][panRamp].setCurrentAndTargetValue (settings[tap].pan);
+        }
+
+        ramps[tap][gainRamp].setTargetValue (active ? settings[tap].gain : 0.0f);
+        ramps[tap][crossFeedRamp].setTargetValue (active ? settings[tap].crossFeed * crossFeedScale : 0.0f);
+    }
+
+    updateAudibleTaps();
+}
+
+void DelayTaps::jumpToTargets()
+{
+    for (auto& tapRamps : ramps)
+        for (auto& ramp : tapRamps)
+            ramp.setCurrentAndTargetValue (ramp.getTargetValue());
+
+    updateAudibleTaps();
+}
+
+void DelayTaps::scaleDelays (double ratio)
+{
+    for (auto& tapRamps : ramps)
+        tapRamps[delayRamp].setCurrentAndTargetValue ((float)(tapRamps[delayRamp].getCurrentValue() * ratio));
+}
+
+void DelayTaps::setInterpolation (InterpolationType type)
+{
+    interpolation = type == InterpolationType::allpass ? InterpolationType::linear : type;
+
+    // an interpolator that reads further ahead needs longer delays, like the read head's they jump there
+    const float minimumDelay = (float)(getInterpolationTapsAhead (interpolation) + 1);
+
+    for (auto& tapRamps : ramps)
+        if (tapRamps[delayRamp].getCurrentValue() < minimumDelay)
+            tapRamps[delayRamp].setCurrentAndTargetValue (minimumDelay);
+}
+
+bool DelayTaps::isAudible (int tap) const
+{
+    return ramps[tap][gainRamp].getCurrentValue() != 0.0f || ramps[tap][gainRamp].getTargetValue() != 0.0f
+        || isSending (tap);
+}
+
+bool DelayTaps::isSending (int tap) const
+{
+    return ramps[tap][crossFeedRamp].getCurrentValue() != 0.0f || ramps[tap][crossFeedRamp].getTargetValue() != 0.0f;
+}
+
+bool DelayTaps::isSending() const
+{
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+        if (isSending (tap))
+            return true;
+
+    return false;
+}
+
+/*Nothing about the tap moves in this block, so it can be gathered with the others*/
+bool DelayTaps::isStill (int tap) const
+{
+    for (auto* values : blockValues[tap].values)
+        if (values != nullptr)
+            return false;
+
+    return true;
+}
+
+/*The last audible tap plus one, the loops skip the silent taps below it*/
+void DelayTaps::updateAudibleTaps()
+{
+    numAudibleTaps = 0;
+
+    for (int tap = 0; tap < maxTaps; ++tap)
+        if (isAudible (tap))
+            numAudibleTaps = tap + 1;
+}
+
+int DelayTaps::getSendDistance() const
+{
+    const int tapsAhead = getInterpolationTapsAhead (interpolation);
+    int distance = std::numeric_limits<int>::max();
+
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+        if (isSending (tap))
+            distance = jmin (distance, (int)jmin (ramps[tap][delayRamp].getCurrentValue(), ramps[tap][delayRamp].getTargetValue()) - tapsAhead);
+
+    return distance;
+}
+
+float DelayTaps::getLongestDelay() const
+{
+    float longest = 0.0f;
+
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+        if (isAudible (tap))
+            longest = jmax (longest, ramps[tap][delayRamp].getCurrentValue(), ramps[tap][delayRamp].getTargetValue());
+
+    return longest;
+}
+
+float DelayTaps::getTotalCrossFeed() const
+{
+    float total = 0.0f;
+
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+        total += ramps[tap][crossFeedRamp].getTargetValue();
+
+    return total;
+}
+
+//==============================================================================
+
+template <>
+AudioBuffer<float>& DelayTaps::getBuffers<float>()
+{
+    return buffers;
+}
+
+template <>
+AudioBuffer<double>& DelayTaps::getBuffers<double>()
+{
+    return buffersDouble;
+}
+
+template <typename SampleType>
+void DelayTaps::beginBlock (int numSamples)
+{
+    blockSending = false;
+    blockWet = false;
+
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+    {
+        BlockValues& block = blockValues[tap];
+
+        // decided before the ramps move, so the same taps are read before and after the delay loop
+        block.audible = isAudible (tap);
+        block.sending = isSending (tap);
+        blockSending = blockSending || block.sending;
+
+        for (int ramp = 0; ramp < numRamps; ++ramp)
+        {
+            block.constants[ramp] = ramps[tap][ramp].getCurrentValue();
+            block.values[ramp] = ramps[tap][ramp].isSmoothing() ? ramps[tap][ramp].fillRamp (numSamples) : nullptr;
+        }
+
+        // the still taps after the delay loop go straight into the output, everything else through the wet buffer
+        blockWet = blockWet || (block.audible && (block.sending || ! isStill (tap)));
+    }
+
+    AudioBuffer<SampleType>& tapBuffers = getBuffers<SampleType>();
+
+    if (blockWet)
+        for (int channel = 0; channel < numChannels; ++channel)
+            FloatVectorOperations::clear (tapBuffers.getWritePointer (channel), numSamples);
+
+    if (blockSending)
+        for (int channel = numChannels; channel < 2 * numChannels; ++channel)
+            FloatVectorOperations::clear (tapBuffers.getWritePointer (channel), numSamples);
+}
+
+/*Reads one tap of every channel into the tap buffers. A fixed delay reads runs of contiguous samples and applies
+each interpolator weight to the whole run, a moving one goes through the per-sample tap kernel.*/
+template <typename SampleType>
+void DelayTaps::readTap (int tap, const DelayLine& delayLine, int writePosition, int numSamples)
+{
+    AudioBuffer<SampleType>& tapBuffers = getBuffers<SampleType>();
+    const BlockValues& block = blockValues[tap];
+
+    if (block.values[delayRamp] != nullptr)
+    {
+        DelayKernels::TapBlock<SampleType> tapBlock;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            tapBlock.delay[channel] = delayLine.getChannelData (channel);
+            tapBlock.out[channel] = tapBuffers.getWritePointer (2 * numChannels + channel);
+        }
+
+        tapBlock.writePosition = writePosition;
+        tapBlock.mask = delayLine.getMask();
+        tapBlock.numSamples = numSamples;
+        tapBlock.delaySamples = block.values[delayRamp];
+
+        DelayKernels::getTapKernel<SampleType> (interpolation, numChannels, delayLine.getFormat()) (tapBlock);
+        return;
+    }
+
+    const float delaySamples = block.constants[delayRamp];
+    const int delayWhole = (int)delaySamples;
+
+    SampleType weights[SincInterpolation::numTaps];
+    int tapsAhead = 0;
+    const int numTaps = getTapWeights (interpolation, (SampleType)(delaySamples - (float)delayWhole), weights, tapsAhead);
+
+    const bool converted = delayLine.getFormat() != DelayStorage::getNativeFormat<SampleType>();
+    SampleType* decoded = tapBuffers.getWritePointer (3 * numChannels);
+    const int newestPosition = writePosition - delayWhole + tapsAhead;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        SampleType* out = tapBuffers.getWritePointer (2 * numChannels + channel);
+
+        // runs end where the ring wraps, the older taps behind index 0 are read from the guard
+        for (int done = 0; done < numSamples;)
+        {
+            const int position = (newestPosition + done) & delayLine.getMask();
+            const int count = jmin (numSamples - done, delayLine.getLength() - position);
+            const SampleType* run;
+
+            if (converted)
+            {
+                delayLine.readSamples (channel, position - (numTaps - 1), decoded, count + numTaps - 1);
+                run = decoded + numTaps - 1;
+            }
+            else
+            {
+                run = delayLine.getWritePointer<SampleType> (channel) + position;
+            }
+
+            FloatVectorOperations::copyWithMultiply (out + done, run, weights[0], count);
+
+            for (int weight = 1; weight < numTaps; ++weight)
+                FloatVectorOperations::addWithMultiply (out + done, run - weight, weights[weight], count);
+
+            done += count;
+        }
+    }
+}
+
+/*Adds the tap that was just read to the wet buffer with its gain and pan, and with withSend its cross-feed to the
+send of the next channel*/
+template <typename SampleType>
+void DelayTaps::addTap (int tap, int numSamples, bool withSend)
+{
+    AudioBuffer<SampleType>& tapBuffers = getBuffers<SampleType>();
+    const BlockValues& block = blockValues[tap];
+    const float* gainValues = block.values[gainRamp];
+    const float* panValues = block.values[panRamp];
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        SampleType* wet = tapBuffers.getWritePointer (channel);
+        const SampleType* signal = tapBuffers.getReadPointer (2 * numChannels + channel);
+
+        if (gainValues == nullptr && panValues == nullptr)
+        {
+            const float gain = block.constants[gainRamp] * getPanGain (sides[channel], numChannels, block.constants[panRamp]);
+
+            if (gain != 0.0f)
+                FloatVectorOperations::addWithMultiply (wet, signal, (SampleType)gain, numSamples);
+        }
+        else
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                const float gain = gainValues != nullptr ? gainValues[sample] : block.constants[gainRamp];
+                const float pan = panValues != nullptr ? panValues[sample] : block.constants[panRamp];
+                wet[sample] += (SampleType)(gain * getPanGain (sides[channel], numChannels, pan)) * signal[sample];
+            }
+        }
+
+        if (! withSend)
+            continue;
+
+        // ping-pong like the feedback: every channel's tap goes into the next channel
+        SampleType* send = tapBuffers.getWritePointer (numChannels + (channel + 1) % numChannels);
+
+        if (const float* crossFeedValues = block.values[crossFeedRamp])
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+                send[sample] += (SampleType)crossFeedValues[sample] * signal[sample];
+        }
+        else
+        {
+            FloatVectorOperations::addWithMultiply (send, signal, (SampleType)block.constants[crossFeedRamp], numSamples);
+        }
+    }
+}
+
+/*All taps of the block that hold still and do (or don't) feed back, one pass per channel however many there are,
+added to outputs scaled by outputGain. Runs end where any of the taps reaches the end of the ring. A delay line
+stored in another format is decoded into one buffer per tap first.*/
+template <typename SampleType>
+void DelayTaps::gatherStillTaps (const DelayLine& delayLine, int writePosition, int numSamples, bool sending,
+                                 SampleType* const* outputs, float outputGain)
+{
+    int stillTaps[maxTaps];
+    int numStillTaps = 0;
+
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+        if (blockValues[tap].audible && blockValues[tap].sending == sending && isStill (tap))
+            stillTaps[numStillTaps++] = tap;
+
+    if (numStillTaps == 0)
+        return;
+
+    AudioBuffer<SampleType>& tapBuffers = getBuffers<SampleType>();
+    const bool converted = delayLine.getFormat() != DelayStorage::getNativeFormat<SampleType>();
+    const int tapsAhead = getInterpolationTapsAhead (interpolation);
+    const int numWeights = getInterpolationNumTaps (interpolation);
+    const DelayKernels::GatherKernel<SampleType> kernel = DelayKernels::getGatherKernel<SampleType> (interpolation);
+
+    DelayKernels::GatherBlock<SampleType> gather;
+    gather.numTaps = numStillTaps;
+    int newestPositions[maxTaps];
+
+    for (int i = 0; i < numStillTaps; ++i)
+    {
+        const float delaySamples = blockValues[stillTaps[i]].constants[delayRamp];
+        const int delayWhole = (int)delaySamples;
+        gather.fraction[i] = (SampleType)(delaySamples - (float)delayWhole);
+        gather.crossFeed[i] = (SampleType)blockValues[stillTaps[i]].constants[crossFeedRamp];
+        newestPositions[i] = writePosition - delayWhole + tapsAhead;
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (int i = 0; i < numStillTaps; ++i)
+        {
+            const BlockValues& block = blockValues[stillTaps[i]];
+            gather.gain[i] = (SampleType)(outputGain * block.constants[gainRamp] * getPanGain (sides[channel], numChannels, block.constants[panRamp]));
+        }
+
+        SampleType* wet = outputs[channel];
+        SampleType* send = sending ? tapBuffers.getWritePointer (numChannels + (channel + 1) % numChannels) : nullptr;
+
+        for (int done = 0; done < numSamples;)
+        {
+            int count = numSamples - done;
+
+            for (int i = 0; i < numStillTaps; ++i)
+                count = jmin (count, delayLine.getLength() - ((newestPositions[i] + done) & delayLine.getMask()));
+
+            for (int i = 0; i < numStillTaps; ++i)
+            {
+                const int position = (newestPositions[i] + done) & delayLine.getMask();
+
+                if (converted)
+                {
+                    SampleType* decoded = tapBuffers.getWritePointer (3 * numChannels + i);
+                    delayLine.readSamples (channel, position - (numWeights - 1), decoded, count + numWeights - 1);
+                    gather.read[i] = decoded + numWeights - 1;
+                }
+                else
+                {
+                    gather.read[i] = delayLine.getWritePointer<SampleType> (channel) + position;
+                }
+            }
+
+            gather.out = wet + done;
+            gather.send = send != nullptr ? send + done : nullptr;
+            gather.numSamples = count;
+            kernel (gather);
+
+            done += count;
+        }
+    }
+}
+
+template <typename SampleType>
+void DelayTaps::readSends (const DelayLine& delayLine, int writePosition, int numSamples)
+{
+    AudioBuffer<SampleType>& tapBuffers = getBuffers<SampleType>();
+    gatherStillTaps<SampleType> (delayLine, writePosition, numSamples, true, tapBuffers.getArrayOfWritePointers(), 1.0f);
+
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+    {
+        if (blockValues[tap].sending && ! isStill (tap))
+        {
+            readTap<SampleType> (tap, delayLine, writePosition, numSamples);
+            addTap<SampleType> (tap, numSamples, true);
+        }
+    }
+}
+
+template <typename SampleType>
+const SampleType* DelayTaps::getSend (int channel)
+{
+    return blockSending ? getBuffers<SampleType>().getReadPointer (numChannels + channel) : nullptr;
+}
+
+template <typename SampleType>
+void DelayTaps::addOutput (const DelayLine& delayLine, int writePosition, SampleType* const* io, int numSamples,
+                           const float* mixValues, float mix)
+{
+    AudioBuffer<SampleType>& tapBuffers = getBuffers<SampleType>();
+
+    // with a moving mix the still taps can't be scaled by one gain, so they go through the wet buffer too
+    if (mixValues != nullptr && ! blockWet)
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+            FloatVectorOperations::clear (tapBuffers.getWritePointer (channel), numSamples);
+
+        blockWet = true;
+    }
+
+    if (blockWet)
+        gatherStillTaps<SampleType> (delayLine, writePosition, numSamples, false, tapBuffers.getArrayOfWritePointers(), 1.0f);
+    else
+        gatherStillTaps<SampleType> (delayLine, writePosition, numSamples, false, io, mix);
+
+    for (int tap = 0; tap < numAudibleTaps; ++tap)
+    {
+        if (blockValues[tap].audible && ! blockValues[tap].sending && ! isStill (tap))
+        {
+            readTap<SampleType> (tap, delayLine, writePosition, numSamples);
+            addTap<SampleType> (tap, numSamples, false);
+        }
+    }
+
+    if (! blockWet)
+        return;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const SampleType* wet = tapBuffers.getReadPointer (channel);
+
+        if (mixValues != nullptr)
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+                io[channel][sample] += (SampleType)mixValues[sample] * wet[sample];
+        }
+        else
+        {
+            FloatVectorOperations::addWithMultiply (io[channel], wet, (SampleType)mix, numSamples);
+        }
+    }
+}
+
+//==============================================================================
+
+template void DelayTaps::beginBlock<float> (int);
+template void DelayTaps::beginBlock<double> (int);
+template void DelayTaps::readSends<float> (const DelayLine&, int, int);
+template void DelayTaps::readSends<double> (const DelayLine&, int, int);
+template const float* DelayTaps::getSend<float> (int);
+template const double* DelayTaps::getSend<double> (int);
+template void DelayTaps::addOutput<float> (const DelayLine&, int, float* const*, int, const float*, float);
+template void DelayTaps::addOutput<double> (const DelayLine&, int, double* const*, int, const float*, float);
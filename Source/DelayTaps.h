@@ -0,0 +1,168 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Extra read taps of the delay line, for rhythmic multi-tap patterns from a single instance.
+
+     The ping-pong read head is the first tap. Up to maxTaps more read the same delay line, each at its own delay
+     time, with its own gain and pan in the output and its own cross-feed: the part of the tap that is fed back
+     into the next channel of the line, the same way the ping-pong feedback goes from channel to channel. Several
+     stacked instances each need their own delay line and their own loop, the taps only need one of each.
+
+     A tap that holds still (delay, gain, pan and cross-feed all constant for the block) reads a contiguous run of
+     the ring. All of those taps are gathered in one vector loop per channel (DelayKernels::getGatherKernel): each
+     tap's interpolator weights are scaled by its gain and cross-feed, every tap is summed in registers, several
+     samples per instruction, and the output and send are written once. A tap that is moving is read one sample at a
+     time (DelayKernels::getTapKernel) and its gains are applied with JUCE's vector operations. Taps use the
+     interpolation of the read head, except that allpass taps read linearly (the allpass has a state and can't be
+     read from many places at once).
+
+     Per block of the processor:
+      - beginBlock fills the ramps of the taps that are moving;
+      - readSends reads the cross-feeding taps before the delay loop runs. It adds their part of the output to the
+        wet buffer and their cross-feed to the send buffers. The delay loop then adds the sends to what it writes,
+        see PingPongDelayAudioProcessor::processSubBlock. Blocks are cut so that no cross-feeding tap is shorter
+        than the block, so these taps only read samples that were written before it;
+      - addOutput reads the other taps after the loop (so even a tap shorter than the block reads samples that are
+        already written) and mixes the wet buffer into the output. Still taps that don't feed back go straight
+        into the output, so with only those the wet buffer isn't touched at all.
+
+     Everything is allocated in prepare. The other functions are for the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayKernels.h"
+#include "DelayLine.h"
+#include "ParameterRamp.h"
+
+//==============================================================================
+
+class DelayTaps
+{
+public:
+    /*Taps besides the ping-pong read head*/
+    enum { maxTaps = 7 };
+
+    /*Settings of one tap in the units of its parameters: seconds, 0 to 1, 0 (left) to 1 (right), and 0 to 0.9*/
+    struct TapSettings
+    {
+        float delayTime = 0.0f;
+        float gain = 0.0f;
+        float pan = 0.5f;
+        float crossFeed = 0.0f;
+    };
+
+    /*The sum of the feedback and every tap's cross-feed is kept below this, so the loop always decays*/
+    static constexpr float maximumLoopGain = 0.95f;
+
+    /*Allocates the ramps and buffers for blocks of up to maximumBlockSize samples in the given precision, for the
+    loop channels of layout (their sides pan the taps). The taps jump to their targets.*/
+    void prepare (double sampleRate, int maximumBlockSize, const DelayKernels::LoopLayout& layout, bool doublePrecision);
+
+    /*Grows the buffers for longer blocks without touching the taps, see PingPongDelayAudioProcessor::reprepare*/
+    void setMaximumBlockSize (int maximumBlockSize, bool doublePrecision);
+
+    void release();
+    size_t getSizeInBytes() const;
+
+    /*Where the taps head for. Taps from numActiveTaps on fade out. Delays are in samples and already limited to
+    what the delay line holds. The cross-feeds are scaled down together if the loop gain with the ping-pong
+    feedback would reach maximumLoopGain.*/
+    void setTargets (int numActiveTaps, const float* delaySamples, const TapSettings* settings, float feedback);
+
+    /*Every tap jumps to its target, for the idle path*/
+    void jumpToTargets();
+
+    /*Moves every delay to the same time at a new sample rate (ratio is the new rate over the old one)*/
+    void scaleDelays (double ratio);
+
+    /*Taps are read with this interpolation, the read head's (allpass becomes linear)*/
+    void setInterpolation (InterpolationType type);
+
+    /*True while any tap can be heard or feeds something back*/
+    bool isActive() const { return numAudibleTaps > 0; }
+
+    /*True while any tap feeds back into the delay line*/
+    bool isSending() const;
+
+    /*Longest block the cross-feeding taps allow, the shortest distance one of them reads behind the write head*/
+    int getSendDistance() const;
+
+    /*Longest delay any tap is at or heading for, in samples*/
+    float getLongestDelay() const;
+
+    /*Sum of the cross-feeds the taps are heading for*/
+    float getTotalCrossFeed() const;
+
+    //==============================================================================
+
+    /*Fills the ramps of the taps that are moving for the next numSamples samples and clears the wet and send buffers*/
+    template <typename SampleType>
+    void beginBlock (int numSamples);
+
+    /*Reads the cross-feeding taps, writePosition being the ring index the block will be written to. Nothing the
+    block writes is read.*/
+    template <typename SampleType>
+    void readSends (const DelayLine& delayLine, int writePosition, int numSamples);
+
+    /*The cross-feed for a channel, numSamples long, to add to what the delay loop writes, nullptr if none*/
+    template <typename SampleType>
+    const SampleType* getSend (int channel);
+
+    /*Reads the other taps after the block has been written and adds all of them to io, scaled by mix (mixValues
+    while the mix is moving, nullptr otherwise)*/
+    template <typename SampleType>
+    void addOutput (const DelayLine& delayLine, int writePosition, SampleType* const* io, int numSamples,
+                    const float* mixValues, float mix);
+
+private:
+    enum { delayRamp, gainRamp, panRamp, crossFeedRamp, numRamps };
+
+    /*Values of one tap for the block being processed: a ramp buffer while the value moves, else nullptr and the constant.
+    Whether the tap is read at all, and before or after the delay loop, is decided once for the block.*/
+    struct BlockValues
+    {
+        const float* values[numRamps];
+        float constants[numRamps];
+        bool audible;
+        bool sending;
+    };
+
+    bool isAudible (int tap) const;
+    bool isSending (int tap) const;
+    bool isStill (int tap) const;
+    void updateAudibleTaps();
+
+    template <typename SampleType>
+    void gatherStillTaps (const DelayLine& delayLine, int writePosition, int numSamples, bool sending,
+                          SampleType* const* outputs, float outputGain);
+
+    template <typename SampleType>
+    void readTap (int tap, const DelayLine& delayLine, int writePosition, int numSamples);
+
+    template <typename SampleType>
+    void addTap (int tap, int numSamples, bool withSend);
+
+    template <typename SampleType>
+    AudioBuffer<SampleType>& getBuffers();
+
+    ParameterRamp ramps[maxTaps][numRamps];
+    BlockValues blockValues[maxTaps];
+    bool blockSending = false;
+    bool blockWet = false;
+    int numAudibleTaps = 0;
+
+    int numChannels = 0;
+    DelayKernels::Side sides[DelayKernels::maxChannels] = {};
+    InterpolationType interpolation = InterpolationType::linear;
+
+    /*numChannels each of: the wet signal of all taps, the sends, and the tap being read. Then maxTaps channels to
+    decode runs of a delay line stored in another format. Only the buffers of the precision in use are allocated.*/
+    AudioBuffer<float> buffers;
+    AudioBuffer<double> buffersDouble;
+};
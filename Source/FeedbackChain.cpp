@@ -0,0 +1,297 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     The feedback chain's stages and loops, see FeedbackChain.h.
+
+  ==============================================================================
+*/
+
+#include "FeedbackChain.h"
+
+//==============================================================================
+
+namespace
+{
+    /*Lowest frequency the DC blocker lets through*/
+    const double dcBlockerFrequency = 5.0;
+
+    /*The coefficients and the filter memory of one channel in the sample type of the loop, as locals, so the stages
+    that are compiled in keep them in registers and the ones that aren't are optimised out along with their stage.*/
+    template <typename SampleType>
+    struct StageCoefficients
+    {
+        explicit StageCoefficients (const FeedbackChain::Coefficients& c)
+            : onePole ((SampleType)c.onePole), onePoleFeedback ((SampleType)(1.0 - c.onePole)), b0 ((SampleType)c.b0), b1 ((SampleType)c.b1), b2 ((SampleType)c.b2),
+              a1 ((SampleType)c.a1), a2 ((SampleType)c.a2), drive ((SampleType)c.drive),
+              inverseDrive ((SampleType)c.inverseDrive), dcPole ((SampleType)c.dcPole)
+        {
+        }
+
+        const SampleType onePole, onePoleFeedback, b0, b1, b2, a1, a2, drive, inverseDrive, dcPole;
+    };
+
+    template <typename SampleType>
+    struct StageState
+    {
+        void loadFrom (const FeedbackChain::ChannelState& state)
+        {
+            z1 = (SampleType)state.damping[0];
+            z2 = (SampleType)state.damping[1];
+            dcInput = (SampleType)state.dcInput;
+            dcOutput = (SampleType)state.dcOutput;
+        }
+
+        void storeTo (FeedbackChain::ChannelState& state) const
+        {
+            state.damping[0] = (double)z1;
+            state.damping[1] = (double)z2;
+            state.dcInput = (double)dcInput;
+            state.dcOutput = (double)dcOutput;
+        }
+
+        SampleType z1, z2, dcInput, dcOutput;
+    };
+
+    //==============================================================================
+
+    /*Every stage is a template whose "off" specialization hands its input straight on, so a stage that is off
+    costs nothing once the chain is inlined.*/
+
+    /*Cubic soft clipper: x - x^3 / 3, which reaches 2/3 with a flat slope at x = 1 and is held there. No division,
+    so it costs a few multiplies per sample. The drive scales the signal into it and back out, so quiet repeats keep
+    their level and only the loud ones are rounded off.*/
+    template <bool enabled>
+    struct Saturation
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>& c, StageState<SampleType>&)
+        {
+            // jmin and jmax become min and max instructions, with noise at the input a branch would guess wrong half the time
+            const SampleType driven = jmax (SampleType (-1), jmin (SampleType (1), x * c.drive));
+            return (driven - driven * driven * driven * SampleType (1.0 / 3.0)) * c.inverseDrive;
+        }
+    };
+
+    template <>
+    struct Saturation<false>
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>&, StageState<SampleType>&) { return x; }
+    };
+
+    template <FeedbackChain::Damping type>
+    struct Damping;
+
+    template <>
+    struct Damping<FeedbackChain::Damping::off>
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>&, StageState<SampleType>&) { return x; }
+    };
+
+    /*6 dB per octave, the gentle darkening of a worn tape. Written as two products so each sample only waits for one
+    multiply and one add of the one before.*/
+    template <>
+    struct Damping<FeedbackChain::Damping::onePole>
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>& c, StageState<SampleType>& s)
+        {
+            s.z1 = c.onePole * x + c.onePoleFeedback * s.z1;
+            return s.z1;
+        }
+    };
+
+    /*12 dB per octave Butterworth lowpass (transposed direct form II). The terms that don't need the output are
+    added first, so only one multiply and one subtraction wait for it.*/
+    template <>
+    struct Damping<FeedbackChain::Damping::biquad>
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>& c, StageState<SampleType>& s)
+        {
+            const SampleType y = c.b0 * x + s.z1;
+            s.z1 = (c.b1 * x + s.z2) - c.a1 * y;
+            s.z2 = c.b2 * x - c.a2 * y;
+            return y;
+        }
+    };
+
+    template <bool enabled>
+    struct DCBlocker
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>& c, StageState<SampleType>& s)
+        {
+            s.dcOutput = x - s.dcInput + c.dcPole * s.dcOutput;
+            s.dcInput = x;
+            return s.dcOutput;
+        }
+    };
+
+    template <>
+    struct DCBlocker<false>
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>&, StageState<SampleType>&) { return x; }
+    };
+
+    //==============================================================================
+
+    /*The chain: each stage's output is the next one's input, first to last*/
+    template <typename... Stages>
+    struct StageList;
+
+    template <>
+    struct StageList<>
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>&, StageState<SampleType>&) { return x; }
+    };
+
+    template <typename First, typename... Rest>
+    struct StageList<First, Rest...>
+    {
+        template <typename SampleType>
+        static SampleType process (SampleType x, const StageCoefficients<SampleType>& c, StageState<SampleType>& s)
+        {
+            return StageList<Rest...>::process (First::process (x, c, s), c, s);
+        }
+    };
+
+    /*One loop per combination of stages and channel count. Each sample depends on the filter memory the one before
+    left, so a channel can only go a sample at a time, but the channels don't depend on each other: they all go
+    through the same sample together, so the processor works on several recursions at once instead of waiting for
+    each step of one of them.*/
+    template <typename SampleType, int numChannels, typename Stages>
+    void processChannels (const FeedbackChain::Coefficients& coefficients, FeedbackChain::ChannelState* states,
+                          SampleType* const* data, int numSamples)
+    {
+        const StageCoefficients<SampleType> c (coefficients);
+        StageState<SampleType> s[numChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            s[channel].loadFrom (states[channel]);
+
+        for (int sample = 0; sample < numSamples; ++sample)
+            for (int channel = 0; channel < numChannels; ++channel)
+                data[channel][sample] = Stages::process (data[channel][sample], c, s[channel]);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            s[channel].storeTo (states[channel]);
+    }
+
+    template <typename SampleType, typename Stages>
+    FeedbackChain::Kernel<SampleType> getKernelFor (int numChannels)
+    {
+        switch (numChannels)
+        {
+            case 1:  return processChannels<SampleType, 1, Stages>;
+            case 4:  return processChannels<SampleType, 4, Stages>;
+            case 5:  return processChannels<SampleType, 5, Stages>;
+            case 7:  return processChannels<SampleType, 7, Stages>;
+            default: return processChannels<SampleType, 2, Stages>;
+        }
+    }
+
+    template <typename SampleType, FeedbackChain::Damping damping>
+    FeedbackChain::Kernel<SampleType> getKernelFor (bool saturation, bool dcBlocker, int numChannels)
+    {
+        if (saturation)
+            return dcBlocker ? getKernelFor<SampleType, StageList<Saturation<true>, Damping<damping>, DCBlocker<true>>> (numChannels)
+                             : getKernelFor<SampleType, StageList<Saturation<true>, Damping<damping>, DCBlocker<false>>> (numChannels);
+
+        return dcBlocker ? getKernelFor<SampleType, StageList<Saturation<false>, Damping<damping>, DCBlocker<true>>> (numChannels)
+                         : getKernelFor<SampleType, StageList<Saturation<false>, Damping<damping>, DCBlocker<false>>> (numChannels);
+    }
+
+    /*nullptr with every stage off, there is nothing to run then*/
+    template <typename SampleType>
+    FeedbackChain::Kernel<SampleType> getChainKernel (const FeedbackChain::Settings& settings, int numChannels)
+    {
+        switch (settings.damping)
+        {
+            case FeedbackChain::Damping::onePole: return getKernelFor<SampleType, FeedbackChain::Damping::onePole> (settings.saturation, settings.dcBlocker, numChannels);
+            case FeedbackChain::Damping::biquad:  return getKernelFor<SampleType, FeedbackChain::Damping::biquad> (settings.saturation, settings.dcBlocker, numChannels);
+            case FeedbackChain::Damping::off:     break;
+        }
+
+        if (! settings.saturation && ! settings.dcBlocker)
+            return nullptr;
+
+        return getKernelFor<SampleType, FeedbackChain::Damping::off> (settings.saturation, settings.dcBlocker, numChannels);
+    }
+}
+
+//==============================================================================
+
+void FeedbackChain::prepare (double newSampleRate, int newNumChannels)
+{
+    sampleRate = newSampleRate;
+    numChannels = jlimit (1, (int)DelayKernels::maxChannels, newNumChannels);
+    updateCoefficients();
+    updateKernels();
+    reset();
+}
+
+void FeedbackChain::reset()
+{
+    for (auto& state : states)
+        state = ChannelState();
+}
+
+void FeedbackChain::setSettings (const Settings& newSettings)
+{
+    const bool dampingChanged = newSettings.damping != settings.damping;
+    const bool dcBlockerChanged = newSettings.dcBlocker != settings.dcBlocker;
+
+    if (! dampingChanged && ! dcBlockerChanged && newSettings.saturation == settings.saturation
+        && newSettings.dampingFrequency == settings.dampingFrequency && newSettings.drive == settings.drive)
+        return;
+
+    // the one-pole and the biquad share their memory, and what either left behind means nothing to the other
+    for (auto& state : states)
+    {
+        if (dampingChanged)
+            state.damping[0] = state.damping[1] = 0.0;
+
+        if (dcBlockerChanged)
+            state.dcInput = state.dcOutput = 0.0;
+    }
+
+    settings = newSettings;
+    updateCoefficients();
+    updateKernels();
+}
+
+void FeedbackChain::updateKernels()
+{
+    floatKernel = getChainKernel<float> (settings, numChannels);
+    doubleKernel = getChainKernel<double> (settings, numChannels);
+}
+
+/*The biquad is the usual RBJ cookbook lowpass with a Q of 1 / sqrt (2). The damping frequency is kept below
+0.45 times the sample rate, where the biquad's coefficients stay well behaved.*/
+void FeedbackChain::updateCoefficients()
+{
+    const double frequency = jlimit (20.0, 0.45 * sampleRate, (double)settings.dampingFrequency);
+    const double omega = MathConstants<double>::twoPi * frequency / sampleRate;
+
+    coefficients.onePole = 1.0 - std::exp (-omega);
+
+    const double cosine = std::cos (omega);
+    const double alpha = std::sin (omega) / std::sqrt (2.0);   // sin (omega) / (2 Q)
+    const double a0 = 1.0 + alpha;
+    coefficients.b0 = 0.5 * (1.0 - cosine) / a0;
+    coefficients.b1 = (1.0 - cosine) / a0;
+    coefficients.b2 = coefficients.b0;
+    coefficients.a1 = -2.0 * cosine / a0;
+    coefficients.a2 = (1.0 - alpha) / a0;
+
+    coefficients.drive = Decibels::decibelsToGain ((double)settings.drive);
+    coefficients.inverseDrive = 1.0 / coefficients.drive;
+
+    coefficients.dcPole = std::exp (-MathConstants<double>::twoPi * dcBlockerFrequency / sampleRate);
+}
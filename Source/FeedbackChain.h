@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Damping, saturation and DC blocking inside the feedback loop, for tape and analog style repeats.
+
+     The chain sits where a tape echo has its record head: what the delay loop writes into the line (the input plus
+     the fed back echo, plus the cross-feed of the taps) goes through it before anything reads it back. So every
+     repeat passes through the chain once more than the one before, and each one comes back a bit darker and
+     rounder. Three stages, in this order:
+      - saturation: a cubic soft clipper with a drive, unity gain for quiet signals, so it only touches loud repeats;
+      - damping: a one-pole or a 12 dB/octave biquad lowpass;
+      - DC blocker: a one-pole highpass at a few Hz, so an offset can't build up in the loop.
+
+     The stages aren't objects behind a virtual call. Each one is a template with a specialization for "off" that
+     returns its input, and the chain is a list of them composed at compile time (StageList in FeedbackChain.cpp).
+     Every combination of stages gets its own loop, with every stage that is on inlined into it and every stage that
+     is off compiled away, so the loop has no branches on the settings. The loop is picked once, whenever the
+     settings change, like the delay kernels are.
+
+     The processor runs the chain over each piece the delay loop has just written, in place, before the read head
+     or a tap can reach it (pieces are cut to the shortest read distance while the chain is on). With every stage
+     off there is no loop and nothing is touched.
+
+     Nothing is allocated, the audio thread calls everything except prepare.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayKernels.h"
+
+//==============================================================================
+
+class FeedbackChain
+{
+public:
+    /*Lowpass of the damping stage (order of the items matches the Damping parameter)*/
+    enum class Damping { off, onePole, biquad };
+
+    struct Settings
+    {
+        Damping damping = Damping::off;
+        float dampingFrequency = 6000.0f;   // Hz
+        bool saturation = false;
+        float drive = 6.0f;                 // dB
+        bool dcBlocker = false;
+    };
+
+    /*Coefficients of every stage, computed when the settings change. Kept as double so one set serves both
+    processing types, each loop takes its own copy in its sample type.*/
+    struct Coefficients
+    {
+        double onePole = 1.0;
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+        double drive = 1.0, inverseDrive = 1.0;
+        double dcPole = 0.0;
+    };
+
+    /*Memory of the filters of one channel (the biquad uses both damping values, the one-pole the first)*/
+    struct ChannelState
+    {
+        double damping[2];
+        double dcInput;
+        double dcOutput;
+    };
+
+    template <typename SampleType>
+    using Kernel = void (*) (const Coefficients&, ChannelState*, SampleType* const*, int);
+
+    /*Sets the sample rate the coefficients are computed for and the number of channels, and clears the state*/
+    void prepare (double sampleRate, int numChannels);
+
+    /*Clears the memory of every filter, for a delay line that has gone silent or has been resampled*/
+    void reset();
+
+    /*Once per block. Only recomputes anything when the settings differ from the last ones. A stage that is switched
+    on starts from silence.*/
+    void setSettings (const Settings& newSettings);
+
+    /*True while any stage is on*/
+    bool isActive() const { return floatKernel != nullptr; }
+
+    /*Runs the chain in place over numSamples samples the delay loop has just written into every channel*/
+    template <typename SampleType>
+    void process (SampleType* const* channels, int numSamples)
+    {
+        getKernel ((SampleType*)nullptr) (coefficients, states, channels, numSamples);
+    }
+
+private:
+    void updateCoefficients();
+    void updateKernels();
+
+    Kernel<float> getKernel (float*) const { return floatKernel; }
+    Kernel<double> getKernel (double*) const { return doubleKernel; }
+
+    double sampleRate = 44100.0;
+    int numChannels = 2;
+    Settings settings;
+    Coefficients coefficients;
+    ChannelState states[DelayKernels::maxChannels] = {};
+
+    /*Loops for the stages that are on and the number of channels, nullptr when no stage is on*/
+    Kernel<float> floatKernel = nullptr;
+    Kernel<double> doubleKernel = nullptr;
+};
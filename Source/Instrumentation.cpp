@@ -0,0 +1,224 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Block timing and audio thread checks, see Instrumentation.h. Compiles to nothing unless
+     PINGPONG_INSTRUMENTATION is set.
+
+  ==============================================================================
+*/
+
+#include "Instrumentation.h"
+
+#if PINGPONG_INSTRUMENTATION
+
+#include <cstdlib>
+#include <new>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <time.h>
+#endif
+
+//==============================================================================
+
+namespace
+{
+    /*The innermost BlockScope of the calling thread, nullptr outside of processBlock*/
+    thread_local Instrumentation::BlockScope* currentScope = nullptr;
+
+    int64 getThreadCpuNanoseconds() noexcept
+    {
+       #if JUCE_LINUX || JUCE_MAC
+        timespec time;
+
+        if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &time) == 0)
+            return (int64)time.tv_sec * 1000000000 + (int64)time.tv_nsec;
+       #endif
+
+        return -1;
+    }
+}
+
+//==============================================================================
+
+/*Every allocation and free in the plugin goes through here in instrumented builds. Plugins are built with hidden
+symbols, so these only replace the plugin's own operators, not the host's.*/
+void* operator new (std::size_t size)
+{
+    Instrumentation::noteAllocation();
+
+    if (void* memory = std::malloc (size != 0 ? size : 1))
+        return memory;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new (size);
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    Instrumentation::noteAllocation();
+    return std::malloc (size != 0 ? size : 1);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new (size, tag);
+}
+
+void operator delete (void* memory) noexcept
+{
+    if (memory != nullptr)
+        Instrumentation::noteAllocation();
+
+    std::free (memory);
+}
+
+void operator delete[] (void* memory) noexcept                          { operator delete (memory); }
+void operator delete (void* memory, std::size_t) noexcept               { operator delete (memory); }
+void operator delete[] (void* memory, std::size_t) noexcept             { operator delete (memory); }
+void operator delete (void* memory, const std::nothrow_t&) noexcept     { operator delete (memory); }
+void operator delete[] (void* memory, const std::nothrow_t&) noexcept   { operator delete (memory); }
+
+//==============================================================================
+
+Instrumentation::Instrumentation()
+    : cyclesPerSecond (SystemStats::getCpuSpeedInMegahertz() * 1.0e6)
+{
+    openDumpFile();
+    startTimerHz (10);
+}
+
+Instrumentation::~Instrumentation()
+{
+    stopTimer();
+    collect();
+}
+
+void Instrumentation::noteAllocation() noexcept
+{
+    if (currentScope != nullptr)
+        ++currentScope->allocations;
+}
+
+/*Audio thread. A full ring drops the record rather than wait for the reader.*/
+void Instrumentation::push (const BlockRecord& record) noexcept
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+    {
+        numDropped.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring[size1 > 0 ? start1 : start2] = record;
+    fifo.finishedWrite (1);
+}
+
+void Instrumentation::timerCallback()
+{
+    collect();
+}
+
+//==============================================================================
+
+void Instrumentation::openDumpFile()
+{
+    const String folder = SystemStats::getEnvironmentVariable ("PINGPONG_TIMING_DUMP", {});
+
+    if (folder.isEmpty() || ! File::isAbsolutePath (folder))
+        return;
+
+    const File file = File (folder).getNonexistentChildFile ("PingPongDelay timing", ".csv", false);
+    dumpFile = std::unique_ptr<FileOutputStream> (file.createOutputStream());
+
+    if (dumpFile != nullptr)
+        *dumpFile << "samples,sample_rate,wall_us,cpu_us,load,cycles_per_sample,allocations\n";
+}
+
+void Instrumentation::collect()
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+
+    double totalSeconds = 0.0;
+    double totalBlockSeconds = 0.0;
+    int64 totalSamples = 0;
+
+    auto addRecord = [&] (const BlockRecord& record)
+    {
+        const double wallSeconds = Time::highResolutionTicksToSeconds (record.wallTicks);
+        const double blockSeconds = (double)record.numSamples / record.sampleRate;
+        const double load = wallSeconds / jmax (blockSeconds, 1.0e-9);
+
+        ++stats.numBlocks;
+        ++stats.histogram[jlimit (0, (int)Stats::numBins - 1, (int)(load * 10.0))];
+        stats.numOverruns += load > 1.0 ? 1 : 0;
+        stats.numAllocatingBlocks += record.allocations > 0 ? 1 : 0;
+        stats.numWaitingBlocks += record.cpuNanoseconds >= 0
+                               && wallSeconds - (double)record.cpuNanoseconds * 1.0e-9 > waitThresholdSeconds ? 1 : 0;
+        stats.worstLoad = jmax (stats.worstLoad, load);
+
+        totalSeconds += wallSeconds;
+        totalBlockSeconds += blockSeconds;
+        totalSamples += record.numSamples;
+
+        if (dumpFile != nullptr)
+            *dumpFile << record.numSamples << "," << record.sampleRate << "," << String (wallSeconds * 1.0e6, 2) << ","
+                      << String (record.cpuNanoseconds >= 0 ? (double)record.cpuNanoseconds * 1.0e-3 : -1.0, 2) << ","
+                      << String (load, 4) << "," << String (wallSeconds * cyclesPerSecond / jmax (1, record.numSamples), 1) << ","
+                      << record.allocations << "\n";
+    };
+
+    for (int i = 0; i < size1; ++i)
+        addRecord (ring[start1 + i]);
+
+    for (int i = 0; i < size2; ++i)
+        addRecord (ring[start2 + i]);
+
+    fifo.finishedRead (size1 + size2);
+
+    stats.numDropped += numDropped.exchange (0, std::memory_order_relaxed);
+
+    if (totalSamples > 0)
+    {
+        stats.recentLoad = totalSeconds / totalBlockSeconds;
+        stats.recentCyclesPerSample = totalSeconds * cyclesPerSecond / (double)totalSamples;
+    }
+
+    if (dumpFile != nullptr)
+        dumpFile->flush();
+}
+
+//==============================================================================
+
+Instrumentation::BlockScope::BlockScope (Instrumentation& ownerToUse, double rate, int samples)
+    : owner (ownerToUse), outerScope (currentScope), sampleRate (rate), numSamples (samples),
+      startTicks (Time::getHighResolutionTicks()), startCpuNanoseconds (getThreadCpuNanoseconds())
+{
+    currentScope = this;
+}
+
+Instrumentation::BlockScope::~BlockScope()
+{
+    currentScope = outerScope;
+
+    const int64 endCpuNanoseconds = getThreadCpuNanoseconds();
+
+    BlockRecord record;
+    record.wallTicks = Time::getHighResolutionTicks() - startTicks;
+    record.cpuNanoseconds = startCpuNanoseconds >= 0 && endCpuNanoseconds >= 0 ? endCpuNanoseconds - startCpuNanoseconds : -1;
+    record.sampleRate = sampleRate;
+    record.numSamples = numSamples;
+    record.allocations = allocations;
+
+    owner.push (record);
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Optional timing of every processBlock call, for finding out whether the plugin is the one causing dropouts.
+
+     Build with PINGPONG_INSTRUMENTATION=1 (Projucer, "Preprocessor Definitions") to switch it on. Without it this
+     header declares nothing, the processor has no extra members and processBlock has no extra code.
+
+     The audio thread only fills in a BlockRecord per block and pushes it into a single-producer single-consumer
+     ring (JUCE's AbstractFifo over a fixed array, no locks and no allocation). A timer on the message thread drains
+     the ring ten times a second, keeps the statistics the editor's overlay shows and, if the environment variable
+     PINGPONG_TIMING_DUMP names a folder, appends every block to a CSV file in it.
+
+     Per block it measures:
+      - the wall time, also given as load (the share of the block's real time it took) and as CPU cycles per
+        sample at the processor's nominal clock,
+      - the time the thread actually ran (POSIX thread CPU clock). A block that took much longer than it ran was
+        waiting for something: a lock, a page fault, or being preempted. Locks inside the host or the OS can't be
+        seen directly, so this is how they show up. Windows doesn't have a precise thread clock, there it's left out.
+      - allocations: global operator new and delete are replaced in these builds (Instrumentation.cpp) and count
+        every call made on a thread that is inside processBlock.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+#ifndef PINGPONG_INSTRUMENTATION
+ #define PINGPONG_INSTRUMENTATION 0
+#endif
+
+#if PINGPONG_INSTRUMENTATION
+
+//==============================================================================
+
+class Instrumentation : private Timer
+{
+public:
+    /*What the audio thread records about one processBlock call*/
+    struct BlockRecord
+    {
+        int64 wallTicks;         // Time::getHighResolutionTicks units
+        int64 cpuNanoseconds;    // -1 where the thread clock isn't available
+        double sampleRate;
+        int numSamples;
+        int allocations;
+    };
+
+    /*Everything collected so far, kept on the message thread*/
+    struct Stats
+    {
+        /*Blocks by load, in steps of 10 %. The last bin holds everything from 110 % up.*/
+        enum { numBins = 12 };
+        int64 histogram[numBins] = {};
+
+        int64 numBlocks = 0;
+        int64 numOverruns = 0;          // blocks that took longer than their real time
+        int64 numAllocatingBlocks = 0;
+        int64 numWaitingBlocks = 0;
+        int64 numDropped = 0;           // records lost because the ring was full
+
+        double worstLoad = 0.0;
+        double recentLoad = 0.0;        // over the last collect()
+        double recentCyclesPerSample = 0.0;
+    };
+
+    Instrumentation();
+    ~Instrumentation();
+
+    /*Message thread. Empties the ring into the statistics and the dump file. Runs on a timer, headless tools
+    without a message loop call it themselves.*/
+    void collect();
+
+    /*Message thread*/
+    const Stats& getStats() const { return stats; }
+
+    /*Put on the stack at the top of processBlock. Records the block when it goes out of scope.*/
+    class BlockScope
+    {
+    public:
+        BlockScope (Instrumentation& owner, double sampleRate, int numSamples);
+        ~BlockScope();
+
+    private:
+        friend class Instrumentation;
+
+        Instrumentation& owner;
+        BlockScope* const outerScope;
+        const double sampleRate;
+        const int numSamples;
+        const int64 startTicks;
+        const int64 startCpuNanoseconds;
+        int allocations = 0;
+
+        JUCE_DECLARE_NON_COPYABLE (BlockScope)
+    };
+
+    /*Called by the replaced operator new and delete, on whatever thread allocates*/
+    static void noteAllocation() noexcept;
+
+    /*A block counts as waiting when its wall time is this much longer than the time the thread ran*/
+    static constexpr double waitThresholdSeconds = 100e-6;
+
+private:
+    void timerCallback() override;
+    void push (const BlockRecord& record) noexcept;
+    void openDumpFile();
+
+    enum { ringSize = 2048 };
+    AbstractFifo fifo { ringSize };
+    BlockRecord ring[ringSize];
+    std::atomic<int> numDropped { 0 };
+
+    const double cyclesPerSecond;
+    Stats stats;
+    std::unique_ptr<FileOutputStream> dumpFile;
+
+    JUCE_DECLARE_NON_COPYABLE (Instrumentation)
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Fractional-delay interpolators for the read head of the delay line.
+
+     Every FIR interpolator is a small policy class: how many taps it reads, how many of those are newer
+     than the "near" sample (the one a whole number of samples behind the write head), and the weight of
+     each tap for a given fraction. The delay kernels are templates on these classes, so every mode gets
+     its own loop and the cheap ones don't pay for the expensive ones.
+
+     Taps are ordered from newest to oldest. A fraction of 0 means exactly the near sample, a fraction
+     close to 1 means almost the sample before it. The weights are computed in the sample type of the
+     loop that uses them (float or double).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+
+/*Order matches the items of the "Interpolation" parameter*/
+enum class InterpolationType
+{
+    integer = 0,
+    linear,
+    lagrange,
+    hermite,
+    allpass,
+    sinc
+};
+
+//==============================================================================
+
+/*Nearest whole sample below the delay time. No interpolation at all.*/
+struct IntegerInterpolation
+{
+    enum { tapsAhead = 0, numTaps = 1 };
+
+    template <typename SampleType>
+    static void computeWeights (SampleType /*fraction*/, SampleType* weights)
+    {
+        weights[0] = SampleType (1);
+    }
+};
+
+/*Straight line between the near sample and the one before it (the original behaviour)*/
+struct LinearInterpolation
+{
+    enum { tapsAhead = 0, numTaps = 2 };
+
+    template <typename SampleType>
+    static void computeWeights (SampleType fraction, SampleType* weights)
+    {
+        weights[0] = SampleType (1) - fraction;
+        weights[1] = fraction;
+    }
+};
+
+/*Third order Lagrange polynomial through one newer and two older samples*/
+struct LagrangeInterpolation
+{
+    enum { tapsAhead = 1, numTaps = 4 };
+
+    template <typename SampleType>
+    static void computeWeights (SampleType fraction, SampleType* weights)
+    {
+        const SampleType d = fraction;
+        const SampleType one = 1, two = 2, half = SampleType (0.5), sixth = one / SampleType (6);
+        weights[0] = -d * (d - one) * (d - two) * sixth;
+        weights[1] = (d + one) * (d - one) * (d - two) * half;
+        weights[2] = -(d + one) * d * (d - two) * half;
+        weights[3] = (d + one) * d * (d - one) * sixth;
+    }
+};
+
+/*Cubic Hermite (Catmull-Rom) spline. Softer than Lagrange, with a continuous slope between samples.*/
+struct HermiteInterpolation
+{
+    enum { tapsAhead = 1, numTaps = 4 };
+
+    template <typename SampleType>
+    static void computeWeights (SampleType fraction, SampleType* weights)
+    {
+        const SampleType d = fraction;
+        const SampleType d2 = d * d;
+        const SampleType d3 = d2 * d;
+        weights[0] = SampleType (-0.5) * d + d2 - SampleType (0.5) * d3;
+        weights[1] = SampleType (1) - SampleType (2.5) * d2 + SampleType (1.5) * d3;
+        weights[2] = SampleType (0.5) * d + SampleType (2) * d2 - SampleType (1.5) * d3;
+        weights[3] = SampleType (-0.5) * d2 + SampleType (0.5) * d3;
+    }
+};
+
+/*Eight tap Blackman-windowed sinc. The weights come from a table of 256 fractions, interpolated linearly,
+so the per-sample cost doesn't include any sin() calls.*/
+struct SincInterpolation
+{
+    enum { tapsAhead = 3, numTaps = 8, numPhases = 256 };
+
+    template <typename SampleType>
+    static void computeWeights (SampleType fraction, SampleType* weights)
+    {
+        const SampleType position = fraction * (SampleType)numPhases;
+        const int phase = jmin ((int)position, numPhases - 1);
+        const SampleType blend = position - (SampleType)phase;
+
+        const float* a = getTable().weights[phase];
+        const float* b = getTable().weights[phase + 1];
+
+        for (int tap = 0; tap < numTaps; ++tap)
+            weights[tap] = (SampleType)a[tap] + blend * ((SampleType)b[tap] - (SampleType)a[tap]);
+    }
+
+    struct Table
+    {
+        Table()
+        {
+            for (int phase = 0; phase <= numPhases; ++phase)
+            {
+                const double fraction = (double)phase / (double)numPhases;
+                double phaseWeights[numTaps];
+                double sum = 0.0;
+
+                for (int tap = 0; tap < numTaps; ++tap)
+                {
+                    const double x = (double)(tap - tapsAhead) - fraction;
+                    const double sinc = x == 0.0 ? 1.0 : std::sin (MathConstants<double>::pi * x) / (MathConstants<double>::pi * x);
+                    const double window = 0.42 + 0.5 * std::cos (MathConstants<double>::twoPi * x / numTaps)
+                                               + 0.08 * std::cos (2.0 * MathConstants<double>::twoPi * x / numTaps);
+                    phaseWeights[tap] = sinc * window;
+                    sum += phaseWeights[tap];
+                }
+
+                // normalised so a constant signal passes at exactly unity gain
+                for (int tap = 0; tap < numTaps; ++tap)
+                    weights[phase][tap] = (float)(phaseWeights[tap] / sum);
+            }
+        }
+
+        float weights[numPhases + 1][numTaps];
+    };
+
+    /*Built the first time it is used. prepareToPlay calls this so that never happens on the audio thread.*/
+    static const Table& getTable()
+    {
+        static const Table table;
+        return table;
+    }
+};
+
+/*First order Thiran allpass. Flat magnitude response (no high-frequency loss at all), but it has a state,
+so it is recursive and always runs sample by sample. The fractional part is kept between 0.5 and 1.5 samples,
+where the allpass behaves best, by borrowing the newer sample when the fraction is below 0.5.*/
+struct AllpassInterpolation
+{
+    enum { tapsAhead = 1, numTaps = 3 };
+
+    template <typename SampleType>
+    static SampleType getCoefficient (SampleType delta)
+    {
+        return (SampleType (1) - delta) / (SampleType (1) + delta);
+    }
+};
+
+//==============================================================================
+
+/*How many samples newer than the near sample the given mode reads. The delay has to be at least this plus one
+sample, so the read head never reaches samples that haven't been written yet.*/
+inline int getInterpolationTapsAhead (InterpolationType type)
+{
+    switch (type)
+    {
+        case InterpolationType::integer:  return IntegerInterpolation::tapsAhead;
+        case InterpolationType::linear:   return LinearInterpolation::tapsAhead;
+        case InterpolationType::lagrange: return LagrangeInterpolation::tapsAhead;
+        case InterpolationType::hermite:  return HermiteInterpolation::tapsAhead;
+        case InterpolationType::allpass:  return AllpassInterpolation::tapsAhead;
+        case InterpolationType::sinc:     return SincInterpolation::tapsAhead;
+    }
+
+    return 0;
+}
+
+/*How many samples the given mode reads for one output sample*/
+inline int getInterpolationNumTaps (InterpolationType type)
+{
+    switch (type)
+    {
+        case InterpolationType::integer:  return IntegerInterpolation::numTaps;
+        case InterpolationType::linear:   return LinearInterpolation::numTaps;
+        case InterpolationType::lagrange: return LagrangeInterpolation::numTaps;
+        case InterpolationType::hermite:  return HermiteInterpolation::numTaps;
+        case InterpolationType::allpass:  return AllpassInterpolation::numTaps;
+        case InterpolationType::sinc:     return SincInterpolation::numTaps;
+    }
+
+    return 1;
+}
@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Meters and the bounce display, see LevelDisplay.h.
+
+  ==============================================================================
+*/
+
+#include "LevelDisplay.h"
+
+//==============================================================================
+
+LevelDisplay::LevelDisplay (LevelFeed& feedToShow, const AudioProcessor& processorToShow)
+    : feed (feedToShow), processor (processorToShow)
+{
+    // paints every pixel of its area, so the editor's layer behind it isn't drawn on each frame
+    setOpaque (true);
+    setInterceptsMouseClicks (false, false);
+
+    // whatever is left from an editor that was open before is out of date
+    feed.pull ([] (const LevelFeed::BlockLevels&) {});
+    feed.setReading (true);
+
+    startTimerHz (framesPerSecond);
+}
+
+LevelDisplay::~LevelDisplay()
+{
+    stopTimer();
+    feed.setReading (false);
+}
+
+//==============================================================================
+
+void LevelDisplay::timerCallback()
+{
+    float framePeaks[numMeters][LevelFeed::numSides] = {};
+
+    auto getPeak = [] (Range<float> range) { return jmax (std::abs (range.getStart()), std::abs (range.getEnd())); };
+
+    const int numBlocks = feed.pull ([&] (const LevelFeed::BlockLevels& levels)
+    {
+        for (int side = 0; side < LevelFeed::numSides; ++side)
+        {
+            framePeaks[meterInput][side] = jmax (framePeaks[meterInput][side], getPeak (levels.input[side]));
+            framePeaks[meterDelay][side] = jmax (framePeaks[meterDelay][side], getPeak (levels.delay[side]));
+            framePeaks[meterOutput][side] = jmax (framePeaks[meterOutput][side], getPeak (levels.output[side]));
+        }
+
+        addBlock (levels);
+    });
+
+    // the meters fall at a fixed rate in dB, so they keep moving for a moment after the audio stops
+    const float fall = Decibels::decibelsToGain (-meterFallDecibelsPerSecond / (float)framesPerSecond);
+    const float floor = Decibels::decibelsToGain (meterFloorDecibels);
+    bool metersMoving = false;
+
+    for (int meter = 0; meter < numMeters; ++meter)
+    {
+        for (int side = 0; side < LevelFeed::numSides; ++side)
+        {
+            meterPeaks[meter][side] = jmax (framePeaks[meter][side], meterPeaks[meter][side] * fall);
+            metersMoving = metersMoving || meterPeaks[meter][side] > floor;
+        }
+    }
+
+    if (numBlocks > 0 || metersMoving)
+        repaint();
+}
+
+/*Blocks are turned into columns of a fixed length of time. A block longer than a column fills several of them
+with its levels, shorter ones share a column.*/
+void LevelDisplay::addBlock (const LevelFeed::BlockLevels& levels)
+{
+    const double sampleRate = processor.getSampleRate() > 0.0 ? processor.getSampleRate() : 44100.0;
+    const double samplesPerColumn = sampleRate * historySeconds / historyColumns;
+
+    for (int side = 0; side < LevelFeed::numSides; ++side)
+        column[side] = column[side].getUnionWith (levels.delay[side]);
+
+    columnSamples += levels.numSamples;
+
+    while (columnSamples >= samplesPerColumn)
+    {
+        for (int side = 0; side < LevelFeed::numSides; ++side)
+            history[historyPosition][side] = column[side];
+
+        historyPosition = (historyPosition + 1) % historyColumns;
+        columnSamples -= samplesPerColumn;
+
+        for (int side = 0; side < LevelFeed::numSides; ++side)
+            column[side] = columnSamples > 0.0 ? levels.delay[side] : Range<float>();
+    }
+}
+
+//==============================================================================
+
+void LevelDisplay::paint (Graphics& g)
+{
+    g.fillAll (Colours::black);
+
+    Rectangle<int> area = getLocalBounds();
+    paintMeters (g, area.removeFromLeft (numMeters * meterGroupWidth));
+    area.removeFromLeft (10);
+    paintHistory (g, area);
+}
+
+/*Two bars per meter on a dB scale from meterFloorDecibels to 0 dB, red once a side reaches full scale*/
+void LevelDisplay::paintMeters (Graphics& g, Rectangle<int> area) const
+{
+    const char* const names[numMeters] = { "In", "Delay", "Out" };
+
+    g.setFont (12.0f);
+
+    for (int meter = 0; meter < numMeters; ++meter)
+    {
+        Rectangle<int> group = area.removeFromLeft (meterGroupWidth);
+
+        g.setColour (Colours::white);
+        g.drawText (names[meter], group.removeFromBottom (14), Justification::centred);
+        group.removeFromBottom (2);
+
+        Rectangle<int> bars = group.withSizeKeepingCentre (2 * meterWidth + 2, group.getHeight());
+
+        for (int side = 0; side < LevelFeed::numSides; ++side)
+        {
+            const Rectangle<int> bar = bars.removeFromLeft (meterWidth);
+            bars.removeFromLeft (2);
+
+            const float peak = meterPeaks[meter][side];
+            const float decibels = Decibels::gainToDecibels (peak, meterFloorDecibels);
+            const int height = roundToInt ((decibels - meterFloorDecibels) / -meterFloorDecibels * bar.getHeight());
+
+            g.setColour (Colours::darkgrey);
+            g.fillRect (bar);
+            g.setColour (peak >= 1.0f ? Colours::red : Colours::hotpink);
+            g.fillRect (bar.withTop (bar.getBottom() - height));
+        }
+    }
+}
+
+/*The oldest column on the left. Every column is a line from the lowest to the highest sample written in its time.*/
+void LevelDisplay::paintHistory (Graphics& g, Rectangle<int> area) const
+{
+    const float columnWidth = (float)area.getWidth() / (float)historyColumns;
+    const int laneHeight = area.getHeight() / LevelFeed::numSides;
+    const char* const names[LevelFeed::numSides] = { "L", "R" };
+
+    for (int side = 0; side < LevelFeed::numSides; ++side)
+    {
+        const Rectangle<int> lane = area.withTop (area.getY() + side * laneHeight).withHeight (laneHeight);
+        const float centre = (float)lane.getCentreY();
+        const float halfHeight = 0.5f * (float)(lane.getHeight() - 2);
+
+        g.setColour (Colours::darkgrey.darker());
+        g.fillRect (lane.reduced (0, 1));
+
+        g.setColour (side == 0 ? Colours::hotpink : Colours::deepskyblue);
+
+        for (int i = 0; i < historyColumns; ++i)
+        {
+            const Range<float> levels = history[(historyPosition + i) % historyColumns][side];
+            const float top = centre - jlimit (-1.0f, 1.0f, levels.getEnd()) * halfHeight;
+            const float bottom = centre - jlimit (-1.0f, 1.0f, levels.getStart()) * halfHeight;
+
+            g.fillRect (Rectangle<float> ((float)area.getX() + i * columnWidth, top, jmax (1.0f, columnWidth), jmax (1.0f, bottom - top)));
+        }
+
+        g.setColour (Colours::white);
+        g.drawText (names[side], lane.reduced (4, 2), Justification::topLeft);
+    }
+}
@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Meters and the bounce display at the bottom of the editor.
+
+     Left: peak meters for the left and right input, delay line and output. Right: the last few seconds of what was
+     written into the delay line, the left side in the upper lane and the right side in the lower one, so every
+     echo shows up on the other side one delay time after the one before.
+
+     Everything comes from the processor's LevelFeed. A timer empties it at a fixed frame rate and repaints this
+     component once per frame, however many blocks arrived in between.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LevelFeed.h"
+
+//==============================================================================
+
+class LevelDisplay : public Component, private Timer
+{
+public:
+    /*The processor is only asked for its sample rate, to turn block lengths into time*/
+    LevelDisplay (LevelFeed& feedToShow, const AudioProcessor& processorToShow);
+    ~LevelDisplay();
+
+    void paint (Graphics&) override;
+
+private:
+    void timerCallback() override;
+    void addBlock (const LevelFeed::BlockLevels& levels);
+    void paintMeters (Graphics& g, Rectangle<int> area) const;
+    void paintHistory (Graphics& g, Rectangle<int> area) const;
+
+    enum
+    {
+        framesPerSecond = 30,
+        historyColumns = 400,
+        meterWidth = 10,
+        meterGroupWidth = 40
+    };
+
+    static constexpr double historySeconds = 4.0;
+    static constexpr float meterFloorDecibels = -60.0f;
+    static constexpr float meterFallDecibelsPerSecond = 24.0f;
+
+    LevelFeed& feed;
+    const AudioProcessor& processor;
+
+    /*Peak of the input, delay line and output per side, falling off between blocks like a meter's needle*/
+    enum { meterInput, meterDelay, meterOutput, numMeters };
+    float meterPeaks[numMeters][LevelFeed::numSides] = {};
+
+    /*One column per historySeconds / historyColumns of delay line levels, a ring with the newest at historyPosition - 1*/
+    Range<float> history[historyColumns][LevelFeed::numSides];
+    int historyPosition = 0;
+
+    /*The column being filled and how many samples are in it so far*/
+    Range<float> column[LevelFeed::numSides];
+    double columnSamples = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE (LevelDisplay)
+};
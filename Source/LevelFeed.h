@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Levels the audio thread hands over to the editor's meters and bounce display.
+
+     Per block the processor records the lowest and highest sample of the left and right input, of what it wrote
+     into the delay line and of the output, and pushes that summary into a single-producer single-consumer ring
+     (JUCE's AbstractFifo over a fixed array). Pushing never waits and never allocates: when the ring is full the
+     summary is dropped. The editor drains the ring from a timer at its own frame rate, so however small the host's
+     blocks are there is one repaint per frame, and the audio thread never touches a component.
+
+     The processor only measures while an editor is reading (setReading), with the editor closed the feed costs one
+     atomic load per block.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+
+class LevelFeed
+{
+public:
+    /*Left and right. Mono uses its one channel for both sides, layouts with more channels show their first pair.*/
+    enum { numSides = 2 };
+
+    /*Lowest and highest sample of one block (start is the minimum, end the maximum)*/
+    struct BlockLevels
+    {
+        Range<float> input[numSides];
+        Range<float> delay[numSides];
+        Range<float> output[numSides];
+        int numSamples = 0;
+    };
+
+    /*Message thread. The editor switches the feed on while it is open.*/
+    void setReading (bool shouldRead) noexcept { reading.store (shouldRead, std::memory_order_relaxed); }
+
+    /*Audio thread, once per block*/
+    bool isReading() const noexcept { return reading.load (std::memory_order_relaxed); }
+
+    /*Audio thread. A full ring drops the summary rather than wait for the reader.*/
+    void push (const BlockLevels& levels) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            return;
+
+        ring[size1 > 0 ? start1 : start2] = levels;
+        fifo.finishedWrite (1);
+    }
+
+    /*Message thread. Hands every waiting summary to the callback, oldest first, and returns how many there were.*/
+    template <typename Callback>
+    int pull (Callback&& callback)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)
+            callback (ring[start1 + i]);
+
+        for (int i = 0; i < size2; ++i)
+            callback (ring[start2 + i]);
+
+        fifo.finishedRead (size1 + size2);
+        return size1 + size2;
+    }
+
+    /*Widens level to the lowest and highest of numSamples samples*/
+    template <typename SampleType>
+    static void addLevel (Range<float>& level, const SampleType* data, int numSamples)
+    {
+        if (numSamples <= 0)
+            return;
+
+        const Range<SampleType> range = FloatVectorOperations::findMinAndMax (data, numSamples);
+        level = level.getUnionWith (Range<float> ((float)range.getStart(), (float)range.getEnd()));
+    }
+
+    /*The same for both sides of a block: levels[0] from channel 0, levels[1] from channel 1 (or channel 0 again for mono)*/
+    template <typename SampleType>
+    static void addLevels (Range<float>* levels, const SampleType* const* channelData, int numChannels, int numSamples)
+    {
+        if (numChannels > 0)
+            for (int side = 0; side < numSides; ++side)
+                addLevel (levels[side], channelData[jmin (side, numChannels - 1)], numSamples);
+    }
+
+private:
+    /*Over a second of 64 sample blocks at 48 kHz, far more than one frame of the editor*/
+    enum { ringSize = 1024 };
+
+    AbstractFifo fifo { ringSize };
+    BlockLevels ring[ringSize];
+    std::atomic<bool> reading { false };
+};
@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     What the MIDI input does to the delay.
+
+     A held note sets the delay time to one period of its pitch, so the echoes turn into a comb filter tuned to the
+     note (the last note played wins, and releasing it goes back to the Delay time parameter). Controller 12 sets the
+     feedback and controller 13 the mix (the two "effect control" controllers), over the whole range of each
+     parameter. A controller keeps its value until the parameter itself is moved by the host or the editor.
+
+     processBlock cuts the block at every MIDI event and hands the event to handleMessage in between, so a change
+     starts at the exact sample of the event. Everything here runs on the audio thread only.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+
+class MidiControl
+{
+public:
+    enum
+    {
+        feedbackController = 12,
+        mixController = 13
+    };
+
+    /*Forgets the held note and the controller values*/
+    void reset()
+    {
+        note = -1;
+        feedback = Control();
+        mix = Control();
+    }
+
+    /*Returns true if the message changed anything the delay uses*/
+    bool handleMessage (const MidiMessage& message)
+    {
+        if (message.isNoteOn())
+        {
+            note = message.getNoteNumber();
+            return true;
+        }
+
+        if (message.isNoteOff())
+        {
+            if (message.getNoteNumber() != note)
+                return false;
+
+            note = -1;
+            return true;
+        }
+
+        if (message.isAllNotesOff() || message.isAllSoundOff())
+        {
+            note = -1;
+            return true;
+        }
+
+        if (message.isController())
+        {
+            const float value = (float)message.getControllerValue() / 127.0f;
+
+            switch (message.getControllerNumber())
+            {
+                case feedbackController: feedback.normalised = value; return true;
+                case mixController:      mix.normalised = value; return true;
+                default:                 return false;
+            }
+        }
+
+        return false;
+    }
+
+    /*Delay time in seconds: the period of the held note, or the parameter's when no note is held*/
+    float getDelayTime (float parameterDelayTime) const
+    {
+        return note >= 0 ? (float)(1.0 / MidiMessage::getMidiNoteInHertz (note)) : parameterDelayTime;
+    }
+
+    float getFeedback (float parameterValue, float minimum, float maximum) { return getValue (feedback, parameterValue, minimum, maximum); }
+    float getMix (float parameterValue, float minimum, float maximum) { return getValue (mix, parameterValue, minimum, maximum); }
+
+private:
+    /*The last controller value (0 to 1, or -1 before the controller has been used) and the parameter value it
+    was set against. Once the parameter moves the controller lets go.*/
+    struct Control
+    {
+        float normalised = -1.0f;
+        float parameterValue = 0.0f;
+    };
+
+    static float getValue (Control& control, float parameterValue, float minimum, float maximum)
+    {
+        if (parameterValue != control.parameterValue)
+        {
+            control.parameterValue = parameterValue;
+            control.normalised = -1.0f;
+        }
+
+        return control.normalised >= 0.0f ? minimum + control.normalised * (maximum - minimum) : parameterValue;
+    }
+
+    int note = -1;
+    Control feedback;
+    Control mix;
+};
@@ -0,0 +1,752 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     The crossovers and the bands' loops of the multiband mode, see MultibandDelay.h.
+
+  ==============================================================================
+*/
+
+#include "MultibandDelay.h"
+
+#if JUCE_INTEL && (defined (__SSE2__) || defined (_M_X64) || defined (_M_AMD64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2))
+ #define PINGPONG_USE_SSE2 1
+ #include <immintrin.h>
+#endif
+
+#if JUCE_ARM && (defined (__ARM_NEON) || defined (__ARM_NEON__))
+ #define PINGPONG_USE_NEON 1
+ #include <arm_neon.h>
+#endif
+
+//==============================================================================
+
+namespace
+{
+    /*Longest delay of a band, the range of the band time parameters*/
+    const double maximumDelaySeconds = 5.0;
+
+    /*The plugin's smoothing times, see PingPongDelayAudioProcessor::prepareRamps*/
+    const double smoothTime = 1e-3;
+    const double delaySmoothTime = 50e-3;
+
+    /*Samples the crossovers filter before they are handed over to the bands' buffers*/
+    enum { chunkLength = 64 };
+
+    /*The filtered samples of one chunk of every channel, the bands of a sample next to each other*/
+    using FilteredChunk = float[DelayKernels::maxChannels][chunkLength][MultibandDelay::maxBands];
+
+    struct Biquad
+    {
+        double b0, b1, b2, a1, a2;
+    };
+
+    const Biquad identity { 1.0, 0.0, 0.0, 0.0, 0.0 };
+
+    /*RBJ cookbook lowpass or highpass with a Q of 1 / sqrt (2), like the damping of the feedback chain. Two of them
+    in a row are one side of a Linkwitz-Riley crossover. The frequency is kept below 0.45 times the sample rate.*/
+    Biquad getButterworth (double frequency, double sampleRate, bool highpass)
+    {
+        const double k = std::tan (MathConstants<double>::pi * jmin (frequency, 0.45 * sampleRate) / sampleRate);
+        const double q = std::sqrt (2.0);
+        const double norm = 1.0 / (1.0 + q * k + k * k);
+        const double b0 = highpass ? norm : k * k * norm;
+
+        return { b0, highpass ? -2.0 * b0 : 2.0 * b0, b0, 2.0 * (k * k - 1.0) * norm, (1.0 - q * k + k * k) * norm };
+    }
+
+    /*Lowpass plus highpass of a Linkwitz-Riley crossover: the squared Butterworth poles over themselves mirrored,
+    which leaves one biquad with the Butterworth's poles and its numerator reversed*/
+    Biquad getAllpass (double frequency, double sampleRate)
+    {
+        const Biquad lowpass = getButterworth (frequency, sampleRate, false);
+        return { lowpass.a2, lowpass.a1, 1.0, lowpass.a1, lowpass.a2 };
+    }
+
+    void setLane (MultibandDelay::Section& section, int lane, const Biquad& biquad)
+    {
+        section.b0[lane] = (float)biquad.b0;
+        section.b1[lane] = (float)biquad.b1;
+        section.b2[lane] = (float)biquad.b2;
+        section.a1[lane] = (float)biquad.a1;
+        section.a2[lane] = (float)biquad.a2;
+    }
+
+    //==============================================================================
+
+    template <typename SampleType>
+    using FilterKernel = void (*) (const MultibandDelay::Section*, MultibandDelay::SectionState (*)[MultibandDelay::maxSections],
+                                   const SampleType* const*, int, int, FilteredChunk&);
+
+    /*One float per band, with the same interface in every instruction set (see MultibandFilterLoops.h). No fused
+    multiply-add, like the delay kernels, so every version gives the same output.*/
+    static_assert (MultibandDelay::maxBands == 4, "one band per lane of a four float vector");
+
+   #if PINGPONG_USE_SSE2
+    namespace SSE2
+    {
+        struct Lanes
+        {
+            using V = __m128;
+            enum { channels = 1 };
+
+            static V loadBands (const float* p)                         { return _mm_load_ps (p); }
+            static V loadChannels (const float* p, const float*)        { return _mm_load_ps (p); }
+            static void storeChannels (float* p, float*, V v)           { _mm_store_ps (p, v); }
+            static V setChannels (float v, float)                       { return _mm_set1_ps (v); }
+            static V add (V a, V b)                                     { return _mm_add_ps (a, b); }
+            static V sub (V a, V b)                                     { return _mm_sub_ps (a, b); }
+            static V mul (V a, V b)                                     { return _mm_mul_ps (a, b); }
+            static void finish()                                        {}
+        };
+
+        #include "MultibandFilterLoops.h"
+    }
+
+    // compiled for AVX2 like the AVX2 delay kernels, see DelayKernels.cpp
+   #if JUCE_CLANG
+    #pragma clang attribute push (__attribute__ ((target ("avx2"))), apply_to = function)
+   #elif JUCE_GCC
+    #pragma GCC push_options
+    #pragma GCC target ("avx2")
+   #endif
+
+    namespace AVX2
+    {
+        /*The bands of two channels, the first channel in the lower half. With twice the lanes of SSE2 the chains
+        of a stereo pair cost one set of instructions.*/
+        struct Lanes
+        {
+            using V = __m256;
+            enum { channels = 2 };
+
+            static V loadBands (const float* p)                         { return _mm256_broadcast_ps ((const __m128*)p); }
+            static V loadChannels (const float* p, const float* q)      { return _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm_load_ps (p)), _mm_load_ps (q), 1); }
+            static V setChannels (float v, float w)                     { return _mm256_setr_ps (v, v, v, v, w, w, w, w); }
+            static V add (V a, V b)                                     { return _mm256_add_ps (a, b); }
+            static V sub (V a, V b)                                     { return _mm256_sub_ps (a, b); }
+            static V mul (V a, V b)                                     { return _mm256_mul_ps (a, b); }
+
+            static void storeChannels (float* p, float* q, V v)
+            {
+                _mm_store_ps (p, _mm256_castps256_ps128 (v));
+                _mm_store_ps (q, _mm256_extractf128_ps (v, 1));
+            }
+
+            static void finish()                                        { _mm256_zeroupper(); }
+        };
+
+        #include "MultibandFilterLoops.h"
+    }
+
+   #if JUCE_CLANG
+    #pragma clang attribute pop
+   #elif JUCE_GCC
+    #pragma GCC pop_options
+   #endif
+
+   #elif PINGPONG_USE_NEON
+    namespace Neon
+    {
+        struct Lanes
+        {
+            using V = float32x4_t;
+            enum { channels = 1 };
+
+            static V loadBands (const float* p)                         { return vld1q_f32 (p); }
+            static V loadChannels (const float* p, const float*)        { return vld1q_f32 (p); }
+            static void storeChannels (float* p, float*, V v)           { vst1q_f32 (p, v); }
+            static V setChannels (float v, float)                       { return vdupq_n_f32 (v); }
+            static V add (V a, V b)                                     { return vaddq_f32 (a, b); }
+            static V sub (V a, V b)                                     { return vsubq_f32 (a, b); }
+            static V mul (V a, V b)                                     { return vmulq_f32 (a, b); }
+            static void finish()                                        {}
+        };
+
+        #include "MultibandFilterLoops.h"
+    }
+   #else
+    namespace Scalar
+    {
+        struct Lanes
+        {
+            struct V { float lane[4]; };
+            enum { channels = 1 };
+
+            static V loadBands (const float* p)                         { return { { p[0], p[1], p[2], p[3] } }; }
+            static V loadChannels (const float* p, const float*)        { return loadBands (p); }
+            static void storeChannels (float* p, float*, V v)           { std::copy (v.lane, v.lane + 4, p); }
+            static V setChannels (float v, float)                       { return { { v, v, v, v } }; }
+            static V add (V a, V b)                                     { return { { a.lane[0] + b.lane[0], a.lane[1] + b.lane[1], a.lane[2] + b.lane[2], a.lane[3] + b.lane[3] } }; }
+            static V sub (V a, V b)                                     { return { { a.lane[0] - b.lane[0], a.lane[1] - b.lane[1], a.lane[2] - b.lane[2], a.lane[3] - b.lane[3] } }; }
+            static V mul (V a, V b)                                     { return { { a.lane[0] * b.lane[0], a.lane[1] * b.lane[1], a.lane[2] * b.lane[2], a.lane[3] * b.lane[3] } }; }
+            static void finish()                                        {}
+        };
+
+        #include "MultibandFilterLoops.h"
+    }
+   #endif
+
+    template <typename SampleType>
+    FilterKernel<SampleType> getFilterKernel (int numChannels, int numSections)
+    {
+       #if PINGPONG_USE_SSE2
+        static const bool useAVX2 = SystemStats::hasAVX2();
+        return useAVX2 ? AVX2::getFilterKernel<SampleType> (numChannels, numSections) : SSE2::getFilterKernel<SampleType> (numChannels, numSections);
+       #elif PINGPONG_USE_NEON
+        return Neon::getFilterKernel<SampleType> (numChannels, numSections);
+       #else
+        return Scalar::getFilterKernel<SampleType> (numChannels, numSections);
+       #endif
+    }
+}
+
+//==============================================================================
+
+void MultibandDelay::prepare (double newSampleRate, const DelayKernels::LoopLayout& layout, int maximumBlockSize, bool newDoublePrecision)
+{
+    const int numLineChannels = maxBands * jlimit (1, (int)DelayKernels::maxChannels, layout.numChannels);
+    const bool keepEchoes = sampleRate > 0.0 && line.getNumChannels() == numLineChannels;
+
+    numChannels = numLineChannels / maxBands;
+    std::copy (layout.sides, layout.sides + numChannels, sides);
+    doublePrecision = newDoublePrecision;
+    capacity = keepEchoes ? jmax (capacity, maximumBlockSize) : maximumBlockSize;
+
+    // every band's input and echoes, the echoes of all bands and the middle of a band
+    const int numBuffers = (maxBands + 1) * numChannels + 1;
+    bandBuffers.setSize (doublePrecision ? 0 : numBuffers, capacity, false, false, true);
+    bandBuffersDouble.setSize (doublePrecision ? numBuffers : 0, capacity, false, false, true);
+    ones.allocate ((size_t)capacity, false);
+    FloatVectorOperations::fill (ones.get(), 1.0f, capacity);
+
+    // a line that was waiting to be swapped in has the old rate or format
+    resizer.discardReadyLine();
+
+    if (keepEchoes && newSampleRate == sampleRate)
+    {
+        for (int band = 0; band < maxBands; ++band)
+        {
+            delayRamps[band].setMaximumBlockSize (capacity);
+            feedbackRamps[band].setMaximumBlockSize (capacity);
+            widthRamps[band].setMaximumBlockSize (capacity);
+        }
+
+        if (line.getFormat() != getFormat())
+        {
+            DelayLine converted;
+            converted.setSize (numLineChannels, line.getLength(), getFormat());
+            converted.copyHistoryFrom (line);
+            line.swapWith (converted);
+        }
+
+        return;
+    }
+
+    for (int band = 0; band < maxBands; ++band)
+    {
+        delayRamps[band].prepare (newSampleRate, delaySmoothTime, capacity);
+        feedbackRamps[band].prepare (newSampleRate, smoothTime, capacity);
+        widthRamps[band].prepare (newSampleRate, smoothTime, capacity);
+    }
+
+    if (keepEchoes)
+    {
+        // the bands keep their delays in seconds
+        const double ratio = newSampleRate / sampleRate;
+
+        DelayLine resampled;
+        resampled.setSize (numLineChannels, DelayLine::getLengthForDelay ((double)(line.getLength() - DelayLine::guardSamples) * ratio), getFormat());
+        resampled.resampleHistoryFrom (line, ratio);
+        line.swapWith (resampled);
+
+        for (auto& ramp : delayRamps)
+            ramp.setCurrentAndTargetValue ((float)(ramp.getTargetValue() * ratio));
+    }
+    else
+    {
+        line.setSize (numLineChannels, DelayLine::getLengthForDelay (1.0), getFormat());
+        numBands = 0;
+    }
+
+    sampleRate = newSampleRate;
+
+    // the filters' memories belong to the old sample grid
+    for (auto& channelStates : states)
+        for (auto& state : channelStates)
+            state = SectionState();
+
+    for (auto& bandStates : allpassStates)
+        std::fill (std::begin (bandStates), std::end (bandStates), 0.0);
+
+    updateCoefficients();
+}
+
+void MultibandDelay::release()
+{
+    resizer.discardReadyLine();
+    line.release();
+    bandBuffers.setSize (0, 0);
+    bandBuffersDouble.setSize (0, 0);
+    ones.free();
+
+    for (int band = 0; band < maxBands; ++band)
+    {
+        delayRamps[band].release();
+        feedbackRamps[band].release();
+        widthRamps[band].release();
+    }
+
+    capacity = 0;
+    numBands = 0;
+    sampleRate = 0.0;
+}
+
+size_t MultibandDelay::getSizeInBytes() const
+{
+    return line.getSizeInBytes()
+         + (size_t)bandBuffers.getNumChannels() * (size_t)bandBuffers.getNumSamples() * sizeof (float)
+         + (size_t)bandBuffersDouble.getNumChannels() * (size_t)bandBuffersDouble.getNumSamples() * sizeof (double)
+         + (size_t)capacity * sizeof (float) * (3 * maxBands + 1);
+}
+
+//==============================================================================
+
+bool MultibandDelay::setSettings (const Settings& newSettings, InterpolationType newInterpolation, bool nonRealtime)
+{
+    settings = newSettings;
+
+    // like the plugin's read head: an interpolator that reads further ahead can raise the shortest delay
+    if (newInterpolation != interpolation)
+    {
+        interpolation = newInterpolation;
+        const float minimumDelay = (float)(getInterpolationTapsAhead (interpolation) + 1);
+
+        for (int band = 0; band < maxBands; ++band)
+        {
+            std::fill (std::begin (allpassStates[band]), std::end (allpassStates[band]), 0.0);
+
+            if (delayRamps[band].getCurrentValue() < minimumDelay)
+                delayRamps[band].setCurrentAndTargetValue (minimumDelay);
+        }
+    }
+
+    const int wantedBands = settings.numBands > 0 ? jlimit (2, (int)maxBands, settings.numBands) : 0;
+    const bool resized = updateLineSize (wantedBands, nonRealtime);
+
+    // more bands only come in once the line holds their delays, fewer go at once
+    const int previousBands = numBands;
+
+    if (wantedBands <= numBands || line.getLength() >= getNeededLength (wantedBands))
+        numBands = wantedBands;
+
+    float sortedCrossovers[maxBands - 1];
+
+    for (int crossover = 0; crossover < maxBands - 1; ++crossover)
+        sortedCrossovers[crossover] = jmax (settings.crossovers[crossover], crossover > 0 ? sortedCrossovers[crossover - 1] : 0.0f);
+
+    if (numBands != previousBands || ! std::equal (std::begin (sortedCrossovers), std::end (sortedCrossovers), std::begin (crossovers)))
+    {
+        std::copy (std::begin (sortedCrossovers), std::end (sortedCrossovers), std::begin (crossovers));
+        updateCoefficients();
+    }
+
+    const float minimumDelay = (float)(getInterpolationTapsAhead (interpolation) + 1);
+    const float maximumDelay = (float)(line.getLength() - DelayLine::guardSamples);
+
+    for (int band = 0; band < maxBands; ++band)
+    {
+        delayRamps[band].setTargetValue (jlimit (minimumDelay, jmax (minimumDelay, maximumDelay), settings.bands[band].delayTime * (float)sampleRate));
+        feedbackRamps[band].setTargetValue (jlimit (0.0f, 0.99f, settings.bands[band].feedback));
+        widthRamps[band].setTargetValue (jlimit (0.0f, 1.0f, settings.bands[band].width));
+    }
+
+    for (int band = previousBands; band < numBands; ++band)
+        clearBand (band);
+
+    return resized;
+}
+
+void MultibandDelay::jumpToTargets()
+{
+    for (int band = 0; band < maxBands; ++band)
+    {
+        delayRamps[band].setCurrentAndTargetValue (delayRamps[band].getTargetValue());
+        feedbackRamps[band].setCurrentAndTargetValue (feedbackRamps[band].getTargetValue());
+        widthRamps[band].setCurrentAndTargetValue (widthRamps[band].getTargetValue());
+        std::fill (std::begin (allpassStates[band]), std::end (allpassStates[band]), 0.0);
+    }
+
+    for (auto& channelStates : states)
+        for (auto& state : channelStates)
+            state = SectionState();
+}
+
+int MultibandDelay::getRemainingRampSamples() const
+{
+    int remaining = 0;
+
+    for (int band = 0; band < numBands; ++band)
+        remaining = jmax (remaining, feedbackRamps[band].getRemainingSamples(), widthRamps[band].getRemainingSamples());
+
+    return remaining;
+}
+
+float MultibandDelay::getLongestDelay() const
+{
+    float longest = 0.0f;
+
+    for (int band = 0; band < numBands; ++band)
+        longest = jmax (longest, delayRamps[band].getCurrentValue(), delayRamps[band].getTargetValue());
+
+    return longest;
+}
+
+float MultibandDelay::getHighestFeedback() const
+{
+    float highest = 0.0f;
+
+    for (int band = 0; band < numBands; ++band)
+        highest = jmax (highest, feedbackRamps[band].getCurrentValue(), feedbackRamps[band].getTargetValue());
+
+    return highest;
+}
+
+//==============================================================================
+
+/*Band k's chain: the highpasses of the crossovers below it, its own lowpass, the allpasses of the crossovers
+above. Each crossover takes two sections of every chain, an allpass fills the second with a biquad that passes
+its input on. Lanes of bands that aren't in use pass their input on too.*/
+void MultibandDelay::updateCoefficients()
+{
+    const int numCrossovers = jmax (0, numBands - 1);
+    numSections = 2 * numCrossovers;
+
+    for (int crossover = 0; crossover < numCrossovers; ++crossover)
+    {
+        const double frequency = jmax (20.0, (double)crossovers[crossover]);
+        const Biquad lowpass = getButterworth (frequency, sampleRate, false);
+        const Biquad highpass = getButterworth (frequency, sampleRate, true);
+        const Biquad allpass = getAllpass (frequency, sampleRate);
+
+        for (int band = 0; band < maxBands; ++band)
+        {
+            Section& first = sections[2 * crossover];
+            Section& second = sections[2 * crossover + 1];
+
+            if (band >= numBands)
+            {
+                setLane (first, band, identity);
+                setLane (second, band, identity);
+            }
+            else if (crossover < band)
+            {
+                setLane (first, band, highpass);
+                setLane (second, band, highpass);
+            }
+            else if (crossover == band)
+            {
+                setLane (first, band, lowpass);
+                setLane (second, band, lowpass);
+            }
+            else
+            {
+                setLane (first, band, allpass);
+                setLane (second, band, identity);
+            }
+        }
+    }
+}
+
+/*Ring length for the delays of the first numBandsToFit bands, with the bands in use held at their current delays
+too. Never more than the longest band delay allows.*/
+int MultibandDelay::getNeededLength (int numBandsToFit) const
+{
+    double longest = 1.0;
+
+    for (int band = 0; band < numBandsToFit; ++band)
+    {
+        longest = jmax (longest, (double)settings.bands[band].delayTime * sampleRate);
+
+        if (band < numBands)
+            longest = jmax (longest, (double)delayRamps[band].getCurrentValue());
+    }
+
+    return DelayLine::getLengthForDelay (jmin (longest, maximumDelaySeconds * sampleRate + 1.0));
+}
+
+/*PingPongDelayAudioProcessor::updateDelayLineSize for the bands' line: it grows as soon as the bands need more and
+shrinks once they need a quarter or less, with the new memory allocated on the resizer's thread. Returns true when
+another line was swapped in.*/
+bool MultibandDelay::updateLineSize (int wantedBands, bool nonRealtime)
+{
+    const int numLineChannels = maxBands * numChannels;
+    const int neededLength = getNeededLength (wantedBands);
+    bool swapped = false;
+
+    if (DelayLine* resized = resizer.takeReadyLine())
+    {
+        if (resized->getNumChannels() == numLineChannels && resized->getFormat() == getFormat() && resized->getLength() >= neededLength)
+        {
+            resized->copyHistoryFrom (line);
+            line.swapWith (*resized);
+            swapped = true;
+        }
+
+        resizer.retire (resized);
+    }
+
+    const int length = line.getLength();
+    const int wantedLength = neededLength > length ? neededLength
+                           : neededLength * 4 <= length ? neededLength * 2
+                           : length;
+
+    if (wantedLength == length)
+        return swapped;
+
+    if (nonRealtime)
+    {
+        DelayLine resized;
+        resized.setSize (numLineChannels, wantedLength, getFormat());
+        resized.copyHistoryFrom (line);
+        line.swapWith (resized);
+        return true;
+    }
+
+    resizer.requestLength (numLineChannels, wantedLength, getFormat());
+    return swapped;
+}
+
+/*A band that comes into use starts from silence, at the values its parameters ask for. Whatever its line still
+holds is left from the last time it was in use, possibly long ago.*/
+void MultibandDelay::clearBand (int band)
+{
+    const int bytesPerSample = DelayStorage::getBytesPerSample (line.getFormat());
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        char* channelStart = (char*)line.getChannelData (getLineChannel (band, channel)) - DelayLine::guardSamples * bytesPerSample;
+        std::memset (channelStart, 0, (size_t)(DelayLine::guardSamples + line.getLength()) * (size_t)bytesPerSample);
+    }
+
+    delayRamps[band].setCurrentAndTargetValue (delayRamps[band].getTargetValue());
+    feedbackRamps[band].setCurrentAndTargetValue (feedbackRamps[band].getTargetValue());
+    widthRamps[band].setCurrentAndTargetValue (widthRamps[band].getTargetValue());
+    std::fill (std::begin (allpassStates[band]), std::end (allpassStates[band]), 0.0);
+}
+
+//==============================================================================
+
+/*Filters the input into the bands a chunk at a time, runs every band's loop over the whole piece, then adds up the
+echoes with their widths and mixes them with the dry input the way the delay kernels do (the balance weights the
+sides of the input, the mix goes from it to the echoes).*/
+template <typename SampleType>
+void MultibandDelay::process (SampleType* const* channelData, int numSamples, const float* balance, const float* mix, bool ramped)
+{
+    jassert (numSamples <= capacity && numBands > 0);
+
+    AudioBuffer<SampleType>& buffers = getBuffers ((SampleType*)nullptr);
+    SampleType* const* bandData = buffers.getArrayOfWritePointers();
+    SampleType* const* echoes = bandData + maxBands * numChannels;
+    SampleType* middle = echoes[numChannels];
+
+    const FilterKernel<SampleType> filter = getFilterKernel<SampleType> (numChannels, numSections);
+    alignas (16) FilteredChunk filtered;
+
+    for (int chunkStart = 0; chunkStart < numSamples; chunkStart += chunkLength)
+    {
+        const int chunkSamples = jmin ((int)chunkLength, numSamples - chunkStart);
+        filter (sections, states, channelData, chunkStart, chunkSamples, filtered);
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                SampleType* destination = bandData[getLineChannel (band, channel)] + chunkStart;
+
+                for (int sample = 0; sample < chunkSamples; ++sample)
+                    destination[sample] = (SampleType)filtered[channel][sample][band];
+            }
+        }
+    }
+
+    for (int band = 0; band < numBands; ++band)
+        processBand<SampleType> (band, numSamples, balance, ramped);
+
+    line.writePosition = (line.writePosition + numSamples) & line.getMask();
+
+    /*Each band's echoes are pulled towards their middle (the mean of the loop's channels, so never the LFE) by its
+    width: 1 keeps the ping-pong, 0 puts them all in the middle. So every channel gets width times its own echoes,
+    and the middle buffer collects (1 - width) times the mean of every band for all channels at once.*/
+    for (int channel = 0; channel < numChannels; ++channel)
+        FloatVectorOperations::clear (echoes[channel], numSamples);
+
+    FloatVectorOperations::clear (middle, numSamples);
+
+    for (int band = 0; band < numBands; ++band)
+    {
+        SampleType* const* bandEchoes = bandData + getLineChannel (band, 0);
+
+        // a single channel has no sides to narrow
+        if (numChannels == 1)
+        {
+            widthRamps[band].setCurrentAndTargetValue (widthRamps[band].getTargetValue());
+            FloatVectorOperations::add (echoes[0], bandEchoes[0], numSamples);
+            continue;
+        }
+
+        if (widthRamps[band].isSmoothing())
+        {
+            const float* width = widthRamps[band].fillRamp (numSamples);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                for (int sample = 0; sample < numSamples; ++sample)
+                {
+                    const SampleType toMiddle = (SampleType (1) - (SampleType)width[sample]) / (SampleType)numChannels;
+                    echoes[channel][sample] += bandEchoes[channel][sample] * (SampleType)width[sample];
+                    middle[sample] += bandEchoes[channel][sample] * toMiddle;
+                }
+            }
+
+            continue;
+        }
+
+        const SampleType width = (SampleType)widthRamps[band].getCurrentValue();
+        const SampleType toMiddle = (SampleType (1) - width) / (SampleType)numChannels;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            FloatVectorOperations::addWithMultiply (echoes[channel], bandEchoes[channel], width, numSamples);
+
+            if (toMiddle != SampleType (0))
+                FloatVectorOperations::addWithMultiply (middle, bandEchoes[channel], toMiddle, numSamples);
+        }
+    }
+
+    /*The input as the kernels weight it (1 - balance on the left, balance on the right, all of it in the centre),
+    and the mix from it to the echoes. Both ways round the same, so where a piece ends doesn't change the output.*/
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        SampleType* io = channelData[channel];
+        SampleType* wet = echoes[channel];
+        const DelayKernels::Side side = sides[channel];
+
+        if (numChannels > 1)
+            FloatVectorOperations::add (wet, middle, numSamples);
+
+        if (ramped)
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                const SampleType gain = DelayKernels::getInputGain (side, (SampleType)balance[sample]);
+                const SampleType in = gain * io[sample];
+                io[sample] = in + (SampleType)mix[sample] * (wet[sample] - in);
+            }
+        }
+        else
+        {
+            const SampleType gain = DelayKernels::getInputGain (side, (SampleType)balance[0]);
+            FloatVectorOperations::multiply (io, gain, numSamples);
+            FloatVectorOperations::subtract (wet, io, numSamples);
+            FloatVectorOperations::addWithMultiply (io, wet, (SampleType)mix[0], numSamples);
+        }
+    }
+}
+
+/*PingPongDelayAudioProcessor::processSubBlock for the channels of one band of the line, with the mix at 1 so the
+loop leaves only its echoes. Its line is always in the processing precision, so it needs no scratch.*/
+template <typename SampleType>
+void MultibandDelay::processBand (int band, int numSamples, const float* balance, bool balanceRamped)
+{
+    AudioBuffer<SampleType>& buffers = getBuffers ((SampleType*)nullptr);
+    const int delayLength = line.getLength();
+    const int delayMask = line.getMask();
+    const int firstChannel = getLineChannel (band, 0);
+    ParameterRamp& delayRamp = delayRamps[band];
+    ParameterRamp& feedbackRamp = feedbackRamps[band];
+
+    int writePosition = line.writePosition;
+
+    if (delayRamp.isSmoothing())
+    {
+        DelayKernels::ModulatedBlock<SampleType> block;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            block.io[channel] = buffers.getWritePointer (firstChannel + channel);
+            block.delay[channel] = line.getChannelData (firstChannel + channel);
+        }
+
+        block.sides = sides;
+        block.writePosition = writePosition;
+        block.mask = delayMask;
+        block.numSamples = numSamples;
+        block.balance = balance;
+        block.delaySamples = delayRamp.fillRamp (numSamples);
+        block.feedback = feedbackRamp.fillRamp (numSamples);
+        block.mix = ones;
+        block.allpassState = allpassStates[band];
+
+        DelayKernels::getModulatedKernel<SampleType> (interpolation, numChannels, getFormat()) (block);
+
+        if (writePosition + numSamples >= delayLength)
+            for (int channel = 0; channel < numChannels; ++channel)
+                line.updateGuard (firstChannel + channel);
+
+        return;
+    }
+
+    const float delay = delayRamp.getCurrentValue();
+    const int delayWhole = (int)delay;
+    const int readDistance = delayWhole - getInterpolationTapsAhead (interpolation);
+
+    const bool ramped = balanceRamped || feedbackRamp.isSmoothing();
+    const float* feedbackValues = ramped ? feedbackRamp.fillRamp (numSamples) : nullptr;
+
+    const DelayKernels::Kernel<SampleType> vectorKernel = DelayKernels::getVectorKernel<SampleType> (interpolation, numChannels);
+    const DelayKernels::Kernel<SampleType> scalarKernel = DelayKernels::getScalarKernel<SampleType> (interpolation, numChannels);
+
+    for (int segmentStart = 0; segmentStart < numSamples;)
+    {
+        const int readPosition = (writePosition - readDistance) & delayMask;
+        const int segmentLength = jmin (numSamples - segmentStart, delayLength - writePosition, delayLength - readPosition);
+
+        DelayKernels::Segment<SampleType> segment;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            SampleType* delayData = line.getWritePointer<SampleType> (firstChannel + channel);
+            segment.io[channel] = buffers.getWritePointer (firstChannel + channel) + segmentStart;
+            segment.read[channel] = delayData + readPosition;
+            segment.write[channel] = delayData + writePosition;
+        }
+
+        segment.sides = sides;
+        segment.numSamples = segmentLength;
+        segment.balance = (SampleType)balance[0];
+        segment.fraction = (SampleType)(delay - (float)delayWhole);
+        segment.feedback = (SampleType)feedbackRamp.getCurrentValue();
+        segment.mix = SampleType (1);
+        segment.balanceRamp = ramped ? balance + segmentStart : nullptr;
+        segment.feedbackRamp = ramped ? feedbackValues + segmentStart : nullptr;
+        segment.mixRamp = ramped ? ones + segmentStart : nullptr;
+        segment.allpassState = allpassStates[band];
+
+        if (readDistance >= segmentLength)
+            vectorKernel (segment);
+        else
+            scalarKernel (segment);
+
+        segmentStart += segmentLength;
+        writePosition = (writePosition + segmentLength) & delayMask;
+
+        if (writePosition == 0)
+            for (int channel = 0; channel < numChannels; ++channel)
+                line.updateGuard (firstChannel + channel);
+    }
+}
+
+template void MultibandDelay::process<float> (float* const*, int, const float*, const float*, bool);
+template void MultibandDelay::process<double> (double* const*, int, const float*, const float*, bool);
@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Multiband mode: the input is split into 2 to 4 bands, and every band goes round a ping-pong loop of its own
+     with its own delay time, feedback and width. With the lows at zero width and the highs at full width the bass
+     echoes stay in the middle while the treble bounces from side to side.
+
+     The bands are split by 24 dB/octave Linkwitz-Riley crossovers (two Butterworth biquads in a row). A band is
+     the lowpass of the crossover above it, after the highpasses of the crossovers below it and the allpasses of
+     the ones above that (an allpass being the lowpass plus the highpass of the same crossover). Every band goes
+     through the same phase shift that way, so the bands add up to the input with a flat response, and every band
+     is a chain of biquads fed by the input itself rather than by another band. So all bands are filtered side by
+     side: the coefficients and the memories of the filters are kept as structure of arrays with one entry per
+     band, and one vector of four floats runs the chains of all bands at once (SSE2 or NEON, plain floats
+     elsewhere, two channels to a vector with AVX2, see MultibandFilterLoops.h). A band that isn't in use rides
+     along in its lane for free.
+
+     Every band's loop is the plugin's own (the segment kernels of DelayKernels.h, with the interpolation the
+     plugin is set to) on a delay line of its own with one channel per band and channel, stored in the processing
+     precision. The line follows the longest band delay while playing, through a DelayLineResizer like the
+     plugin's delay line. Each band's echoes are narrowed towards the middle by its width and summed, and the sum
+     is mixed with the dry input by the plugin's balance and mix. The plugin's delay time and feedback, the taps,
+     the modulation, the feedback chain and the convolution all belong to the single loop and aren't used here.
+
+     The crossovers run in float whatever the precision, the loops in the processing precision. Everything is
+     allocated in prepare (or on the resizer's thread). The other functions are for the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayKernels.h"
+#include "DelayLine.h"
+#include "DelayLineResizer.h"
+#include "ParameterRamp.h"
+
+//==============================================================================
+
+class MultibandDelay
+{
+public:
+    enum { maxBands = 4 };
+
+    /*One band in the units of the parameters*/
+    struct BandSettings
+    {
+        float delayTime = 0.25f;    // s
+        float feedback = 0.5f;
+        float width = 1.0f;         // 0 = every echo in the middle, 1 = the full ping-pong
+    };
+
+    struct Settings
+    {
+        int numBands = 0;                                               // 0 = off, otherwise 2 to maxBands
+        float crossovers[maxBands - 1] = { 250.0f, 2000.0f, 6000.0f };  // Hz, the one above band 1 first
+        BandSettings bands[maxBands];
+    };
+
+    /*Allocates the buffers and the bands' delay line for the loop channels of layout (its sides weight the input
+    like the plugin's loop does). An instance that is already prepared for the same channels keeps its echoes like the plugin's delay line does (see PingPongDelayAudioProcessor::reprepare): a new block
+    size only grows the buffers, a new sample rate resamples the line, a new precision converts it.*/
+    void prepare (double sampleRate, const DelayKernels::LoopLayout& layout, int maximumBlockSize, bool doublePrecision);
+
+    void release();
+    size_t getSizeInBytes() const;
+
+    /*Once per block, with the interpolation of the plugin. More bands only come in once the line can hold their
+    delays (a few milliseconds while playing, straight away when nonRealtime), and a band that comes into use
+    starts from silence. Returns true when the line was resized, which changes the memory in use.*/
+    bool setSettings (const Settings& newSettings, InterpolationType newInterpolation, bool nonRealtime);
+
+    /*The ramps jump to their targets and the filters forget what they had, for the idle path*/
+    void jumpToTargets();
+
+    bool isActive() const { return numBands > 0; }
+
+    /*Samples until the feedback and width ramps of every band have stopped, so the plugin can cut its pieces there
+    like it does for its own ramps (see PingPongDelayAudioProcessor::processRange)*/
+    int getRemainingRampSamples() const;
+
+    /*Longest delay of a band in use in samples, and the highest feedback, for the tail*/
+    float getLongestDelay() const;
+    float getHighestFeedback() const;
+
+    /*Replaces numSamples samples (at most the maximum block size) of every channel with the dry input and the bands'
+    echoes. balance and mix hold the value of every sample, ramped says whether either of them is moving (otherwise
+    only their first values are read).*/
+    template <typename SampleType>
+    void process (SampleType* const* channelData, int numSamples, const float* balance, const float* mix, bool ramped);
+
+    /*The bands' echoes of the last process call summed, one array per channel*/
+    template <typename SampleType>
+    const SampleType* const* getEchoes() const { return getBuffers ((SampleType*)nullptr).getArrayOfReadPointers() + maxBands * numChannels; }
+
+    /*Biquads in the chain of a band: two for each crossover*/
+    enum { maxSections = 2 * (maxBands - 1) };
+
+    /*Coefficients of one biquad of every band's chain, one lane per band*/
+    struct Section
+    {
+        alignas (16) float b0[maxBands];
+        alignas (16) float b1[maxBands];
+        alignas (16) float b2[maxBands];
+        alignas (16) float a1[maxBands];
+        alignas (16) float a2[maxBands];
+    };
+
+    /*Memory of one biquad of every band's chain for one channel (transposed direct form II)*/
+    struct SectionState
+    {
+        alignas (16) float z1[maxBands];
+        alignas (16) float z2[maxBands];
+    };
+
+private:
+    /*Runs the band's loop over its channels of bandBuffers in place, leaving its echoes there*/
+    template <typename SampleType>
+    void processBand (int band, int numSamples, const float* balance, bool balanceRamped);
+
+    void updateCoefficients();
+    int getNeededLength (int numBandsToFit) const;
+    bool updateLineSize (int wantedBands, bool nonRealtime);
+    void clearBand (int band);
+
+    /*Delay line channel of a channel of a band*/
+    int getLineChannel (int band, int channel) const { return band * numChannels + channel; }
+
+    DelayStorage::Format getFormat() const { return doublePrecision ? DelayStorage::Format::float64 : DelayStorage::Format::float32; }
+
+    AudioBuffer<float>& getBuffers (float*) { return bandBuffers; }
+    AudioBuffer<double>& getBuffers (double*) { return bandBuffersDouble; }
+    const AudioBuffer<float>& getBuffers (float*) const { return bandBuffers; }
+    const AudioBuffer<double>& getBuffers (double*) const { return bandBuffersDouble; }
+
+    double sampleRate = 0.0;
+    int numChannels = 2;
+    DelayKernels::Side sides[DelayKernels::maxChannels] = { DelayKernels::Side::left, DelayKernels::Side::right };
+    int capacity = 0;
+    bool doublePrecision = false;
+    InterpolationType interpolation = InterpolationType::linear;
+
+    Settings settings;
+    int numBands = 0;
+    float crossovers[maxBands - 1] = {};
+
+    /*The crossovers, see the top of this file*/
+    Section sections[maxSections];
+    SectionState states[DelayKernels::maxChannels][maxSections];
+    int numSections = 0;
+
+    /*Delay in samples (smoothed like the plugin's delay time), feedback and width of every band*/
+    ParameterRamp delayRamps[maxBands];
+    ParameterRamp feedbackRamps[maxBands];
+    ParameterRamp widthRamps[maxBands];
+    double allpassStates[maxBands][DelayKernels::maxChannels] = {};
+
+    DelayLine line;
+    DelayLineResizer resizer;
+
+    /*numChannels channels for every band (its filtered input, then its echoes), numChannels for the echoes of all
+    bands and one for the middle of a band's echoes. Only the one for the precision in use is allocated.*/
+    AudioBuffer<float> bandBuffers;
+    AudioBuffer<double> bandBuffersDouble;
+
+    /*Ones for the mix of the bands' loops, which only ever send their echoes*/
+    HeapBlock<float> ones;
+};
@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     The crossover filters of the multiband mode, written once for every instruction set.
+
+     MultibandDelay.cpp includes this file once per instruction set, each time inside its own namespace that first
+     defines "Lanes": a vector of one float per band for Lanes::channels channels side by side, with its loads,
+     stores and arithmetic. SSE2 and NEON hold the four bands of one channel, AVX2 the bands of two channels. Like
+     DelayKernelLoops.h there is deliberately no #pragma once.
+
+  ==============================================================================
+*/
+
+/*Runs samples [start, start + numSamples) of every channel through the chains of all bands at once. Each biquad
+only waits for the one before it in its own chain, so with the channel and section counts constant the chains
+of the channel groups are interleaved and hide each other's latency. The memories stay in locals for the
+whole chunk.*/
+template <typename SampleType, int numChannels, int numSections>
+static void filterChunk (const MultibandDelay::Section* sections, MultibandDelay::SectionState (*states)[MultibandDelay::maxSections],
+                         const SampleType* const* input, int start, int numSamples, FilteredChunk& output)
+{
+    using V = Lanes::V;
+    const int numGroups = (numChannels + Lanes::channels - 1) / Lanes::channels;
+
+    // the first and the last channel of a group. A single channel fills a pair of lanes on its own and is filtered
+    // twice, which costs the same as filtering it alone.
+    auto first = [] (int group) { return group * Lanes::channels; };
+    auto last = [] (int group) { return jmin (group * Lanes::channels + Lanes::channels - 1, numChannels - 1); };
+
+    V z1[numGroups][numSections];
+    V z2[numGroups][numSections];
+
+    for (int group = 0; group < numGroups; ++group)
+    {
+        for (int section = 0; section < numSections; ++section)
+        {
+            z1[group][section] = Lanes::loadChannels (states[first (group)][section].z1, states[last (group)][section].z1);
+            z2[group][section] = Lanes::loadChannels (states[first (group)][section].z2, states[last (group)][section].z2);
+        }
+    }
+
+    for (int sample = 0; sample < numSamples; ++sample)
+    {
+        V x[numGroups];
+
+        for (int group = 0; group < numGroups; ++group)
+            x[group] = Lanes::setChannels ((float)input[first (group)][start + sample], (float)input[last (group)][start + sample]);
+
+        for (int section = 0; section < numSections; ++section)
+        {
+            const MultibandDelay::Section& s = sections[section];
+            const V b0 = Lanes::loadBands (s.b0), b1 = Lanes::loadBands (s.b1), b2 = Lanes::loadBands (s.b2);
+            const V a1 = Lanes::loadBands (s.a1), a2 = Lanes::loadBands (s.a2);
+
+            for (int group = 0; group < numGroups; ++group)
+            {
+                const V y = Lanes::add (Lanes::mul (b0, x[group]), z1[group][section]);
+                z1[group][section] = Lanes::sub (Lanes::add (Lanes::mul (b1, x[group]), z2[group][section]), Lanes::mul (a1, y));
+                z2[group][section] = Lanes::sub (Lanes::mul (b2, x[group]), Lanes::mul (a2, y));
+                x[group] = y;
+            }
+        }
+
+        for (int group = 0; group < numGroups; ++group)
+            Lanes::storeChannels (output[first (group)][sample], output[last (group)][sample], x[group]);
+    }
+
+    for (int group = 0; group < numGroups; ++group)
+    {
+        for (int section = 0; section < numSections; ++section)
+        {
+            Lanes::storeChannels (states[first (group)][section].z1, states[last (group)][section].z1, z1[group][section]);
+            Lanes::storeChannels (states[first (group)][section].z2, states[last (group)][section].z2, z2[group][section]);
+        }
+    }
+
+    Lanes::finish();
+}
+
+template <typename SampleType, int numChannels>
+static FilterKernel<SampleType> getFilterKernelFor (int numSections)
+{
+    switch (numSections)
+    {
+        case 4:  return filterChunk<SampleType, numChannels, 4>;
+        case 6:  return filterChunk<SampleType, numChannels, 6>;
+        default: return filterChunk<SampleType, numChannels, 2>;
+    }
+}
+
+template <typename SampleType>
+static FilterKernel<SampleType> getFilterKernel (int numChannels, int numSections)
+{
+    switch (numChannels)
+    {
+        case 1:  return getFilterKernelFor<SampleType, 1> (numSections);
+        case 4:  return getFilterKernelFor<SampleType, 4> (numSections);
+        case 5:  return getFilterKernelFor<SampleType, 5> (numSections);
+        case 7:  return getFilterKernelFor<SampleType, 7> (numSections);
+        default: return getFilterKernelFor<SampleType, 2> (numSections);
+    }
+}
@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Linear parameter smoothing that works on whole blocks.
+
+     Instead of asking a smoother for the next value inside the sample loop, processBlock asks the ramp
+     to write the value of every sample of the block into a buffer once, and the loop just reads that
+     buffer. When the value isn't moving there is nothing to fill and the loop can use a constant.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+
+class ParameterRamp
+{
+public:
+    /*Sets how long a change takes and allocates room for the largest block that will be filled at once*/
+    void prepare (double sampleRate, double rampLengthSeconds, int maximumBlockSize)
+    {
+        rampLengthSamples = jmax (1, roundToInt (rampLengthSeconds * sampleRate));
+        capacity = jmax (1, maximumBlockSize);
+        ramp.allocate ((size_t)capacity, true);
+        setCurrentAndTargetValue (target);
+    }
+
+    /*Grows the ramp buffer to hold at least maximumBlockSize values. A ramp that is running carries on.*/
+    void setMaximumBlockSize (int maximumBlockSize)
+    {
+        if (maximumBlockSize <= capacity)
+            return;
+
+        capacity = maximumBlockSize;
+        ramp.allocate ((size_t)capacity, true);
+    }
+
+    /*Frees the ramp buffer, prepare has to be called again before the next fillRamp*/
+    void release()
+    {
+        ramp.free();
+        capacity = 0;
+    }
+
+    void setCurrentAndTargetValue (float newValue)
+    {
+        current = target = newValue;
+        step = 0.0f;
+        countdown = 0;
+    }
+
+    /*Starts a new ramp from wherever the value is now. Setting the same target again changes nothing.*/
+    void setTargetValue (float newValue)
+    {
+        if (newValue == target)
+            return;
+
+        target = newValue;
+        countdown = rampLengthSamples;
+        step = (target - current) / (float)countdown;
+    }
+
+    bool isSmoothing() const { return countdown > 0; }
+    int getRemainingSamples() const { return countdown; }
+    float getCurrentValue() const { return current; }
+    float getTargetValue() const { return target; }
+    int getMaximumBlockSize() const { return capacity; }
+
+    /*Writes the value of each of the next numSamples samples (at most getMaximumBlockSize()) into the ramp buffer,
+    moves the smoother on by numSamples and returns the buffer.*/
+    const float* fillRamp (int numSamples)
+    {
+        jassert (numSamples <= capacity);
+
+        const int rampSamples = jmin (numSamples, countdown);
+        const float start = current;
+
+        // every value is computed from the start of the ramp rather than accumulated, so there is no
+        // dependency between iterations and the compiler turns this into a vector loop
+        for (int sample = 0; sample < rampSamples; ++sample)
+            ramp[sample] = start + step * (float)(sample + 1);
+
+        countdown -= rampSamples;
+        current = countdown > 0 ? start + step * (float)rampSamples : target;
+
+        if (rampSamples < numSamples)
+            FloatVectorOperations::fill (ramp + rampSamples, current, numSamples - rampSamples);
+
+        return ramp;
+    }
+
+private:
+    HeapBlock<float> ramp;
+    int capacity = 0;
+    int rampLengthSamples = 1;
+
+    float current = 0.0f;
+    float target = 0.0f;
+    float step = 0.0f;
+    int countdown = 0;
+};
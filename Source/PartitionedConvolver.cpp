@@ -0,0 +1,417 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Uniformly partitioned convolution of the feedback loop, see PartitionedConvolver.h.
+
+  ==============================================================================
+*/
+
+#include "PartitionedConvolver.h"
+
+//==============================================================================
+
+namespace
+{
+    /*Order of the FFT of twice the partition size*/
+    int getFFTOrder (int partitionSize)
+    {
+        int order = 1;
+
+        while ((1 << order) < 2 * partitionSize)
+            ++order;
+
+        return order;
+    }
+
+    /*The FFT writes its bins as interleaved complex numbers, the spectra here keep all the real parts first*/
+    void splitBins (const float* interleaved, float* split, int numBins)
+    {
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            split[bin] = interleaved[2 * bin];
+            split[numBins + bin] = interleaved[2 * bin + 1];
+        }
+    }
+
+    void interleaveBins (const float* split, float* interleaved, int numBins)
+    {
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            interleaved[2 * bin] = split[bin];
+            interleaved[2 * bin + 1] = split[numBins + bin];
+        }
+    }
+
+    /*Bins summed over the partitions at a time. Their sums stay in registers for all the partitions instead of
+    going back to memory after each one.*/
+    const int binsPerBlock = 16;
+
+    /*sum += input * impulse for numPartitions partitions, the input spectra going back in memory by stride from
+    newestInput and the impulse spectra going forward by stride from firstImpulse. With the real and imaginary parts
+    in separate arrays each line is a plain vector loop, several bins per instruction.*/
+    void multiplyAdd (float* sum, const float* newestInput, const float* firstImpulse, int numPartitions, size_t stride, int numBins)
+    {
+        int start = 0;
+
+        for (; start + binsPerBlock <= numBins; start += binsPerBlock)
+        {
+            float sumReal[binsPerBlock], sumImag[binsPerBlock];
+
+            for (int bin = 0; bin < binsPerBlock; ++bin)
+            {
+                sumReal[bin] = sum[start + bin];
+                sumImag[bin] = sum[numBins + start + bin];
+            }
+
+            const float* input = newestInput + start;
+            const float* impulse = firstImpulse + start;
+
+            for (int partition = 0; partition < numPartitions; ++partition, input -= stride, impulse += stride)
+            {
+                for (int bin = 0; bin < binsPerBlock; ++bin)
+                {
+                    sumReal[bin] += input[bin] * impulse[bin] - input[numBins + bin] * impulse[numBins + bin];
+                    sumImag[bin] += input[bin] * impulse[numBins + bin] + input[numBins + bin] * impulse[bin];
+                }
+            }
+
+            for (int bin = 0; bin < binsPerBlock; ++bin)
+            {
+                sum[start + bin] = sumReal[bin];
+                sum[numBins + start + bin] = sumImag[bin];
+            }
+        }
+
+        // the bins left over (at least the one at half the sample rate, there is one more than a power of two)
+        for (; start < numBins; ++start)
+        {
+            const float* input = newestInput + start;
+            const float* impulse = firstImpulse + start;
+
+            for (int partition = 0; partition < numPartitions; ++partition, input -= stride, impulse += stride)
+            {
+                sum[start] += input[0] * impulse[0] - input[numBins] * impulse[numBins];
+                sum[numBins + start] += input[0] * impulse[numBins] + input[numBins] * impulse[0];
+            }
+        }
+    }
+
+    /*output = tail + the FIR over input (the newest samples, the older ones in front of them in memory), with the taps
+    stored oldest first. Each output is a dot product over two contiguous arrays, summed in eight partial sums that
+    don't depend on each other, so the compiler turns the loop into vector code like PingPongDelayAudioProcessor::isInputSilent.*/
+    void applyHead (float* output, const float* input, const float* tail, const float* reversedTaps, int numTaps, int numSamples)
+    {
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const float* x = input + sample - (numTaps - 1);
+            float sums[8] = {};
+            int tap = 0;
+
+            for (; tap + 8 <= numTaps; tap += 8)
+                for (int lane = 0; lane < 8; ++lane)
+                    sums[lane] += reversedTaps[tap + lane] * x[tap + lane];
+
+            for (; tap < numTaps; ++tap)
+                sums[0] += reversedTaps[tap] * x[tap];
+
+            output[sample] = tail[sample] + ((sums[0] + sums[4]) + (sums[1] + sums[5])) + ((sums[2] + sums[6]) + (sums[3] + sums[7]));
+        }
+    }
+}
+
+//==============================================================================
+
+/*The interpolator reads a few samples past the ones it is given, so it gets a copy with zeros behind it.
+The gain is found from the spectrum of the whole response, zero-padded to four times its length so the peak between
+two bins is missed by a fraction of a dB at most. The quiet end of the response is cut, it would only cost
+partitions that add nothing.*/
+AudioBuffer<float> PartitionedConvolver::prepareImpulseResponse (const AudioBuffer<float>& source, double sourceSampleRate, double sampleRate)
+{
+    const int numImpulseChannels = jmin (source.getNumChannels(), (int)DelayKernels::maxChannels);
+    const int sourceLength = source.getNumSamples();
+
+    if (numImpulseChannels == 0 || sourceLength == 0 || sourceSampleRate <= 0.0 || sampleRate <= 0.0)
+        return AudioBuffer<float>();
+
+    const double ratio = sampleRate / sourceSampleRate;
+    const int maximumLength = jmax (1, roundToInt (maximumLengthSeconds * sampleRate));
+    const int resampledLength = jlimit (1, maximumLength, roundToInt ((double)sourceLength * ratio));
+
+    AudioBuffer<float> impulseResponse (numImpulseChannels, resampledLength);
+    HeapBlock<float> padded ((size_t)sourceLength + 8, true);
+
+    for (int channel = 0; channel < numImpulseChannels; ++channel)
+    {
+        if (ratio == 1.0)
+        {
+            impulseResponse.copyFrom (channel, 0, source, channel, 0, resampledLength);
+        }
+        else
+        {
+            FloatVectorOperations::copy (padded.get(), source.getReadPointer (channel), sourceLength);
+            LagrangeInterpolator interpolator;
+            interpolator.process (1.0 / ratio, padded.get(), impulseResponse.getWritePointer (channel), resampledLength);
+        }
+    }
+
+    // the loudest frequency of any channel, all channels get the same gain so their balance stays
+    const int fftSize = 4 * nextPowerOfTwo (resampledLength);
+    dsp::FFT spectrum (getFFTOrder (fftSize / 2));
+    HeapBlock<float> bins (2 * (size_t)fftSize);
+    float peak = 0.0f;
+    float loudestSample = 0.0f;
+
+    for (int channel = 0; channel < numImpulseChannels; ++channel)
+    {
+        FloatVectorOperations::clear (bins.get(), 2 * fftSize);
+        FloatVectorOperations::copy (bins.get(), impulseResponse.getReadPointer (channel), resampledLength);
+        spectrum.performRealOnlyForwardTransform (bins.get(), true);
+
+        for (int bin = 0; bin <= fftSize / 2; ++bin)
+            peak = jmax (peak, bins[2 * bin] * bins[2 * bin] + bins[2 * bin + 1] * bins[2 * bin + 1]);
+
+        const Range<float> range = FloatVectorOperations::findMinAndMax (impulseResponse.getReadPointer (channel), resampledLength);
+        loudestSample = jmax (loudestSample, -range.getStart(), range.getEnd());
+    }
+
+    if (peak <= 0.0f)
+        return AudioBuffer<float>();
+
+    // -90 dB below the loudest sample
+    const float silence = loudestSample * 3.1622776601683795e-5f;
+    int usedLength = 1;
+
+    for (int channel = 0; channel < numImpulseChannels; ++channel)
+    {
+        const float* data = impulseResponse.getReadPointer (channel);
+
+        for (int sample = resampledLength; --sample >= usedLength;)
+        {
+            if (std::abs (data[sample]) > silence)
+            {
+                usedLength = sample + 1;
+                break;
+            }
+        }
+    }
+
+    AudioBuffer<float> normalised (numImpulseChannels, usedLength);
+
+    for (int channel = 0; channel < numImpulseChannels; ++channel)
+        FloatVectorOperations::copyWithMultiply (normalised.getWritePointer (channel), impulseResponse.getReadPointer (channel),
+                                                 1.0f / std::sqrt (peak), usedLength);
+
+    return normalised;
+}
+
+/*The FIR of the first partition costs partitionSize multiply-adds per sample. The frequency domain part costs a
+complex multiply-add per bin and partition once per partition of samples, about four multiply-adds per sample for
+every partition, so a longer response pays off with longer partitions. Picked from the measurements in the README.*/
+int PartitionedConvolver::getPartitionSizeFor (int impulseResponseLength)
+{
+    if (impulseResponseLength <= 4096)
+        return 64;
+
+    if (impulseResponseLength <= 16384)
+        return 128;
+
+    if (impulseResponseLength <= 32768)
+        return 256;
+
+    return 512;
+}
+
+PartitionedConvolver::PartitionedConvolver (const AudioBuffer<float>& impulseResponse, int newNumChannels, int newPartitionSize)
+    : numChannels (jlimit (1, (int)DelayKernels::maxChannels, newNumChannels))
+    , numImpulseChannels (jmax (1, impulseResponse.getNumChannels()))
+    , length (jmax (1, impulseResponse.getNumSamples()))
+    , partitionSize (newPartitionSize > 0 ? nextPowerOfTwo (newPartitionSize) : getPartitionSizeFor (length))
+    , numBins (partitionSize + 1)
+    , headLength (jmin (length, partitionSize))
+    , numTailPartitions ((length - 1) / partitionSize)
+    , fft (getFFTOrder (partitionSize))
+{
+    const size_t fftSize = 2 * (size_t)partitionSize;
+    const size_t spectrumSize = 2 * (size_t)numBins;
+
+    head.allocate ((size_t)numImpulseChannels * (size_t)partitionSize, true);
+    tailSpectra.allocate ((size_t)numImpulseChannels * (size_t)jmax (1, numTailPartitions) * spectrumSize, true);
+    input.allocate ((size_t)numChannels * fftSize, true);
+    inputSpectra.allocate ((size_t)numChannels * (size_t)jmax (1, numTailPartitions) * spectrumSize, true);
+    tails.allocate ((size_t)numChannels * (size_t)partitionSize, true);
+    fftBuffer.allocate (2 * fftSize, true);
+    sum.allocate (spectrumSize, true);
+
+    for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+    {
+        const float* data = impulseResponse.getReadPointer (channel);
+        float* taps = head + (size_t)channel * (size_t)partitionSize;
+
+        for (int tap = 0; tap < headLength; ++tap)
+            taps[tap] = data[headLength - 1 - tap];
+
+        // each partition zero-padded to the FFT size, so its product with a window of two input partitions is
+        // its linear convolution in the second half (overlap-save)
+        for (int partition = 0; partition < numTailPartitions; ++partition)
+        {
+            const int start = (partition + 1) * partitionSize;
+
+            FloatVectorOperations::clear (fftBuffer, (int)(2 * fftSize));
+            FloatVectorOperations::copy (fftBuffer, data + start, jmin (partitionSize, length - start));
+            fft.performRealOnlyForwardTransform (fftBuffer, true);
+            splitBins (fftBuffer, getTailSpectrum (channel, partition), numBins);
+        }
+    }
+}
+
+void PartitionedConvolver::reset()
+{
+    const size_t spectrumSize = 2 * (size_t)numBins;
+
+    FloatVectorOperations::clear (input, numChannels * 2 * partitionSize);
+    FloatVectorOperations::clear (inputSpectra, (int)((size_t)numChannels * (size_t)jmax (1, numTailPartitions) * spectrumSize));
+    FloatVectorOperations::clear (tails, numChannels * partitionSize);
+    position = 0;
+    newestSpectrum = 0;
+}
+
+/*The newest input spectra are copied, as many as both rings hold, so the new response's later partitions get the
+input that was played before the switch*/
+void PartitionedConvolver::copyStateFrom (const PartitionedConvolver& other)
+{
+    reset();
+
+    if (other.numChannels != numChannels || other.partitionSize != partitionSize)
+        return;
+
+    FloatVectorOperations::copy (input, other.input, numChannels * 2 * partitionSize);
+    position = other.position;
+
+    // without partitions in the frequency domain the tail stays silent
+    if (numTailPartitions > 0)
+        FloatVectorOperations::copy (tails, other.tails, numChannels * partitionSize);
+
+    const int numSpectra = jmin (numTailPartitions, other.numTailPartitions);
+    newestSpectrum = jmax (0, numSpectra - 1);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        for (int age = 0; age < numSpectra; ++age)
+        {
+            const int otherSlot = (other.newestSpectrum - age + other.numTailPartitions) % other.numTailPartitions;
+            FloatVectorOperations::copy (getInputSpectrum (channel, newestSpectrum - age),
+                                         other.getInputSpectrum (channel, otherSlot), 2 * numBins);
+        }
+    }
+}
+
+size_t PartitionedConvolver::getSizeInBytes() const
+{
+    const size_t spectrumSize = 2 * (size_t)numBins;
+    const size_t numFloats = (size_t)numImpulseChannels * (size_t)partitionSize
+                           + (size_t)(numImpulseChannels + numChannels) * (size_t)jmax (1, numTailPartitions) * spectrumSize
+                           + (size_t)numChannels * 3 * (size_t)partitionSize
+                           + 4 * (size_t)partitionSize + spectrumSize;
+
+    return sizeof (*this) + numFloats * sizeof (float);
+}
+
+//==============================================================================
+
+/*Each sample gets the tail precomputed for it and the FIR of the first partition over the newest input, up to the
+end of the partition at a time*/
+void PartitionedConvolver::process (float* const* channels, int numSamples)
+{
+    for (int done = 0; done < numSamples;)
+    {
+        const int count = jmin (numSamples - done, partitionSize - position);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* data = channels[channel] + done;
+            float* newest = getInput (channel) + partitionSize + position;
+            const float* taps = head + (size_t)(channel % numImpulseChannels) * (size_t)partitionSize;
+
+            FloatVectorOperations::copy (newest, data, count);
+            applyHead (data, newest, getTail (channel) + position, taps, headLength, count);
+        }
+
+        position += count;
+        done += count;
+
+        if (position == partitionSize)
+        {
+            computeTails();
+            position = 0;
+        }
+    }
+}
+
+/*The FFTs are in float, a double loop is converted a small piece at a time on the stack*/
+void PartitionedConvolver::process (double* const* channels, int numSamples)
+{
+    float converted[DelayKernels::maxChannels][64];
+    float* convertedChannels[DelayKernels::maxChannels];
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        convertedChannels[channel] = converted[channel];
+
+    for (int done = 0; done < numSamples;)
+    {
+        const int count = jmin (numSamples - done, (int)numElementsInArray (converted[0]));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int sample = 0; sample < count; ++sample)
+                converted[channel][sample] = (float)channels[channel][done + sample];
+
+        process (convertedChannels, count);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int sample = 0; sample < count; ++sample)
+                channels[channel][done + sample] = (double)converted[channel][sample];
+
+        done += count;
+    }
+}
+
+/*The window of the last two input partitions goes into the ring of input spectra, then partition j of the response
+is multiplied with the spectrum of the window j partitions old (the newest one for the first partition after the
+head). The second half of the inverse FFT of the sum is the tail of the next partition.*/
+void PartitionedConvolver::computeTails()
+{
+    if (numTailPartitions > 0)
+        newestSpectrum = (newestSpectrum + 1) % numTailPartitions;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* window = getInput (channel);
+
+        if (numTailPartitions > 0)
+        {
+            FloatVectorOperations::copy (fftBuffer, window, 2 * partitionSize);
+            fft.performRealOnlyForwardTransform (fftBuffer, true);
+            splitBins (fftBuffer, getInputSpectrum (channel, newestSpectrum), numBins);
+
+            const int impulseChannel = channel % numImpulseChannels;
+            FloatVectorOperations::clear (sum, 2 * numBins);
+
+            // the ring runs backwards from the newest spectrum to slot 0, then from the last slot back to the newest
+            const size_t stride = 2 * (size_t)numBins;
+            const int numRecent = newestSpectrum + 1;
+            multiplyAdd (sum, getInputSpectrum (channel, newestSpectrum), getTailSpectrum (impulseChannel, 0), numRecent, stride, numBins);
+
+            if (numRecent < numTailPartitions)
+                multiplyAdd (sum, getInputSpectrum (channel, numTailPartitions - 1), getTailSpectrum (impulseChannel, numRecent),
+                             numTailPartitions - numRecent, stride, numBins);
+
+            interleaveBins (sum, fftBuffer, numBins);
+            fft.performRealOnlyInverseTransform (fftBuffer);
+            FloatVectorOperations::copy (getTail (channel), fftBuffer + partitionSize, partitionSize);
+        }
+
+        // the partition just finished becomes the older half of the next window
+        FloatVectorOperations::copy (window, window + partitionSize, partitionSize);
+    }
+}
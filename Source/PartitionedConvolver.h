@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+     Coursework 2 for Advanced Audio Processing - Martynas Kazlauskas
+
+     Convolution of the feedback loop with a short impulse response, for diffuse, smeared ping-pong echoes.
+
+     Like the feedback chain (FeedbackChain.h) it runs over what the delay loop writes into the line, in place,
+     before the read head can reach it. What a channel of the line receives is the echo the ping-pong hands over
+     from the channel before, so every cross-feedback path goes through the impulse response once per repeat and
+     each repeat comes back more smeared than the one before. Delay channel c uses channel c of the impulse response
+     (wrapping around when it has fewer channels), so a stereo response shapes the echoes landing on the left and on
+     the right differently.
+
+     The convolution is uniformly partitioned: the impulse response is cut into partitions of partitionSize samples.
+      - The first partition is applied directly in the time domain, as an FIR over the newest input, so the output
+        of a sample only waits for that sample and the loop gets no latency.
+      - The other partitions go through the frequency domain (overlap-save with FFTs of twice the partition size).
+        Their spectra are computed once when the impulse response is loaded, and the spectra of the last input
+        partitions are kept in a ring (the frequency-domain delay line). Partition j only adds to the output j
+        partitions after its input, so when a partition of input is complete the FFT work for the whole next
+        partition is done at once: one forward FFT of the input, a complex multiply-add per partition, one inverse
+        FFT. While that partition is then played, each sample only adds the precomputed tail to the FIR.
+
+     The impulse response is normalised so that no frequency is louder after it than before, so the loop gain at
+     every frequency stays below the feedback and the loop always decays.
+
+     A convolver is built for one sample rate and channel count and allocates everything in its constructor, which
+     the message thread (or prepareToPlay) calls. The audio thread only calls reset, copyStateFrom and process.
+     ConvolverHandOver passes a new one to the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayKernels.h"
+
+//==============================================================================
+
+class PartitionedConvolver
+{
+public:
+    /*Longest impulse response that is used, longer ones are cut*/
+    static constexpr double maximumLengthSeconds = 1.0;
+
+    /*Turns an impulse response as it was loaded into one for this convolver: resampled from its own sample rate to
+    the processing one, cut to maximumLengthSeconds and normalised. Returns an empty buffer if it is silent.*/
+    static AudioBuffer<float> prepareImpulseResponse (const AudioBuffer<float>& source, double sourceSampleRate, double sampleRate);
+
+    /*Partition size that costs the least for an impulse response of this many samples, see the README*/
+    static int getPartitionSizeFor (int impulseResponseLength);
+
+    /*Builds the convolver for numChannels delay channels from an impulse response prepared by prepareImpulseResponse.
+    A partitionSize of 0 picks it with getPartitionSizeFor. Starts silent.*/
+    PartitionedConvolver (const AudioBuffer<float>& impulseResponse, int numChannels, int partitionSize = 0);
+
+    /*Forgets the input, for a loop that has gone silent or a convolution that is switched on again*/
+    void reset();
+
+    /*Carries the input and the output still to come over from the convolver this one replaces, so switching the
+    impulse response doesn't cut off what is in flight. The tail precomputed for the current partition still comes
+    from the old response. Starts silent if the two don't have the same channels and partition size.*/
+    void copyStateFrom (const PartitionedConvolver& other);
+
+    /*Convolves numSamples samples the delay loop has just written into every channel, in place*/
+    void process (float* const* channels, int numSamples);
+    void process (double* const* channels, int numSamples);
+
+    int getLength() const { return length; }
+    int getPartitionSize() const { return partitionSize; }
+    int getNumChannels() const { return numChannels; }
+    size_t getSizeInBytes() const;
+
+private:
+    /*Computes the tail every channel gets over the next partition, once the current partition of input is complete*/
+    void computeTails();
+
+    int numChannels;
+    int numImpulseChannels;
+    int length;
+    int partitionSize;
+    int numBins;                // partitionSize + 1, the non-negative frequencies of an FFT of 2 * partitionSize
+    int headLength;             // taps of the first partition, applied directly
+    int numTailPartitions;      // partitions applied in the frequency domain
+
+    dsp::FFT fft;
+
+    /*Taps of the first partition of every impulse channel, partitionSize each, oldest first (see applyHead)*/
+    HeapBlock<float> head;
+
+    /*Spectra of the other partitions of every impulse channel, the real parts of a partition's bins followed by the
+    imaginary ones, so the multiply-add runs over plain arrays*/
+    HeapBlock<float> tailSpectra;
+
+    /*Per delay channel: the last two partitions of input, the spectra of the last numTailPartitions windows of input
+    (a ring, newest at newestSpectrum) and the tail for the partition being played*/
+    HeapBlock<float> input;
+    HeapBlock<float> inputSpectra;
+    HeapBlock<float> tails;
+
+    /*2 * FFT size for the transforms, and the sum of the products of one channel*/
+    HeapBlock<float> fftBuffer;
+    HeapBlock<float> sum;
+
+    int position = 0;           // samples of the current partition done
+    int newestSpectrum = 0;
+
+    float* getInput (int channel) const { return input + (size_t)channel * 2 * (size_t)partitionSize; }
+    float* getTail (int channel) const { return tails + (size_t)channel * (size_t)partitionSize; }
+    float* getInputSpectrum (int channel, int slot) const { return inputSpectra + ((size_t)channel * (size_t)numTailPartitions + (size_t)slot) * 2 * (size_t)numBins; }
+    float* getTailSpectrum (int impulseChannel, int partition) const { return tailSpectra + ((size_t)impulseChannel * (size_t)numTailPartitions + (size_t)partition) * 2 * (size_t)numBins; }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PartitionedConvolver)
+};
+
+//==============================================================================
+
+/*Hands a new convolver from the message thread to the audio thread, the way DelayLineResizer hands over delay lines:
+single atomic pointer exchanges, and the audio thread never frees anything. What it retires is freed by the next
+offer, or by the destructor.*/
+class ConvolverHandOver
+{
+public:
+    ConvolverHandOver() {}
+
+    ~ConvolverHandOver()
+    {
+        delete readyConvolver.exchange (nullptr);
+        delete retiredConvolver.exchange (nullptr);
+    }
+
+    /*Not the audio thread. Frees what the audio thread has retired and offers a new convolver, replacing one that
+    hasn't been picked up yet.*/
+    void offer (PartitionedConvolver* convolver)
+    {
+        delete retiredConvolver.exchange (nullptr);
+        delete readyConvolver.exchange (convolver);
+    }
+
+    /*Not the audio thread. Frees everything waiting here, for when the processor is prepared again or released.*/
+    void discard()
+    {
+        delete readyConvolver.exchange (nullptr);
+        delete retiredConvolver.exchange (nullptr);
+    }
+
+    /*Audio thread. Returns the offered convolver, or nullptr. The caller owns it until it passes it to retire().
+    Nothing is handed out while retired memory is still waiting to be freed.*/
+    PartitionedConvolver* take()
+    {
+        if (retiredConvolver.load() != nullptr)
+            return nullptr;
+
+        return readyConvolver.exchange (nullptr);
+    }
+
+    /*Audio thread. Hands back the convolver a new one has replaced.*/
+    void retire (PartitionedConvolver* convolver)
+    {
+        jassert (retiredConvolver.load() == nullptr);
+        retiredConvolver.store (convolver);
+    }
+
+private:
+    std::atomic<PartitionedConvolver*> readyConvolver { nullptr };
+    std::atomic<PartitionedConvolver*> retiredConvolver { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvolverHandOver)
+};
@@ -19,17 +19,50 @@
 /*Initialize the main audio processor class*/
 PingPongDelayAudioProcessorEditor::PingPongDelayAudioProcessorEditor (PingPongDelayAudioProcessor& p)
     : AudioProcessorEditor (&p), processor (p)
+    , levelDisplay (p.levelFeed, p)
+   #if PINGPONG_INSTRUMENTATION
+    , loadOverlay (p.instrumentation)
+   #endif
 {
     //This is where audio data array of the plugin parameters are called in.
     const Array<AudioProcessorParameter*> parameters = processor.getParameters();
     int comboBoxCounter = 0;
+
+    const char* const sectionNames[numSections] = { "", "Taps", "Feedback", "Modulation", "Bands" };
+
+    for (int section = mainSection + 1; section < numSections; ++section) {
+        Component* page = sectionPages.add (new Component());
+        Viewport* viewport = sectionViewports.add (new Viewport());
+        viewport->setViewedComponent (page, false);
+        viewport->setScrollBarsShown (true, false);
+        tabs.addTab (sectionNames[section], Colours::black.withAlpha (0.6f), viewport, false);
+    }
+
+    tabs.setTabBarDepth (tabBarDepth);
+    addAndMakeVisible (tabs);
+
     // Integrating the associating parameter scrolling and ability to modify proportionally with the parameter data. . 
-    int editorHeight = 2 * editorMargin;
     for (int i = 0; i < parameters.size(); ++i) {
         if (const AudioProcessorParameterWithID* parameter =
                 dynamic_cast<AudioProcessorParameterWithID*> (parameters[i])) {
 
-            if (processor.parameters.parameterTypes[i] == "Slider") {
+            // the tap and band sliders go into a grid below the rest of their page, one row of four per tap or band
+            const bool gridParameter = isGridParameter (parameter->paramID);
+            const int section = getSection (parameter->paramID);
+            Component* parent = section == mainSection ? (Component*)this : sectionPages[section - 1];
+
+            if (gridParameter) {
+                Slider* aSlider;
+                sliders.add (aSlider = new Slider());
+                aSlider->setTextValueSuffix (parameter->label);
+                aSlider->setTextBoxStyle (Slider::TextBoxRight, false, tapTextBoxWidth, tapTextBoxHeight);
+
+                sliderAttachments.add (new SliderAttachment (processor.parameters.apvts, parameter->paramID, *aSlider));
+
+                components.add (aSlider);
+            }
+
+            else if (processor.parameters.parameterTypes[i] == "Slider") {
                 Slider* aSlider;
                 sliders.add (aSlider = new Slider());
                 aSlider->setTextValueSuffix (parameter->label);
@@ -43,9 +76,6 @@ PingPongDelayAudioProcessorEditor::PingPongDelayAudioProcessorEditor (PingPongDe
                     new SliderAttachment (processor.parameters.apvts, parameter->paramID, *aSlider));
 
                 components.add (aSlider);
-
-                //making the overall editor height and slider height proportional.
-                editorHeight += sliderHeight;
             }
 
             //======================================
@@ -60,7 +90,6 @@ PingPongDelayAudioProcessorEditor::PingPongDelayAudioProcessorEditor (PingPongDe
                     new ButtonAttachment (processor.parameters.apvts, parameter->paramID, *aButton));
 
                 components.add (aButton);
-                editorHeight += buttonHeight;
             }
 
             //======================================
@@ -77,25 +106,42 @@ PingPongDelayAudioProcessorEditor::PingPongDelayAudioProcessorEditor (PingPongDe
                     new ComboBoxAttachment (processor.parameters.apvts, parameter->paramID, *aComboBox));
 
                 components.add (aComboBox);
-                editorHeight += comboBoxHeight;
             }
 
             //======================================
 
             Label* aLabel;
             labels.add (aLabel = new Label (parameter->name, parameter->name));
-            aLabel->attachToComponent (components.getLast(), true);
-            addAndMakeVisible (aLabel);
+            aLabel->attachToComponent (components.getLast(), ! gridParameter);
+            parent->addAndMakeVisible (aLabel);
 
             components.getLast()->setName (parameter->name);
             components.getLast()->setComponentID (parameter->paramID);
-            addAndMakeVisible (components.getLast());
+            parent->addAndMakeVisible (components.getLast());
         }
     }
 
     //======================================
 
-    editorHeight += components.size() * editorPadding;
+    // the impulse response belongs to the convolution, on the feedback page
+    loadImpulseResponseButton.setButtonText ("Load impulse response...");
+    loadImpulseResponseButton.onClick = [this] { chooseImpulseResponse(); };
+    sectionPages[feedbackSection - 1]->addAndMakeVisible (loadImpulseResponseButton);
+
+    const String impulseResponseName = processor.getImpulseResponseName();
+    impulseResponseLabel.setText (impulseResponseName.isEmpty() ? "No impulse response" : impulseResponseName, dontSendNotification);
+    sectionPages[feedbackSection - 1]->addAndMakeVisible (impulseResponseLabel);
+
+    addAndMakeVisible (levelDisplay);
+
+   #if PINGPONG_INSTRUMENTATION
+    addAndMakeVisible (loadOverlay);
+   #endif
+
+    // the cached layer covers every pixel, so nothing behind the editor has to be painted first
+    setOpaque (true);
+    setResizable (true, true);
+    setResizeLimits (editorMinimumWidth, editorMinimumHeight, editorMaximumWidth, editorMaximumHeight);
     setSize (editorWidth, editorHeight);
 }
 
@@ -103,20 +149,82 @@ PingPongDelayAudioProcessorEditor::~PingPongDelayAudioProcessorEditor()
 {
 }
 
+/*The file is loaded on the message thread when the chooser closes, the processor hands it to the audio thread*/
+void PingPongDelayAudioProcessorEditor::chooseImpulseResponse()
+{
+    impulseResponseChooser.reset (new FileChooser ("Load an impulse response", File(), "*.wav;*.aif;*.aiff;*.flac"));
+
+    impulseResponseChooser->launchAsync (FileBrowserComponent::openMode | FileBrowserComponent::canSelectFiles,
+                                         [this] (const FileChooser& chooser)
+    {
+        const File file = chooser.getResult();
+
+        if (! file.existsAsFile())
+            return;
+
+        const String error = processor.loadImpulseResponse (file);
+        impulseResponseLabel.setText (error.isEmpty() ? processor.getImpulseResponseName() : error, dontSendNotification);
+    });
+}
+
+/*By the start of the ID: "taps" and "tap2time" go on the taps page, "modulationrate" on the modulation page and so on*/
+int PingPongDelayAudioProcessorEditor::getSection (const String& paramID)
+{
+    if (paramID.startsWith ("tap"))
+        return tapsSection;
+
+    if (paramID.startsWith ("band") || paramID.startsWith ("crossover"))
+        return bandsSection;
+
+    if (paramID.startsWith ("modulation"))
+        return modulationSection;
+
+    for (const char* prefix : { "damping", "saturation", "drive", "dcblocker", "convolution" })
+        if (paramID.startsWith (prefix))
+            return feedbackSection;
+
+    return mainSection;
+}
+
+/*"tap2time", "band1width", "crossover1" and so on, but not "taps" or "bands", which stay in the list above*/
+bool PingPongDelayAudioProcessorEditor::isGridParameter (const String& paramID)
+{
+    for (const char* prefix : { "tap", "band", "crossover" })
+        if (paramID.startsWith (prefix) && CharacterFunctions::isDigit (paramID[(int)strlen (prefix)]))
+            return true;
+
+    return false;
+}
+
 //==============================================================================
 
+/*Copies the cached layer. Only the area JUCE asks for is drawn (the clip region), which for a moving slider is
+just the slider.*/
 void PingPongDelayAudioProcessorEditor::paint (Graphics& g)
 {
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (backgroundLayer.isNull() || scale != backgroundLayerScale)
+        renderBackgroundLayer (scale);
+
+    g.drawImage (backgroundLayer, getLocalBounds().toFloat());
+}
+
+/*Everything the old paint() drew on every repaint*/
+void PingPongDelayAudioProcessorEditor::renderBackgroundLayer (float scale)
+{
+    backgroundLayerScale = scale;
+    backgroundLayer = Image (Image::RGB, jmax (1, roundToInt (getWidth() * scale)), jmax (1, roundToInt (getHeight() * scale)), false);
+
+    Graphics g (backgroundLayer);
+    g.addTransform (AffineTransform::scale (scale));
 
     	//introducing a background for the overall background of the vst plugin
     	g.fillAll(juce::Colours::black);
 
-	//introducing a background image for the VST plugin
+	//introducing a background image for the VST plugin (ImageCache keeps the decoded picture, it's only drawn here)
 	Image background = ImageCache::getFromMemory(BinaryData::VST_Image_Back_Small_png, BinaryData::VST_Image_Back_Small_pngSize);
 	g.drawImageAt(background, 0, 0);;
-	
-	//enables to edit using JUCE internal graphic functions on top of the uploaded images
-	background.duplicateIfShared();
     
     	//Draw a simple line 
 	g.setColour(juce::Colours::hotpink);
@@ -147,21 +255,129 @@ void PingPongDelayAudioProcessorEditor::paint (Graphics& g)
 
 void PingPongDelayAudioProcessorEditor::resized()
 {
+    // redrawn at the new size by the next paint()
+    backgroundLayer = Image();
+
     Rectangle<int> r = getLocalBounds().reduced (editorMargin);
-    r = r.removeFromRight (r.getWidth() - labelWidth);
+    r.setTop (layOutSection (mainSection, r.getX(), r.getY(), r.getWidth()));
+    r.removeFromBottom (levelDisplayHeight + editorPadding);
+    tabs.setBounds (r);
+
+    // every viewport already has the size of the tabs' content area, a page is as tall as its controls need
+    for (int section = mainSection + 1; section < numSections; ++section) {
+        Viewport* viewport = sectionViewports[section - 1];
+        const int pageWidth = jmax (0, viewport->getWidth() - viewport->getScrollBarThickness());
+        const int pageHeight = layOutSection (section, editorPadding, editorPadding, pageWidth - 2 * editorPadding);
+
+        sectionPages[section - 1]->setSize (pageWidth, pageHeight + editorPadding);
+    }
+
+    levelDisplay.setBounds (getLocalBounds().reduced (editorMargin).removeFromBottom (levelDisplayHeight));
+
+   #if PINGPONG_INSTRUMENTATION
+    loadOverlay.setBounds (getWidth() - loadOverlayWidth - editorMargin, editorMargin, loadOverlayWidth, loadOverlayHeight);
+    loadOverlay.toFront (false);
+   #endif
+}
+
+int PingPongDelayAudioProcessorEditor::layOutSection (int section, int x, int y, int width)
+{
+    // the list leaves room on the left for the labels attached there
+    const int listX = x + labelWidth;
+    const int listWidth = width - labelWidth;
 
     for (int i = 0; i < components.size(); ++i) {
-        if (Slider* aSlider = dynamic_cast<Slider*> (components[i]))
-            components[i]->setBounds (r.removeFromTop (sliderHeight));
+        if (getSection (components[i]->getComponentID()) != section || isGridParameter (components[i]->getComponentID()))
+            continue;
+
+        int height = sliderHeight;
 
         if (ToggleButton* aButton = dynamic_cast<ToggleButton*> (components[i]))
-            components[i]->setBounds (r.removeFromTop (buttonHeight));
+            height = buttonHeight;
 
         if (ComboBox* aComboBox = dynamic_cast<ComboBox*> (components[i]))
-            components[i]->setBounds (r.removeFromTop (comboBoxHeight));
+            height = comboBoxHeight;
+
+        components[i]->setBounds (listX, y, listWidth, height);
+        y += height + editorPadding;
+    }
+
+    // the impulse response row goes under the convolution switch, its name right of the button
+    if (section == feedbackSection) {
+        Rectangle<int> impulseResponseRow (listX, y, listWidth, comboBoxHeight);
+        loadImpulseResponseButton.setBounds (impulseResponseRow.removeFromLeft (impulseResponseButtonWidth));
+        impulseResponseLabel.setBounds (impulseResponseRow.withTrimmedLeft (editorPadding));
+        y += comboBoxHeight + editorPadding;
+    }
+
+    // the grid uses the whole width, its labels sit above the sliders
+    const int tapColumnWidth = width / tapColumns;
+    int tapColumn = 0;
+
+    for (int i = 0; i < components.size(); ++i) {
+        if (getSection (components[i]->getComponentID()) != section || ! isGridParameter (components[i]->getComponentID()))
+            continue;
+
+        const Rectangle<int> cell (x + tapColumn * tapColumnWidth, y, tapColumnWidth, tapRowHeight);
+        components[i]->setBounds (cell.withTrimmedTop (tapLabelHeight).withTrimmedRight (editorPadding).withHeight (tapTextBoxHeight));
+
+        if (++tapColumn == tapColumns) {
+            tapColumn = 0;
+            y += tapRowHeight;
+        }
+    }
+
+    // the highest band has no crossover above it, so the last row can be short
+    if (tapColumn > 0)
+        y += tapRowHeight;
+
+    return y;
+}
+
+//==============================================================================
+
+#if PINGPONG_INSTRUMENTATION
+PingPongDelayAudioProcessorEditor::LoadOverlay::LoadOverlay (Instrumentation& instrumentationToShow)
+    : instrumentation (instrumentationToShow)
+{
+    setInterceptsMouseClicks (false, false);
+    startTimerHz (4);
+}
+
+/*Recent and worst load as text, and the load histogram as bars (10 % per bar, the last one is 110 % and up)*/
+void PingPongDelayAudioProcessorEditor::LoadOverlay::paint (Graphics& g)
+{
+    const Instrumentation::Stats& stats = instrumentation.getStats();
+
+    g.setColour (Colours::black.withAlpha (0.7f));
+    g.fillRoundedRectangle (getLocalBounds().toFloat(), 4.0f);
+
+    Rectangle<int> r = getLocalBounds().reduced (6);
+    g.setColour (Colours::white);
+    g.setFont (12.0f);
+
+    g.drawText ("load " + String (stats.recentLoad * 100.0, 1) + " %, worst " + String (stats.worstLoad * 100.0, 1) + " %",
+                r.removeFromTop (14), Justification::left);
+    g.drawText (String (stats.recentCyclesPerSample, 0) + " cycles/sample, " + String (stats.numBlocks) + " blocks",
+                r.removeFromTop (14), Justification::left);
+    g.drawText ("overruns " + String (stats.numOverruns) + ", allocating " + String (stats.numAllocatingBlocks)
+                + ", waiting " + String (stats.numWaitingBlocks), r.removeFromTop (14), Justification::left);
+
+    r.removeFromTop (4);
+
+    // bars on a log scale, so a single bad block still shows next to thousands of good ones
+    const double maximum = std::log10 (1.0 + (double)jmax ((int64)1, stats.numBlocks));
+    const int barWidth = r.getWidth() / Instrumentation::Stats::numBins;
+
+    for (int bin = 0; bin < Instrumentation::Stats::numBins; ++bin)
+    {
+        const double height = std::log10 (1.0 + (double)stats.histogram[bin]) / maximum;
+        const int barHeight = roundToInt (height * r.getHeight());
 
-        r = r.removeFromBottom (r.getHeight() - editorPadding);
+        g.setColour (bin >= 10 ? Colours::red : bin >= 7 ? Colours::orange : Colours::hotpink);
+        g.fillRect (r.getX() + bin * barWidth, r.getBottom() - barHeight, barWidth - 1, barHeight);
     }
 }
+#endif
 
 //==============================================================================
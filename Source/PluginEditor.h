@@ -23,6 +23,7 @@
 // in order to activate the functionalities and connect the source files.
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "PluginProcessor.h"
+#include "LevelDisplay.h"
 
 //==============================================================================
 
@@ -46,6 +47,25 @@ public:
 
 
 private:
+    /*Draws everything that never changes (background picture, lines, boxes and text) into backgroundLayer*/
+    void renderBackgroundLayer (float scale);
+
+    /*The original controls stay at the top, every feature added since has a tab of its own below them*/
+    enum { mainSection, tapsSection, feedbackSection, modulationSection, bandsSection, numSections };
+
+    /*Which section a parameter goes in, from its ID*/
+    static int getSection (const String& paramID);
+
+    /*True for the sliders of the extra taps, of the bands and of the crossovers between them*/
+    static bool isGridParameter (const String& paramID);
+
+    /*Lays out the controls of a section from (x, y) down, in the coordinates of the component they are in: first a
+    list with the labels on the left, then the grid. Returns the y below the last row.*/
+    int layOutSection (int section, int x, int y, int width);
+
+    /*Asks for an impulse response file for the convolution mode and loads it*/
+    void chooseImpulseResponse();
+
     //==============================================================================
 
     //Private plugin class has an Access modifiers. 
@@ -55,10 +75,21 @@ Protected needed only when inheritance is involved. Access-specifier can be chan
 
     PingPongDelayAudioProcessor& processor;
 
+    /*The static part of the editor, drawn once at the display's pixel scale and only redrawn when the editor is
+    resized or moves to a screen with another scale. paint() just copies it, and since the editor is opaque a
+    slider that moves only repaints its own area over this image.*/
+    Image backgroundLayer;
+    float backgroundLayerScale = 0.0f;
+
     //the main plugin window parameters and characteristics.
 
     enum {
         editorWidth = 1000,
+        editorHeight = 760,
+        editorMinimumWidth = 800,
+        editorMinimumHeight = 600,
+        editorMaximumWidth = 1600,
+        editorMaximumHeight = 1400,
         editorMargin = 20,
         editorPadding = 20,
 
@@ -68,6 +99,15 @@ Protected needed only when inheritance is involved. Access-specifier can be chan
         buttonHeight = 60,
         comboBoxHeight = 25,
         labelWidth = 100,
+
+        tapColumns = 4,
+        tapLabelHeight = 20,
+        tapTextBoxWidth = 60,
+        tapTextBoxHeight = 25,
+        tapRowHeight = 50,
+
+        impulseResponseButtonWidth = 200,
+        tabBarDepth = 30,
     };
 
     //======================================
@@ -97,6 +137,42 @@ Protected needed only when inheritance is involved. Access-specifier can be chan
     OwnedArray<ButtonAttachment> buttonAttachments;
     OwnedArray<ComboBoxAttachment> comboBoxAttachments;
 
+    /*Loads the impulse response of the convolution mode, the label next to it shows its name or what went wrong.
+    The chooser is kept while it is open.*/
+    TextButton loadImpulseResponseButton;
+    Label impulseResponseLabel;
+    std::unique_ptr<FileChooser> impulseResponseChooser;
+
+    /*One page per section but the main one, each in a viewport of its own so a page taller than its tab scrolls.
+    The tabs only point at the viewports, so they are declared after them and go first.*/
+    OwnedArray<Component> sectionPages;
+    OwnedArray<Viewport> sectionViewports;
+    TabbedComponent tabs { TabbedButtonBar::TabsAtTop };
+
+    /*Meters and bounce display along the bottom, fed by the processor's levelFeed*/
+    LevelDisplay levelDisplay;
+
+    enum { levelDisplayHeight = 120 };
+
+   #if PINGPONG_INSTRUMENTATION
+    /*Load of this instance drawn in the top right corner, only in builds with the block timing switched on*/
+    class LoadOverlay : public Component, private Timer
+    {
+    public:
+        LoadOverlay (Instrumentation&);
+        void paint (Graphics&) override;
+
+    private:
+        void timerCallback() override { repaint(); }
+
+        Instrumentation& instrumentation;
+    };
+
+    LoadOverlay loadOverlay;
+
+    enum { loadOverlayWidth = 230, loadOverlayHeight = 110 };
+   #endif
+
     //==============================================================================
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PingPongDelayAudioProcessorEditor)
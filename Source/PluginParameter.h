@@ -35,10 +35,12 @@ public:
 //==============================================================================
 
 
-/*Plugin Parameter class which has a 'public' status. */
+/*Plugin Parameter class which has a 'public' status.
+The host (or the editor) changes parameters from whatever thread it likes, so the listener callback only stores the
+new value in an atomic. The audio thread loads every parameter once per block and does all of the smoothing itself
+(see ParameterRamp.h), so nothing it reads is ever written by another thread halfway through a block.*/
 class PluginParameter
-    : public LinearSmoothedValue<float> //includes float based linear parameter settings which makes the editing of the VST plugin parameters smoother, more sensitive.
-    , public AudioProcessorValueTreeState::Listener // Receives callbacks when a Value objects from the ValueTreeState changes.
+    : public AudioProcessorValueTreeState::Listener // Receives callbacks when a Value objects from the ValueTreeState changes.
 {
  
 protected: // protected is used to access to class members in the member-list up to the next access specifier ( public or private ) or the end of the class definition
@@ -47,17 +49,17 @@ protected: // protected is used to access to class members in the member-list up
         : parametersManager (parametersManager)
         , callback (callback)
     {
+        // a lock inside the atomic would make the audio thread wait for the message thread
+        jassert (value.is_lock_free());
     }
 
     /*public class for implementing properly functioning value updating of the whole data sets of parameters */
 
 public: 
-    void updateValue (float value)
+    /*Called on the thread that changed the parameter. The callback runs there too, never on the audio thread.*/
+    void updateValue (float newValue)
     {
-        if (callback != nullptr)
-            setCurrentAndTargetValue (callback (value));
-        else
-            setCurrentAndTargetValue (value);
+        value.store (callback != nullptr ? callback (newValue) : newValue, std::memory_order_relaxed);
     }
     // Overwriting the newly modified settings/parameters using 'parameterID' and thus creating a new value.
 
@@ -66,9 +68,18 @@ public:
         updateValue (newValue);
     }
 
+    /*Latest value of the parameter. Wait-free, safe to call from the audio thread.*/
+    float getValue() const noexcept
+    {
+        return value.load (std::memory_order_relaxed);
+    }
+
     PluginParametersManager& parametersManager;
     std::function<float (float)> callback;
     String paramID;
+
+private:
+    std::atomic<float> value { 0.0f };
 };
 
 //==============================================================================
@@ -16,11 +16,34 @@
 
 /*includes all of the headers of the source code*/
 #include "PluginProcessor.h"
-#include "PluginEditor.h"
+#if ! PINGPONG_HEADLESS
+ #include "PluginEditor.h"
+#endif
 #include "PluginParameter.h"
 
 //==============================================================================
 
+/*Anything quieter than this (-90 dBFS) counts as silence, both for the input and for the decaying echoes*/
+static const double silenceThreshold = 3.1622776601683795e-5;
+
+/*How long a program change takes to fade from the old delay time to the new one*/
+static const double programCrossfadeTime = 30e-3;
+
+/*Factory programs: name, balance, delay time (s), feedback, mix. The first one is the parameters' defaults.*/
+static const struct { const char* name; float balance, delayTime, feedback, mix; } factoryPrograms[] =
+{
+    { "Default",        0.25f, 0.1f,   0.7f,  0.1f  },
+    { "Slapback",       0.5f,  0.09f,  0.1f,  0.35f },
+    { "Eighth notes",   0.3f,  0.25f,  0.5f,  0.3f  },
+    { "Quarter notes",  0.3f,  0.5f,   0.45f, 0.3f  },
+    { "Wide bounce",    0.0f,  0.35f,  0.75f, 0.4f  },
+    { "Dub",            0.2f,  0.6f,   0.85f, 0.45f },
+    { "Long ambience",  0.5f,  1.2f,   0.8f,  0.25f },
+    { "Short comb",     0.5f,  0.005f, 0.85f, 0.5f  }
+};
+
+//==============================================================================
+
 
 /*main audio processor class constructor (All classes need at least one constructor)*/
 PingPongDelayAudioProcessor::PingPongDelayAudioProcessor():
@@ -42,9 +65,41 @@ PingPongDelayAudioProcessor::PingPongDelayAudioProcessor():
     , paramDelayTime (parameters, "Delay time", "s", 0.0f, 5.0f, 0.1f)
     , paramFeedback (parameters, "Feedback", "", 0.0f, 0.9f, 0.7f)
     , paramMix (parameters, "Mix", "", 0.0f, 1.0f, 0.1f)
+    , paramInterpolation (parameters, "Interpolation", { "Integer", "Linear", "Lagrange", "Hermite", "Allpass", "Sinc" }, 1)
+    , paramStorage (parameters, "Delay storage", { "32-bit float", "16-bit integer", "16-bit half float", "64-bit float" }, 0)
+    , paramTaps (parameters, "Taps", { "1", "2", "3", "4", "5", "6", "7", "8" }, 0)
+    , paramModulation (parameters, "Modulation", { "Off", "Sine", "Triangle", "Random" }, 0)
+    , paramModulationRate (parameters, "Modulation rate", "Hz", 0.05f, 10.0f, 0.8f)
+    , paramModulationDepth (parameters, "Modulation depth", "ms", 0.0f, 10.0f, 2.0f)
+    , paramModulationPhase (parameters, "Modulation stereo phase", "deg", 0.0f, 180.0f, 90.0f)
+    , paramDamping (parameters, "Damping", { "Off", "One-pole", "Biquad" }, 0)
+    , paramDampingFrequency (parameters, "Damping frequency", "Hz", 500.0f, 20000.0f, 6000.0f)
+    , paramSaturation (parameters, "Saturation", false)
+    , paramDrive (parameters, "Drive", "dB", 0.0f, 24.0f, 6.0f)
+    , paramDCBlocker (parameters, "DC blocker", false)
+    , paramConvolution (parameters, "Convolution", false)
+    , paramBands (parameters, "Bands", { "Off", "2", "3", "4" }, 0)
 {
+    for (int tapNumber = 2; tapNumber <= DelayTaps::maxTaps + 1; ++tapNumber)
+        tapParameters.add (new TapParameters (parameters, tapNumber));
+
+    /*The crossovers are made after the band below them, so the editor lists them between the two bands they split*/
+    static const float crossoverDefaults[MultibandDelay::maxBands - 1] = { 250.0f, 2000.0f, 6000.0f };
+
+    for (int bandNumber = 1; bandNumber <= MultibandDelay::maxBands; ++bandNumber)
+    {
+        bandParameters.add (new BandParameters (parameters, bandNumber));
+
+        if (bandNumber < MultibandDelay::maxBands)
+            crossoverParameters.add (new PluginParameterLogSlider (parameters, "Crossover " + String (bandNumber), "Hz",
+                                                                   40.0f, 16000.0f, crossoverDefaults[bandNumber - 1]));
+    }
+
     parameters.apvts.state = ValueTree (Identifier (getName().removeCharacters ("- ")));
 
+    for (const auto& program : factoryPrograms)
+        programs.add ({ program.name, program.balance, program.delayTime, program.feedback, program.mix });
+
     //ValueTrue - enables to save previous settings/state of the application.
 }
 
@@ -57,106 +112,1120 @@ PingPongDelayAudioProcessor::~PingPongDelayAudioProcessor()
 {
 }
 
+/*By default the taps fall on the eighth notes after the read head's first echo at 120 bpm, odd taps on the left and
+even ones on the right, all at half level and without cross-feed*/
+PingPongDelayAudioProcessor::TapParameters::TapParameters (PluginParametersManager& parameters, int tapNumber)
+    : time (parameters, "Tap " + String (tapNumber) + " time", "s", 0.0f, 5.0f, 0.125f * (float)(tapNumber - 1))
+    , gain (parameters, "Tap " + String (tapNumber) + " gain", "", 0.0f, 1.0f, 0.5f)
+    , pan (parameters, "Tap " + String (tapNumber) + " pan", "", 0.0f, 1.0f, (tapNumber & 1) != 0 ? 0.25f : 0.75f)
+    , crossFeed (parameters, "Tap " + String (tapNumber) + " cross-feed", "", 0.0f, 0.9f, 0.0f)
+{
+}
+
+/*By default the lows repeat slowly in the middle and every band above them a little faster and a little wider,
+so with four bands the bass sits still under a treble that bounces from side to side*/
+PingPongDelayAudioProcessor::BandParameters::BandParameters (PluginParametersManager& parameters, int bandNumber)
+    : time (parameters, "Band " + String (bandNumber) + " time", "s", 0.0f, 5.0f, bandNumber == 1 ? 0.375f : bandNumber == 4 ? 0.125f : 0.25f)
+    , feedback (parameters, "Band " + String (bandNumber) + " feedback", "", 0.0f, 0.9f, 0.65f - 0.05f * (float)bandNumber)
+    , width (parameters, "Band " + String (bandNumber) + " width", "", 0.0f, 1.0f, jmin (1.0f, 0.5f * (float)(bandNumber - 1)))
+{
+}
+
 //==============================================================================
 
 void PingPongDelayAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    /*Hosts call this again whenever their settings change, often while the echoes are still ringing. With the same
+    channels the delay line, the ramps and everything else in flight are kept, see reprepare.*/
+    const DelayKernels::LoopLayout layout = getLoopLayout();
 
-    /*Setting up the initial playback without distortion or sound artifacts. Smoothing the playback time using the formula "1e-3" */
-    const double smoothTime = 1e-3;
-    paramBalance.reset (sampleRate, smoothTime);
-    paramDelayTime.reset (sampleRate, smoothTime);
-    paramFeedback.reset (sampleRate, smoothTime);
-    paramMix.reset (sampleRate, smoothTime);
+    if (preparedSampleRate > 0.0 && layout == loopLayout)
+    {
+        reprepare (sampleRate, samplesPerBlock);
+        return;
+    }
+
+    loopLayout = layout;
+
+    const ParameterSnapshot snapshot = takeParameterSnapshot();
+
+    /*The delay line only holds what the current delay time needs, rounded up to a power of two (plus the
+    interpolation guard) so positions can wrap with a mask instead of a modulo. It follows the delay time
+    while playing, see updateDelayLineSize.*/
+    delayLine.setSize (loopLayout.numChannels, getDelayLineLength (getLongestDelayTime (snapshot) * sampleRate, sampleRate), snapshot.storage);
+    prepareStorageScratch (samplesPerBlock);
 
     //======================================
 
-    /*Setting up max delay time using the int value of the overall sample delay time 
-    and multiplying by float based sample rate.Normalizing to value of 1 in each scenario to have a stable buffer sample playback.*/
-    float maxDelayTime = paramDelayTime.maxValue;
-    delayBufferSamples = (int)(maxDelayTime * (float)sampleRate) + 1;
-    if (delayBufferSamples < 1)
-        delayBufferSamples = 1;
+    prepareRamps (sampleRate, samplesPerBlock);
+
+    interpolation = snapshot.interpolation;
+    taps.setInterpolation (interpolation);
+    std::fill (std::begin (allpassState), std::end (allpassState), 0.0);
+    std::fill (std::begin (fadeAllpassState), std::end (fadeAllpassState), 0.0);
+    feedbackChain.prepare (sampleRate, loopLayout.numChannels);
+    feedbackChain.setSettings (snapshot.feedbackChain);
+    prepareConvolver (sampleRate, loopLayout.numChannels);
+    multiband.prepare (sampleRate, loopLayout, samplesPerBlock, isUsingDoublePrecision());
+    multiband.setSettings (snapshot.multiband, interpolation, true);
+    multiband.jumpToTargets();
+    midiControl.reset();
+
+    // builds the sinc weight table here rather than the first time the audio thread needs it
+    SincInterpolation::getTable();
+
+    balanceRamp.setCurrentAndTargetValue (snapshot.balance);
+    delayTimeRamp.setCurrentAndTargetValue (getDelayTimeInSamples (snapshot.delayTime, sampleRate, interpolation));
+    feedbackRamp.setCurrentAndTargetValue (snapshot.feedback);
+    mixRamp.setCurrentAndTargetValue (snapshot.mix);
+    setTapTargets (snapshot);
+    taps.jumpToTargets();
+
+    // the delay line has just been cleared, so there is no tail to wait for
+    silentSamples = std::numeric_limits<int64>::max();
+
+    preparedSampleRate = sampleRate;
+    updateMemoryUsage();
+}
+
+/*Setting up the initial playback without distortion or sound artifacts. Smoothing the playback time using the formula "1e-3".
+The delay time gets a longer ramp, because moving the read head quickly is heard as a pitch sweep.
+The ramps hold one block of values each, longer host blocks are processed in pieces of maximumBlockSize.
+Every ramp jumps to its target and the program crossfade ends.*/
+void PingPongDelayAudioProcessor::prepareRamps (double sampleRate, int maximumBlockSize)
+{
+    const double smoothTime = 1e-3;
+    const double delaySmoothTime = 50e-3;
+    balanceRamp.prepare (sampleRate, smoothTime, maximumBlockSize);
+    delayTimeRamp.prepare (sampleRate, delaySmoothTime, maximumBlockSize);
+    feedbackRamp.prepare (sampleRate, smoothTime, maximumBlockSize);
+    mixRamp.prepare (sampleRate, smoothTime, maximumBlockSize);
+    programCrossfadeRamp.prepare (sampleRate, programCrossfadeTime, maximumBlockSize);
+    programCrossfadeRamp.setCurrentAndTargetValue (1.0f);
+    taps.prepare (sampleRate, maximumBlockSize, loopLayout, isUsingDoublePrecision());
+    modulation.prepare (sampleRate, loopLayout.numChannels, maximumBlockSize);
+}
+
+/*Room to convert one piece of up to maximumBlockSize samples to and from the storage format, in the precision the
+host asked for. A buffer that already has the right size is left alone.*/
+void PingPongDelayAudioProcessor::prepareStorageScratch (int maximumBlockSize)
+{
+    const int scratchLength = maximumBlockSize + DelayLine::guardSamples;
+    const int numScratchChannels = 2 * loopLayout.numChannels;
+    storageScratch.setSize (isUsingDoublePrecision() ? 0 : numScratchChannels, scratchLength, false, false, true);
+    storageScratchDouble.setSize (isUsingDoublePrecision() ? numScratchChannels : 0, scratchLength, false, false, true);
+}
+
+/*prepareToPlay for an instance that is already playing with the same channels.
+
+A new block size changes nothing: longer blocks are processed in pieces anyway (see processRange), so the buffers
+for a piece only grow, without touching the ramps, when the host promises bigger blocks than before.
+
+A new sample rate keeps the echoes. The history is resampled into a delay line sized for the new rate, so what
+was played a second ago still comes back a second after it was played, and the read head keeps its delay in
+seconds. The ramps jump to their targets, as the audio is resampled under them anyway.
+
+A change of precision only swaps which storage scratch is allocated.*/
+void PingPongDelayAudioProcessor::reprepare (double sampleRate, int samplesPerBlock)
+{
+    const int maximumBlockSize = jmax (samplesPerBlock, balanceRamp.getMaximumBlockSize());
+
+    prepareStorageScratch (maximumBlockSize);
+
+    if (sampleRate == preparedSampleRate)
+    {
+        balanceRamp.setMaximumBlockSize (maximumBlockSize);
+        delayTimeRamp.setMaximumBlockSize (maximumBlockSize);
+        feedbackRamp.setMaximumBlockSize (maximumBlockSize);
+        mixRamp.setMaximumBlockSize (maximumBlockSize);
+        programCrossfadeRamp.setMaximumBlockSize (maximumBlockSize);
+        taps.setMaximumBlockSize (maximumBlockSize, isUsingDoublePrecision());
+        modulation.setMaximumBlockSize (maximumBlockSize);
+        multiband.prepare (sampleRate, loopLayout, maximumBlockSize, isUsingDoublePrecision());
+        updateMemoryUsage();
+        return;
+    }
+
+    const double ratio = sampleRate / preparedSampleRate;
+    const ParameterSnapshot snapshot = takeParameterSnapshot();
+    const double currentDelayTime = (double)delayTimeRamp.getCurrentValue() / preparedSampleRate;
+    const double longestDelayTime = jmax (getLongestDelayTime (snapshot), currentDelayTime,
+                                          (double)taps.getLongestDelay() / preparedSampleRate);
+
+    // a line that was waiting to be swapped in is sized for the old rate
+    delayLineResizer.discardReadyLine();
+
+    DelayLine resampled;
+    resampled.setSize (delayLine.getNumChannels(), getDelayLineLength (longestDelayTime * sampleRate, sampleRate),
+                       delayLine.getFormat());
+    resampled.resampleHistoryFrom (delayLine, ratio);
+    delayLine.swapWith (resampled);
+
+    prepareRamps (sampleRate, maximumBlockSize);
+
+    // the taps keep their delays in seconds like the read head
+    delayTimeRamp.setCurrentAndTargetValue (getDelayTimeInSamples ((float)currentDelayTime, sampleRate, interpolation));
+    taps.scaleDelays (ratio);
+    setRampTargets (snapshot);
+
+    // the recursive interpolator state and the filters of the feedback chain belong to the old sample grid
+    std::fill (std::begin (allpassState), std::end (allpassState), 0.0);
+    feedbackChain.prepare (sampleRate, delayLine.getNumChannels());
+
+    // the convolver's impulse response is resampled to the new rate
+    prepareConvolver (sampleRate, delayLine.getNumChannels());
+
+    // the bands resample their own line and keep their delays in seconds
+    multiband.prepare (sampleRate, loopLayout, maximumBlockSize, isUsingDoublePrecision());
+    multiband.setSettings (snapshot.multiband, interpolation, true);
+
+    if (silentSamples != std::numeric_limits<int64>::max())
+        silentSamples = (int64)((double)silentSamples * ratio);
+
+    preparedSampleRate = sampleRate;
+    updateMemoryUsage();
+}
+
+/*The loop channels of the main input bus. A host that hasn't told the bus its layout gets the default one for the
+number of channels it plays.*/
+DelayKernels::LoopLayout PingPongDelayAudioProcessor::getLoopLayout() const
+{
+    const int numInputChannels = getTotalNumInputChannels();
+    const AudioChannelSet channelSet = getChannelLayoutOfBus (true, 0);
+
+    return DelayKernels::LoopLayout::fromChannelSet (channelSet.size() == numInputChannels
+                                                         ? channelSet : AudioChannelSet::canonicalChannelSet (numInputChannels));
+}
+
+/*A convolver for the new sample rate and channels, from the impulse response as it was loaded. One that was waiting
+to be handed over was built for the old ones.*/
+void PingPongDelayAudioProcessor::prepareConvolver (double sampleRate, int numChannels)
+{
+    const ScopedLock lock (impulseResponseLock);
+
+    convolverHandOver.discard();
+    convolverSampleRate = sampleRate;
+    convolverChannels = numChannels;
+    convolver.reset (createConvolver());
+    convolving = false;
+}
+
+/*nullptr before prepareToPlay and without an impulse response. Called with impulseResponseLock held.*/
+PartitionedConvolver* PingPongDelayAudioProcessor::createConvolver() const
+{
+    if (convolverSampleRate <= 0.0 || impulseResponseSource.getNumSamples() == 0)
+        return nullptr;
+
+    const AudioBuffer<float> impulseResponse = PartitionedConvolver::prepareImpulseResponse (impulseResponseSource, impulseResponseSampleRate,
+                                                                                             convolverSampleRate);
+
+    if (impulseResponse.getNumSamples() == 0)
+        return nullptr;
+
+    return new PartitionedConvolver (impulseResponse, convolverChannels);
+}
+
+/*Longest delay the parameters ask for in seconds: the Delay time parameter, the note held over it and the taps in use.
+While a note holds the delay the line keeps the length of the parameter too, so the old echoes are still there when
+the note is released.*/
+double PingPongDelayAudioProcessor::getLongestDelayTime (const ParameterSnapshot& snapshot) const
+{
+    double longest = jmax ((double)snapshot.delayTime, (double)midiControl.getDelayTime (snapshot.delayTime));
+
+    // the modulation swings the read head up to its depth past the delay time
+    if (snapshot.modulation.shape != DelayModulation::Shape::off)
+        longest += (double)snapshot.modulation.depth * 1.0e-3;
+
+    for (int tap = 0; tap < snapshot.numExtraTaps; ++tap)
+        longest = jmax (longest, (double)snapshot.taps[tap].delayTime);
+
+    return longest;
+}
+
+/*Ring length needed for a delay of delaySamples, never more than the longest delay the parameter allows*/
+int PingPongDelayAudioProcessor::getDelayLineLength (double delaySamples, double sampleRate) const
+{
+    const double maxDelaySamples = (double)paramDelayTime.maxValue * sampleRate + 1.0;
+    return DelayLine::getLengthForDelay (jlimit (1.0, maxDelaySamples, delaySamples));
+}
+
+/*Grows the delay line as soon as the delay time needs more, and shrinks it once it needs a quarter or less
+(to twice what it needs, so small moves of the delay time don't keep resizing it). The new memory is allocated on
+a background thread and swapped in at the start of a later block with the history copied over, so echoes that are
+still in flight carry on in the new memory. Until then the delay time is limited to what the old line can hold.
+The line only ever keeps as much history as it is long, so raising the delay by more than that (plus the length of the
+delay time ramp) reads a stretch of history that was never kept and the echoes of it are silent.
+Changing the storage format goes the same way, the history is converted while it is copied.
+Offline rendering may allocate, so there the line is resized straight away.*/
+void PingPongDelayAudioProcessor::updateDelayLineSize (double delaySamples, DelayStorage::Format format)
+{
+    const double sampleRate = getSampleRate();
+    const double fadeDelay = programCrossfadeRamp.isSmoothing() ? (double)fadeDelaySamples : 0.0;
+    const int neededLength = getDelayLineLength (jmax (delaySamples, (double)delayTimeRamp.getCurrentValue(), fadeDelay,
+                                                       (double)taps.getLongestDelay()), sampleRate);
+    const int numChannels = delayLine.getNumChannels();
+
+    if (DelayLine* resized = delayLineResizer.takeReadyLine())
+    {
+        if (resized->getNumChannels() == numChannels && resized->getFormat() == format && resized->getLength() >= neededLength)
+        {
+            resized->copyHistoryFrom (delayLine);
+            delayLine.swapWith (*resized);
+            updateMemoryUsage();
+        }
+
+        delayLineResizer.retire (resized);
+    }
+
+    const int length = delayLine.getLength();
+    const int wantedLength = neededLength > length ? neededLength
+                           : neededLength * 4 <= length ? neededLength * 2
+                           : length;
+
+    if (wantedLength == length && format == delayLine.getFormat())
+        return;
+
+    if (isNonRealtime())
+    {
+        DelayLine resized;
+        resized.setSize (numChannels, wantedLength, format);
+        resized.copyHistoryFrom (delayLine);
+        delayLine.swapWith (resized);
+        updateMemoryUsage();
+    }
+    else
+    {
+        delayLineResizer.requestLength (numChannels, wantedLength, format);
+    }
+}
+
+/*Everything this instance allocates for audio: the delay line, the ramp buffers, the taps, the LFOs, the convolver and the bands, plus the object itself*/
+void PingPongDelayAudioProcessor::updateMemoryUsage()
+{
+    const size_t rampBytes = (size_t)balanceRamp.getMaximumBlockSize() * sizeof (float) * 5;
+    const size_t scratchBytes = (size_t)storageScratch.getNumChannels() * (size_t)storageScratch.getNumSamples() * sizeof (float)
+                              + (size_t)storageScratchDouble.getNumChannels() * (size_t)storageScratchDouble.getNumSamples() * sizeof (double);
+    const size_t convolverBytes = convolver != nullptr ? convolver->getSizeInBytes() : 0;
+    memoryUsage.store (sizeof (*this) + delayLine.getSizeInBytes() + rampBytes + scratchBytes + taps.getSizeInBytes() + modulation.getSizeInBytes()
+                       + convolverBytes + multiband.getSizeInBytes());
+}
+
+/*Each parameter is a single atomic load, so this never blocks, however hard the host is automating.*/
+PingPongDelayAudioProcessor::ParameterSnapshot PingPongDelayAudioProcessor::takeParameterSnapshot() const
+{
+    ParameterSnapshot snapshot;
+    snapshot.balance = paramBalance.getValue();
+    snapshot.delayTime = paramDelayTime.getValue();
+    snapshot.feedback = paramFeedback.getValue();
+    snapshot.mix = paramMix.getValue();
+    snapshot.interpolation = (InterpolationType)jlimit (0, (int)InterpolationType::sinc, (int)paramInterpolation.getValue());
+    snapshot.storage = (DelayStorage::Format)jlimit (0, (int)DelayStorage::Format::float64, (int)paramStorage.getValue());
+    snapshot.numExtraTaps = jlimit (0, (int)DelayTaps::maxTaps, (int)paramTaps.getValue());
+
+    for (int tap = 0; tap < DelayTaps::maxTaps; ++tap)
+    {
+        const TapParameters& tapParameter = *tapParameters.getUnchecked (tap);
+        snapshot.taps[tap].delayTime = tapParameter.time.getValue();
+        snapshot.taps[tap].gain = tapParameter.gain.getValue();
+        snapshot.taps[tap].pan = tapParameter.pan.getValue();
+        snapshot.taps[tap].crossFeed = tapParameter.crossFeed.getValue();
+    }
+
+    snapshot.modulation.shape = (DelayModulation::Shape)jlimit (0, (int)DelayModulation::Shape::random, (int)paramModulation.getValue());
+    snapshot.modulation.rate = paramModulationRate.getValue();
+    snapshot.modulation.depth = paramModulationDepth.getValue();
+    snapshot.modulation.stereoPhase = paramModulationPhase.getValue();
+
+    snapshot.feedbackChain.damping = (FeedbackChain::Damping)jlimit (0, (int)FeedbackChain::Damping::biquad, (int)paramDamping.getValue());
+    snapshot.feedbackChain.dampingFrequency = paramDampingFrequency.getValue();
+    snapshot.feedbackChain.saturation = paramSaturation.getValue() >= 0.5f;
+    snapshot.feedbackChain.drive = paramDrive.getValue();
+    snapshot.feedbackChain.dcBlocker = paramDCBlocker.getValue() >= 0.5f;
+    snapshot.convolution = paramConvolution.getValue() >= 0.5f;
+
+    // "Off" or 2 to 4 bands
+    const int bandsItem = jlimit (0, MultibandDelay::maxBands - 1, (int)paramBands.getValue());
+    snapshot.multiband.numBands = bandsItem == 0 ? 0 : bandsItem + 1;
 
-    delayBufferChannels = getTotalNumInputChannels();
-    delayBuffer.setSize (delayBufferChannels, delayBufferSamples);
-    delayBuffer.clear();
+    for (int crossover = 0; crossover < MultibandDelay::maxBands - 1; ++crossover)
+        snapshot.multiband.crossovers[crossover] = crossoverParameters.getUnchecked (crossover)->getValue();
 
-    delayWritePosition = 0;
+    for (int band = 0; band < MultibandDelay::maxBands; ++band)
+    {
+        const BandParameters& bandParameter = *bandParameters.getUnchecked (band);
+        snapshot.multiband.bands[band].delayTime = bandParameter.time.getValue();
+        snapshot.multiband.bands[band].feedback = bandParameter.feedback.getValue();
+        snapshot.multiband.bands[band].width = bandParameter.width.getValue();
+    }
+
+    return snapshot;
+}
+
+/*Where the ramps head for: the parameters, with the MIDI note and controllers on top. Called at the start of
+every block and again after every MIDI event that changed something.*/
+void PingPongDelayAudioProcessor::setRampTargets (const ParameterSnapshot& snapshot)
+{
+    balanceRamp.setTargetValue (snapshot.balance);
+    delayTimeRamp.setTargetValue (getDelayTimeInSamples (midiControl.getDelayTime (snapshot.delayTime), getSampleRate(), interpolation));
+    feedbackRamp.setTargetValue (midiControl.getFeedback (snapshot.feedback, paramFeedback.minValue, paramFeedback.maxValue));
+    mixRamp.setTargetValue (midiControl.getMix (snapshot.mix, paramMix.minValue, paramMix.maxValue));
+    setTapTargets (snapshot);
+}
+
+/*The taps follow their parameters only, the MIDI note and controllers move the read head. Their cross-feed is
+limited together with the feedback the read head is heading for, see DelayTaps::setTargets.*/
+void PingPongDelayAudioProcessor::setTapTargets (const ParameterSnapshot& snapshot)
+{
+    const double sampleRate = getSampleRate();
+    float delaySamples[DelayTaps::maxTaps];
+
+    for (int tap = 0; tap < DelayTaps::maxTaps; ++tap)
+        delaySamples[tap] = getDelayTimeInSamples (snapshot.taps[tap].delayTime, sampleRate, interpolation);
+
+    taps.setTargets (snapshot.numExtraTaps, delaySamples, snapshot.taps, feedbackRamp.getTargetValue());
+}
+
+/*A convolver for a newly loaded impulse response takes over the input and the output in flight from the one before,
+so the echoes carry on. A convolution that is switched on starts from silence, whatever it heard when it was last on
+is long gone from the loop.*/
+void PingPongDelayAudioProcessor::updateConvolver (const ParameterSnapshot& snapshot)
+{
+    if (PartitionedConvolver* loaded = convolverHandOver.take())
+    {
+        if (convolver != nullptr)
+        {
+            loaded->copyStateFrom (*convolver);
+            convolverHandOver.retire (convolver.release());
+        }
+
+        convolver.reset (loaded);
+        updateMemoryUsage();
+    }
+
+    const bool wasConvolving = convolving;
+    convolving = snapshot.convolution && convolver != nullptr;
+
+    if (convolving && ! wasConvolving)
+        convolver->reset();
+}
+
+/*The read head jumps to the new delay and the old tap is faded out under it over programCrossfadeTime. A jump on
+its own would click, and the usual ramp would be heard as a pitch sweep. The old tap starts with the interpolator
+state the read head had, so it carries on without a step.*/
+void PingPongDelayAudioProcessor::beginProgramCrossfade (float newDelaySamples)
+{
+    if (newDelaySamples == delayTimeRamp.getCurrentValue())
+        return;
+
+    fadeDelaySamples = delayTimeRamp.getCurrentValue();
+    std::copy (std::begin (allpassState), std::end (allpassState), std::begin (fadeAllpassState));
+
+    delayTimeRamp.setCurrentAndTargetValue (newDelaySamples);
+    programCrossfadeRamp.setCurrentAndTargetValue (0.0f);
+    programCrossfadeRamp.setTargetValue (1.0f);
 }
 
+/*The delay time parameter converted to samples and limited to what the delay line can hold. The newest tap the
+interpolator reads has to be at least one whole sample old, so the read head only ever sees samples that have
+already been written.*/
+float PingPongDelayAudioProcessor::getDelayTimeInSamples (float delayTime, double sampleRate, InterpolationType type) const
+{
+    return jlimit ((float)(getInterpolationTapsAhead (type) + 1), (float)(delayLine.getLength() - DelayLine::guardSamples),
+                   delayTime * (float)sampleRate);
+}
+
+/*Frees the delay line and the buffers, the next prepareToPlay starts again from silence*/
 void PingPongDelayAudioProcessor::releaseResources()
 {
+    delayLineResizer.discardReadyLine();
+    delayLine.release();
+    storageScratch.setSize (0, 0);
+    storageScratchDouble.setSize (0, 0);
+
+    balanceRamp.release();
+    delayTimeRamp.release();
+    feedbackRamp.release();
+    mixRamp.release();
+    programCrossfadeRamp.release();
+    taps.release();
+    modulation.release();
+    multiband.release();
+
+    {
+        const ScopedLock lock (impulseResponseLock);
+        convolverHandOver.discard();
+        convolver.reset();
+        convolving = false;
+        convolverSampleRate = 0.0;
+    }
+
+    preparedSampleRate = 0.0;
+    updateMemoryUsage();
 }
 /*When this method is called, the buffer contains a number of channels which is at least as great as 
 the maximum number of input and output channels that this processor is using. It will be filled with the processor's input data 
 and should be replaced with the processor's output.*/
 void PingPongDelayAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
+    processBlockImpl (buffer, midiMessages);
+}
+
+void PingPongDelayAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages)
+{
+    processBlockImpl (buffer, midiMessages);
+}
+
+bool PingPongDelayAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+/*The parameters and their ramps stay in float whatever the precision, only the audio and the delay loop change type*/
+template <typename SampleType>
+void PingPongDelayAudioProcessor::processBlockImpl (AudioBuffer<SampleType>& buffer, MidiBuffer& midiMessages)
+{
+   #if PINGPONG_INSTRUMENTATION
+    const Instrumentation::BlockScope instrumentationScope (instrumentation, getSampleRate(), buffer.getNumSamples());
+   #endif
+
     ScopedNoDenormals noDenormals;
     /*Controlling the total of */
     const int numInputChannels = getTotalNumInputChannels();
     const int numOutputChannels = getTotalNumOutputChannels();
     const int numSamples = buffer.getNumSamples();
 
+    /*The input is measured for the meters before it is processed in place*/
+    measuringLevels = levelFeed.isReading();
+
+    if (measuringLevels)
+    {
+        blockLevels = LevelFeed::BlockLevels();
+        blockLevels.numSamples = numSamples;
+        LevelFeed::addLevels (blockLevels.input, buffer.getArrayOfReadPointers(), jmin (numInputChannels, buffer.getNumChannels()), numSamples);
+    }
+
     //======================================
 
-    float currentBalance = paramBalance.getNextValue();
-    float currentDelayTime = paramDelayTime.getTargetValue() * (float)getSampleRate();
-    float currentFeedback = paramFeedback.getNextValue();
-    float currentMix = paramMix.getNextValue();
-
-    int localWritePosition = delayWritePosition;
-
-    float* channelDataL = buffer.getWritePointer (0);
-    float* channelDataR = buffer.getWritePointer (1);
-    float* delayDataL = delayBuffer.getWritePointer (0);
-    float* delayDataR = delayBuffer.getWritePointer (1);
-    //numSmaples = in the original data (sound playing)
-    for (int sample = 0; sample < numSamples; ++sample) //increase another sample +1 to continue the loop. Stops until the samples end.
-    {
-        const float inL = (1.0f - currentBalance) * channelDataL[sample]; //currentBalance - 
-        const float inR = currentBalance * channelDataR[sample]; //read sample data and enables to modify with a parameter/slider
-        float outL = 0.0f;
-        float outR = 0.0f;
-        //Initialize as zero to sound distortion, this is stereo initial code
-        
-        float readPosition =
-            fmodf ((float)localWritePosition - currentDelayTime + (float)delayBufferSamples, delayBufferSamples);
-        int localReadPosition = floorf (readPosition); //actually to act at current settings.
-        
-        // Ping-Pong = send the delayed signal of the L channel and send to the R, vice versa. Feedback should lowered before returning. 
-       
-        if (localReadPosition != localWritePosition) //security measure against if delay would be 0. 
-
-			/*Each delay line may be driven by a separate input, or only one input can be used. The output of each delay line, rather than feeding back to itself, attaches to the input of the opposite delay line. In its two-channel
-            configuration, ping-pong delay produces a sound that bounces between left and right channels in a stereo track.*/
+    /*A program the host switched to. The parameters already hold its values when the index arrives, so it's picked
+    up before the snapshot. A change that comes in during a crossfade waits for it to finish, the latest one wins.*/
+    const bool programChanged = ! programCrossfadeRamp.isSmoothing() && pendingProgram.exchange (-1, std::memory_order_acquire) >= 0;
+
+    const ParameterSnapshot snapshot = takeParameterSnapshot();
+
+    /*Switching to an interpolator that reads further ahead can raise the shortest possible delay, the delay time
+    jumps straight to it instead of ramping through values that would read unwritten samples.*/
+    if (snapshot.interpolation != interpolation)
+    {
+        interpolation = snapshot.interpolation;
+        taps.setInterpolation (interpolation);
+        std::fill (std::begin (allpassState), std::end (allpassState), 0.0);
+
+        const float minimumDelay = (float)(getInterpolationTapsAhead (interpolation) + 1);
+
+        if (delayTimeRamp.getCurrentValue() < minimumDelay)
+            delayTimeRamp.setCurrentAndTargetValue (minimumDelay);
+    }
+
+    /*Resized first, the delay time is limited to what the line can hold*/
+    updateDelayLineSize (getLongestDelayTime (snapshot) * getSampleRate(), snapshot.storage);
+
+    if (programChanged && ! multiband.isActive())
+        beginProgramCrossfade (getDelayTimeInSamples (midiControl.getDelayTime (snapshot.delayTime), getSampleRate(), interpolation));
+
+    setRampTargets (snapshot);
+    modulation.setSettings (snapshot.modulation);
+    feedbackChain.setSettings (snapshot.feedbackChain);
+    updateConvolver (snapshot);
+
+    /*The bands take over the whole delay while they are on. The single loop was left standing when they came in,
+    so it starts again from silence once they are switched off rather than replaying echoes from back then.*/
+    const bool wasMultiband = multiband.isActive();
+
+    if (multiband.setSettings (snapshot.multiband, interpolation, isNonRealtime()))
+        updateMemoryUsage();
+
+    if (wasMultiband && ! multiband.isActive())
+    {
+        delayLine.clear();
+        jumpToTargets();
+    }
+
+    /*One delay line channel per channel of the loop, in the loop's order (see DelayKernels::LoopLayout). The LFE
+    isn't one of them and passes through as it came in.*/
+    const int numChannels = loopLayout.numChannels;
+
+    /*Can't happen with the layouts in isBusesLayoutSupported. Should it anyway, the block is left silent rather than
+    with the input in it and whatever the host had in the output channels past the inputs.*/
+    if (! DelayKernels::isSupportedChannelCount (numChannels) || numInputChannels > buffer.getNumChannels())
+    {
+        jassertfalse;
+        buffer.clear();
+        return;
+    }
+
+    SampleType* channelData[DelayKernels::maxChannels] = {};
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        channelData[channel] = buffer.getWritePointer (loopLayout.hostChannels[channel]);
+
+    /*Idle fast path. Once the input has been silent for longer than the echoes take to decay below the threshold,
+    nothing audible is left in the delay line and the delay loop is skipped altogether.*/
+    if (isInputSilent (channelData, numChannels, numSamples))
+    {
+        // a convolved repeat is smeared over the length of the impulse response on top of its delay
+        const double tailSamples = multiband.isActive()
+                                 ? getTailLength (multiband.getLongestDelay(), multiband.getHighestFeedback())
+                                 : getTailLength (jmax (delayTimeRamp.getCurrentValue() + modulation.getLongestDepth(),
+                                                        delayTimeRamp.getTargetValue() + modulation.getLongestDepth(), taps.getLongestDelay())
+                                                      + (convolving ? convolver->getLength() : 0),
+                                                  feedbackRamp.getTargetValue() + taps.getTotalCrossFeed());
+
+        if ((double)silentSamples >= tailSamples)
         {
-            float fraction = readPosition - (float)localReadPosition;
-            float delayed1L = delayDataL[(localReadPosition + 0)];
-            float delayed1R = delayDataR[(localReadPosition + 0)];
-            float delayed2L = delayDataL[(localReadPosition + 1) % delayBufferSamples];
-            float delayed2R = delayDataR[(localReadPosition + 1) % delayBufferSamples];
-            outL = delayed1L + fraction * (delayed2L - delayed1L);
-            outR = delayed1R + fraction * (delayed2R - delayed1R);
-
-            channelDataL[sample] = inL + currentMix * (outL - inL);
-            channelDataR[sample] = inR + currentMix * (outR - inR);
-            delayDataL[localWritePosition] = inL + outR * currentFeedback;
-            delayDataR[localWritePosition] = inR + outL * currentFeedback;
+            // nothing is heard from this block, so its MIDI only has to leave the right values behind
+            MidiBuffer::Iterator events (midiMessages);
+            MidiMessage message;
+            int eventPosition;
+
+            while (events.getNextEvent (message, eventPosition))
+                midiControl.handleMessage (message);
+
+            setRampTargets (snapshot);
+            processIdle (buffer, numSamples);
+
+            for (int channel = numInputChannels; channel < numOutputChannels; ++channel)
+                buffer.clear (channel, 0, numSamples);
+
+            if (measuringLevels)
+                publishLevels (buffer, numSamples);
+
+            return;
         }
 
-        if (++localWritePosition >= delayBufferSamples)
-            localWritePosition -= delayBufferSamples;
+        silentSamples += numSamples;
+    }
+    else
+    {
+        silentSamples = 0;
+    }
+
+    /*The block is cut at every MIDI event. The samples before an event run with the old ramp targets, the event
+    sets the new ones and the rest of the block continues from there, so a note or controller starts to act at
+    its exact sample. The kernels only ever see the stretches between events and never check for events
+    themselves, and a block without MIDI runs as one stretch exactly like before.*/
+    MidiBuffer::Iterator events (midiMessages);
+    MidiMessage message;
+    int eventPosition;
+    int rangeStart = 0;
+
+    while (events.getNextEvent (message, eventPosition))
+    {
+        const int eventSample = jlimit (rangeStart, numSamples, eventPosition);
+        processRange (channelData, numChannels, rangeStart, eventSample);
+        rangeStart = eventSample;
+
+        if (midiControl.handleMessage (message))
+            setRampTargets (snapshot);
     }
 
-    delayWritePosition = localWritePosition;
+    processRange (channelData, numChannels, rangeStart, numSamples);
 
     //======================================
 
     for (int channel = numInputChannels; channel < numOutputChannels; ++channel)
         buffer.clear (channel, 0, numSamples);
 
+    if (measuringLevels)
+        publishLevels (buffer, numSamples);
+}
+
+template <typename SampleType>
+void PingPongDelayAudioProcessor::publishLevels (const AudioBuffer<SampleType>& buffer, int numSamples)
+{
+    LevelFeed::addLevels (blockLevels.output, buffer.getArrayOfReadPointers(), jmin (getTotalNumOutputChannels(), buffer.getNumChannels()), numSamples);
+    levelFeed.push (blockLevels);
+}
+
+/*Reads back what was just written, in pieces that end where the ring wraps. Going through readSamples decodes
+every storage format the same way, a small piece at a time on the stack.*/
+template <typename SampleType>
+void PingPongDelayAudioProcessor::addDelayLevels (int startPosition, int numSamples)
+{
+    SampleType written[128];
+
+    for (int side = 0; side < LevelFeed::numSides; ++side)
+    {
+        const int channel = side == 0 ? loopLayout.left : loopLayout.right;
+
+        for (int done = 0; done < numSamples;)
+        {
+            const int position = (startPosition + done) & delayLine.getMask();
+            const int count = jmin (numSamples - done, delayLine.getLength() - position, (int)numElementsInArray (written));
+
+            delayLine.readSamples (channel, position, written, count);
+            LevelFeed::addLevel (blockLevels.delay[side], written, count);
+            done += count;
+        }
+    }
+}
+
+/*The ramp buffers hold samplesPerBlock values, so a longer stretch (a big host block, or a long gap between two
+MIDI events) is processed in pieces. A piece ends where a program crossfade ends, so the rest of the block goes
+back to the segment loops, and also where the balance, feedback and mix ramps end: a controller
+sets off a 1 ms ramp, and without the cut the rest of the piece would run the ramped loop on values that have
+stopped moving. The ramped loop gives the same numbers for a constant as the plain one, so the output doesn't change.
+The delay ramp isn't cut, see processSubBlock. While taps feed back, the feedback chain is on or the loop is convolved,
+pieces are no longer than the shortest delay either, see getWriteBackPieceLength.*/
+template <typename SampleType>
+void PingPongDelayAudioProcessor::processRange (SampleType* const* channelData, int numChannels, int start, int end)
+{
+    const int maximumBlockSize = balanceRamp.getMaximumBlockSize();
+
+    // the bands cut their own segments, their pieces only end where a ramp does
+    if (multiband.isActive())
+    {
+        for (int blockStart = start; blockStart < end;)
+        {
+            int blockLength = jmin (maximumBlockSize, end - blockStart);
+            const int rampLength = jmax (balanceRamp.getRemainingSamples(), mixRamp.getRemainingSamples(),
+                                         multiband.getRemainingRampSamples());
+
+            if (rampLength > 0)
+                blockLength = jmin (blockLength, rampLength);
+
+            SampleType* subBlockData[DelayKernels::maxChannels];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                subBlockData[channel] = channelData[channel] + blockStart;
+
+            processMultiband (subBlockData, blockLength);
+            blockStart += blockLength;
+        }
+
+        return;
+    }
+
+    for (int blockStart = start; blockStart < end;)
+    {
+        int blockLength = jmin (maximumBlockSize, end - blockStart);
+
+        if (programCrossfadeRamp.isSmoothing())
+        {
+            blockLength = jmin (blockLength, programCrossfadeRamp.getRemainingSamples());
+        }
+        else if (! delayTimeRamp.isSmoothing())
+        {
+            const int rampLength = jmax (balanceRamp.getRemainingSamples(), feedbackRamp.getRemainingSamples(),
+                                         mixRamp.getRemainingSamples());
+
+            if (rampLength > 0)
+                blockLength = jmin (blockLength, rampLength);
+        }
+
+        if (taps.isSending() || feedbackChain.isActive() || convolving)
+            blockLength = jmin (blockLength, getWriteBackPieceLength());
+
+        SampleType* subBlockData[DelayKernels::maxChannels];
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            subBlockData[channel] = channelData[channel] + blockStart;
+
+        processSubBlock (subBlockData, numChannels, blockLength);
+        blockStart += blockLength;
+    }
+}
+
+/*The cross-feeding taps are read before the piece is written, so the piece can't be longer than the shortest of
+them. Their sends are added and the convolution and the feedback chain are run over the ring after the modulated loop
+has written it, so there it can't be longer than the read head's delay either, or the read head would read samples of its own piece
+before they are finished (the segment loop cuts its segments for that itself).*/
+int PingPongDelayAudioProcessor::getWriteBackPieceLength() const
+{
+    int length = taps.isSending() ? taps.getSendDistance() : std::numeric_limits<int>::max();
+
+    if (delayTimeRamp.isSmoothing() || programCrossfadeRamp.isSmoothing() || modulation.isActive())
+    {
+        float shortestDelay = jmin (delayTimeRamp.getCurrentValue(), delayTimeRamp.getTargetValue());
+        int tapsAhead = getInterpolationTapsAhead (interpolation);
+
+        if (programCrossfadeRamp.isSmoothing())
+            shortestDelay = jmin (shortestDelay, fadeDelaySamples);
+
+        // the swept read head reaches its depth closer to the write head, and reads through the sinc
+        if (modulation.isActive())
+        {
+            shortestDelay = jmax ((float)(SincInterpolation::tapsAhead + 1), shortestDelay - modulation.getLongestDepth());
+            tapsAhead = SincInterpolation::tapsAhead;
+        }
+
+        length = jmin (length, (int)shortestDelay - tapsAhead);
+    }
+
+    return jmax (1, length);
+}
+
+/*Compares the mean energy of all input channels with the silence threshold. Eight partial sums keep the
+additions independent of each other, so the compiler can turn the loop into vector code.*/
+template <typename SampleType>
+bool PingPongDelayAudioProcessor::isInputSilent (const SampleType* const* channelData, int numChannels, int numSamples) const
+{
+    double energy = 0.0;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const SampleType* data = channelData[channel];
+        SampleType sums[8] = {};
+        int sample = 0;
+
+        for (; sample + 8 <= numSamples; sample += 8)
+            for (int lane = 0; lane < 8; ++lane)
+                sums[lane] += data[sample + lane] * data[sample + lane];
+
+        for (; sample < numSamples; ++sample)
+            sums[0] += data[sample] * data[sample];
+
+        for (int lane = 0; lane < 8; ++lane)
+            energy += sums[lane];
+    }
+
+    return energy <= silenceThreshold * silenceThreshold * (double)numChannels * numSamples;
+}
+
+/*Time until the echoes have decayed below the silence threshold, in the unit of delayTime. Every repeat comes
+one delay time later and is "feedback" times quieter (the ping-pong only swaps the sides), so the tail is
+log (threshold) / log (feedback) repeats long, plus the first echo.*/
+double PingPongDelayAudioProcessor::getTailLength (double delayTime, double feedback)
+{
+    if (feedback <= 0.0)
+        return delayTime;
+
+    const double repeats = std::ceil (std::log (silenceThreshold) / std::log (jmin (feedback, 0.999)));
+    return delayTime * (repeats + 1.0);
+}
+
+/*The delay line has nothing audible left in it, so only the dry part of the (silent) input is passed on and the
+delay line isn't touched. What is left in it is below the threshold and keeps decaying once processing resumes.
+The smoothers jump to their targets, there is nothing for them to smooth while the delay is idle.*/
+template <typename SampleType>
+void PingPongDelayAudioProcessor::processIdle (AudioBuffer<SampleType>& buffer, int numSamples)
+{
+    jumpToTargets();
+    multiband.jumpToTargets();
+
+    const float balance = balanceRamp.getTargetValue();
+    const float dry = 1.0f - mixRamp.getTargetValue();
+    for (int channel = 0; channel < loopLayout.numChannels; ++channel)
+        buffer.applyGain (loopLayout.hostChannels[channel], 0, numSamples, DelayKernels::getInputGain (loopLayout.sides[channel], balance) * dry);
+}
+
+/*Also used when the bands hand the delay back to the single loop, which was left standing while they ran*/
+void PingPongDelayAudioProcessor::jumpToTargets()
+{
+    balanceRamp.setCurrentAndTargetValue (balanceRamp.getTargetValue());
+    delayTimeRamp.setCurrentAndTargetValue (delayTimeRamp.getTargetValue());
+    feedbackRamp.setCurrentAndTargetValue (feedbackRamp.getTargetValue());
+    mixRamp.setCurrentAndTargetValue (mixRamp.getTargetValue());
+    programCrossfadeRamp.setCurrentAndTargetValue (1.0f);
+    taps.jumpToTargets();
+    modulation.jumpToTargets();
+    std::fill (std::begin (allpassState), std::end (allpassState), 0.0);
+    feedbackChain.reset();
+
+    if (convolver != nullptr)
+        convolver->reset();
+}
+
+/*The balance and the mix are shared with the single loop. Once they stop moving the bands only read the first value
+of their buffers. The meters show the echoes of all bands summed.*/
+template <typename SampleType>
+void PingPongDelayAudioProcessor::processMultiband (SampleType* const* channelData, int numSamples)
+{
+    const bool ramped = balanceRamp.isSmoothing() || mixRamp.isSmoothing();
+    const float* balanceValues = balanceRamp.fillRamp (numSamples);
+    const float* mixValues = mixRamp.fillRamp (numSamples);
+
+    multiband.process (channelData, numSamples, balanceValues, mixValues, ramped);
+
+    if (measuringLevels)
+    {
+        const SampleType* const* echoes = multiband.getEchoes<SampleType>();
+
+        for (int side = 0; side < LevelFeed::numSides; ++side)
+            LevelFeed::addLevel (blockLevels.delay[side], echoes[side == 0 ? loopLayout.left : loopLayout.right], numSamples);
+    }
+}
+
+/*Adds the sends of the cross-feeding taps to what the modulated loop wrote, a small piece at a time through the
+storage format like addDelayLevels*/
+template <typename SampleType>
+void PingPongDelayAudioProcessor::addTapSends (int startPosition, int numSamples)
+{
+    SampleType written[128];
+
+    for (int channel = 0; channel < delayLine.getNumChannels(); ++channel)
+    {
+        const SampleType* send = taps.getSend<SampleType> (channel);
+
+        if (send == nullptr)
+            return;
+
+        for (int done = 0; done < numSamples;)
+        {
+            const int position = (startPosition + done) & delayLine.getMask();
+            const int count = jmin (numSamples - done, delayLine.getLength() - position, (int)numElementsInArray (written));
+
+            delayLine.readSamples (channel, position, written, count);
+            FloatVectorOperations::add (written, send + done, count);
+            delayLine.writeSamples (channel, position, written, count);
+            done += count;
+        }
+    }
+}
+
+/*The convolution and the chain run in place over what the modulated loop wrote, a small piece of every channel at a
+time through the storage format like addTapSends*/
+template <typename SampleType>
+void PingPongDelayAudioProcessor::processWrittenSamples (int startPosition, int numSamples)
+{
+    const int numChannels = delayLine.getNumChannels();
+    SampleType written[DelayKernels::maxChannels][64];
+    SampleType* channels[DelayKernels::maxChannels];
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        channels[channel] = written[channel];
+
+    for (int done = 0; done < numSamples;)
+    {
+        const int position = (startPosition + done) & delayLine.getMask();
+        const int count = jmin (numSamples - done, delayLine.getLength() - position, (int)numElementsInArray (written[0]));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            delayLine.readSamples (channel, position, written[channel], count);
+
+        if (convolving)
+            convolver->process (channels, count);
+
+        if (feedbackChain.isActive())
+            feedbackChain.process (channels, count);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            delayLine.writeSamples (channel, position, written[channel], count);
+
+        done += count;
+    }
+}
+
+template <typename SampleType>
+void PingPongDelayAudioProcessor::processSubBlock (SampleType* const* channelData, int numChannels, int numSamples)
+{
+    const int delayLength = delayLine.getLength();
+    const int delayMask = delayLine.getMask();
+    const DelayStorage::Format format = delayLine.getFormat();
+
+    const int startWritePosition = delayLine.writePosition;
+    int localWritePosition = startWritePosition;
+
+    /*The extra taps that feed back are read before the loop writes the block, see DelayTaps.h*/
+    const bool tapsActive = taps.isActive();
+
+    if (tapsActive)
+    {
+        taps.beginBlock<SampleType> (numSamples);
+        taps.readSends<SampleType> (delayLine, startWritePosition, numSamples);
+    }
+
+    const bool tapsSending = tapsActive && taps.getSend<SampleType> (0) != nullptr;
+
+    /*The convolution and then the feedback chain run over each piece once the loop (and the taps' sends) have written it*/
+    const bool chainActive = feedbackChain.isActive();
+
+    /*While the delay time is moving the read head changes speed every sample, so the ring can't be cut into
+    segments. Those blocks get the per-sample loop that reads the delay from its ramp. During a program crossfade
+    the same loop reads a second tap at the old delay. While the modulation sweeps the read head every channel reads
+    at its own delay, the LFOs' offsets on top of the ramp.*/
+    if (delayTimeRamp.isSmoothing() || programCrossfadeRamp.isSmoothing() || modulation.isActive())
+    {
+        DelayKernels::VibratoBlock<SampleType> block;
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            block.io[channel] = channelData[channel];
+            block.delay[channel] = delayLine.getChannelData (channel);
+        }
+
+        block.sides = loopLayout.sides;
+        block.writePosition = localWritePosition;
+        block.mask = delayMask;
+        block.numSamples = numSamples;
+        block.balance = balanceRamp.fillRamp (numSamples);
+        block.delaySamples = delayTimeRamp.fillRamp (numSamples);
+        block.feedback = feedbackRamp.fillRamp (numSamples);
+        block.mix = mixRamp.fillRamp (numSamples);
+        block.allpassState = allpassState;
+        block.fade = nullptr;
+
+        if (programCrossfadeRamp.isSmoothing())
+        {
+            block.fadeDelaySamples = fadeDelaySamples;
+            block.fade = programCrossfadeRamp.fillRamp (numSamples);
+            block.fadeAllpassState = fadeAllpassState;
+        }
+
+        if (modulation.isActive())
+        {
+            const float* const* offsets = modulation.fill (numSamples);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                block.modulation[channel] = offsets[channel];
+
+            block.minimumDelay = (float)(SincInterpolation::tapsAhead + 1);
+            block.maximumDelay = (float)(delayLength - DelayLine::guardSamples);
+
+            DelayKernels::getVibratoKernel<SampleType> (numChannels, format) (block);
+
+            // the sweep reads through the sinc, an allpass read head starts again from silence once it stops
+            std::fill (std::begin (allpassState), std::end (allpassState), 0.0);
+            std::fill (std::begin (fadeAllpassState), std::end (fadeAllpassState), 0.0);
+        }
+        else if (block.fade != nullptr)
+        {
+            DelayKernels::getCrossfadeKernel<SampleType> (interpolation, numChannels, format) (block);
+        }
+        else
+        {
+            DelayKernels::getModulatedKernel<SampleType> (interpolation, numChannels, format) (block);
+        }
+
+        if (tapsSending)
+            addTapSends<SampleType> (localWritePosition, numSamples);
+
+        if (convolving || chainActive)
+            processWrittenSamples<SampleType> (localWritePosition, numSamples);
+
+        if (localWritePosition + numSamples >= delayLength)
+            delayLine.updateGuard();
+
+        delayLine.writePosition = (localWritePosition + numSamples) & delayMask;
+
+        if (tapsActive)
+            taps.addOutput (delayLine, startWritePosition, channelData, numSamples, block.mix, 0.0f);
+
+        if (measuringLevels)
+            addDelayLevels<SampleType> (startWritePosition, numSamples);
+
+        return;
+    }
+
+    /*The delay is split into whole samples and a fraction. Interpolators that also look at newer samples
+    read from tapsAhead samples closer to the write head.*/
+    const float currentDelayTime = delayTimeRamp.getCurrentValue();
+    const int delayWhole = (int)currentDelayTime;
+    const float delayFraction = currentDelayTime - (float)delayWhole;
+    const int readDistance = delayWhole - getInterpolationTapsAhead (interpolation);
+
+    /*Both loops are picked once for the whole block*/
+    const DelayKernels::Kernel<SampleType> vectorKernel = DelayKernels::getVectorKernel<SampleType> (interpolation, numChannels);
+    const DelayKernels::Kernel<SampleType> scalarKernel = DelayKernels::getScalarKernel<SampleType> (interpolation, numChannels);
+
+    /*Balance, feedback and mix only get per-sample buffers while one of them is actually changing.*/
+    const bool ramped = balanceRamp.isSmoothing() || feedbackRamp.isSmoothing() || mixRamp.isSmoothing();
+    const float currentBalance = balanceRamp.getCurrentValue();
+    const float currentFeedback = feedbackRamp.getCurrentValue();
+    const float currentMix = mixRamp.getCurrentValue();
+    const float* balanceValues = ramped ? balanceRamp.fillRamp (numSamples) : nullptr;
+    const float* feedbackValues = ramped ? feedbackRamp.fillRamp (numSamples) : nullptr;
+    const float* mixValues = ramped ? mixRamp.fillRamp (numSamples) : nullptr;
+
+    /*A delay line stored in any other format than the processing type is processed through scratch buffers: the
+    samples a segment reads (and the guard behind them) are decoded first, the kernel writes into scratch and that
+    is encoded back. Those segments are never longer than the read distance, so nothing they read is written by
+    the segment itself and the vector loop can always be used. The same goes while taps feed back, the loop is
+    convolved or the feedback chain is on: their sends are added to a segment and the convolution and the chain run
+    over it after the loop has written it, so the segment mustn't read any of its own samples.*/
+    const bool converted = format != DelayStorage::getNativeFormat<SampleType>();
+    const int guard = DelayLine::guardSamples;
+    AudioBuffer<SampleType>& scratch = getStorageScratch ((SampleType*)nullptr);
+
+    /*The block is cut wherever the write or the read position wraps around the end of the ring, so inside each
+    segment both move forward through contiguous memory and the loop has no modulo and no wrap checks.
+    That gives at most two segments per wrap.*/
+    for (int segmentStart = 0; segmentStart < numSamples;)
+    {
+        const int localReadPosition = (localWritePosition - readDistance) & delayMask;
+        int segmentLength = jmin (numSamples - segmentStart,
+                                  delayLength - localWritePosition,
+                                  delayLength - localReadPosition);
+
+        DelayKernels::Segment<SampleType> segment;
+
+        if (converted || tapsSending || convolving || chainActive)
+            segmentLength = jmin (segmentLength, readDistance);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            if (converted)
+            {
+                SampleType* scratchRead = scratch.getWritePointer (2 * channel);
+                delayLine.readSamples (channel, localReadPosition - guard, scratchRead, segmentLength + guard);
+                segment.read[channel] = scratchRead + guard;
+                segment.write[channel] = scratch.getWritePointer (2 * channel + 1);
+            }
+            else
+            {
+                SampleType* delayData = delayLine.getWritePointer<SampleType> (channel);
+                segment.read[channel] = delayData + localReadPosition;
+                segment.write[channel] = delayData + localWritePosition;
+            }
+
+            segment.io[channel] = channelData[channel] + segmentStart;
+        }
+
+        segment.sides = loopLayout.sides;
+        segment.numSamples = segmentLength;
+        segment.balance = (SampleType)currentBalance;
+        segment.fraction = (SampleType)delayFraction;
+        segment.feedback = (SampleType)currentFeedback;
+        segment.mix = (SampleType)currentMix;
+        segment.balanceRamp = ramped ? balanceValues + segmentStart : nullptr;
+        segment.feedbackRamp = ramped ? feedbackValues + segmentStart : nullptr;
+        segment.mixRamp = ramped ? mixValues + segmentStart : nullptr;
+        segment.allpassState = allpassState;
+
+        /*Ping-Pong = send the delayed signal of the L channel and send to the R, vice versa.
+        When the newest tap is at least as far back as the segment is long, every sample the segment reads was written
+        before it started, so the recursion can run several samples at a time. Very short delays stay on the scalar loop.*/
+        if (readDistance >= segmentLength)
+            vectorKernel (segment);
+        else
+            scalarKernel (segment);
+
+        if (tapsSending)
+            for (int channel = 0; channel < numChannels; ++channel)
+                FloatVectorOperations::add (segment.write[channel], taps.getSend<SampleType> (channel) + segmentStart, segmentLength);
+
+        if (convolving)
+            convolver->process (segment.write, segmentLength);
+
+        if (chainActive)
+            feedbackChain.process (segment.write, segmentLength);
+
+        if (converted)
+            for (int channel = 0; channel < numChannels; ++channel)
+                delayLine.writeSamples (channel, localWritePosition, scratch.getReadPointer (2 * channel + 1), segmentLength);
+
+        segmentStart += segmentLength;
+        localWritePosition = (localWritePosition + segmentLength) & delayMask;
+
+        if (localWritePosition == 0)
+            delayLine.updateGuard();
+    }
+
+    delayLine.writePosition = localWritePosition;
+
+    if (tapsActive)
+        taps.addOutput (delayLine, startWritePosition, channelData, numSamples, mixValues, currentMix);
+
+    if (measuringLevels)
+        addDelayLevels<SampleType> (startWritePosition, numSamples);
 }
 
 //==============================================================================
@@ -168,17 +1237,112 @@ void PingPongDelayAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiB
 
 //==============================================================================
 
+/*Only the first PartitionedConvolver::maximumLengthSeconds of the file are read, the rest would be cut anyway*/
+String PingPongDelayAudioProcessor::loadImpulseResponse (const File& file)
+{
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor (file));
+
+    if (reader == nullptr)
+        return "Can't read " + file.getFileName();
+
+    const int64 maximumLength = (int64)std::ceil (PartitionedConvolver::maximumLengthSeconds * reader->sampleRate);
+    const int length = (int)jmin (reader->lengthInSamples, maximumLength);
+    const int numChannels = jmin ((int)reader->numChannels, (int)DelayKernels::maxChannels);
+
+    if (length <= 0 || numChannels <= 0)
+        return file.getFileName() + " is empty";
+
+    AudioBuffer<float> impulseResponse (numChannels, length);
+    reader->read (&impulseResponse, 0, length, 0, true, true);
+
+    if (! setImpulseResponse (impulseResponse, reader->sampleRate, file.getFileNameWithoutExtension()))
+        return file.getFileName() + " is silent";
+
+    const ScopedLock lock (impulseResponseLock);
+    impulseResponseFile = file;
+    return {};
+}
+
+/*The convolver is built here, off the audio thread, and handed over to be picked up at the start of a block*/
+bool PingPongDelayAudioProcessor::setImpulseResponse (const AudioBuffer<float>& impulseResponse, double sourceSampleRate, const String& name)
+{
+    const AudioBuffer<float> prepared = PartitionedConvolver::prepareImpulseResponse (impulseResponse, sourceSampleRate, sourceSampleRate);
+
+    if (prepared.getNumSamples() == 0)
+        return false;
+
+    const ScopedLock lock (impulseResponseLock);
+
+    impulseResponseSource.makeCopyOf (impulseResponse);
+    impulseResponseSampleRate = sourceSampleRate;
+    impulseResponseName = name;
+    impulseResponseFile = File();
+    impulseResponseSeconds.store ((double)prepared.getNumSamples() / sourceSampleRate);
+
+    if (PartitionedConvolver* newConvolver = createConvolver())
+        convolverHandOver.offer (newConvolver);
+
+    return true;
+}
+
+String PingPongDelayAudioProcessor::getImpulseResponseName() const
+{
+    const ScopedLock lock (impulseResponseLock);
+    return impulseResponseName;
+}
+
+//==============================================================================
+
+/*The state is a small binary record instead of the parameter tree as XML, so saving and loading hundreds of
+instances doesn't build and parse a document for each of them. Little-endian, as MemoryOutputStream writes it:
+
+    int32          stateMagic ("PPDS")
+    uint8          version
+    compressed int current program
+    compressed int number of parameters
+    per parameter: the parameter ID (UTF-8, zero terminated) and its value as a float32 in the parameter's own units
+    version 2:     the full path of the impulse response file of the convolution mode (UTF-8, zero terminated,
+                   empty if none was loaded from a file)
+
+Later versions only ever add fields at the end, so any version can be read by a reader that knows an older one.
+Parameters are found by ID and stored in real units, so adding parameters or changing a range keeps old states valid.*/
+static const uint32 stateMagic = 0x53445050;
+static const int stateVersion = 2;
+
 /*MemoryBlock is a class to hold a resizable block of raw data*/
 void PingPongDelayAudioProcessor::getStateInformation (MemoryBlock& destData)
 {
-    //records all the parameter data into a raw data file. This converts it into xml format from there to binary to get raw parameter data.
-    auto state = parameters.apvts.copyState();
-    std::unique_ptr<XmlElement> xml (state.createXml());
-    copyXmlToBinary (*xml, destData);
+    Array<RangedAudioParameter*> stateParameters;
+
+    for (auto* parameter : getParameters())
+        if (auto* rangedParameter = dynamic_cast<RangedAudioParameter*> (parameter))
+            stateParameters.add (rangedParameter);
+
+    MemoryOutputStream stream (destData, false);
+    stream.writeInt ((int)stateMagic);
+    stream.writeByte ((char)stateVersion);
+    stream.writeCompressedInt (currentProgram.load());
+    stream.writeCompressedInt (stateParameters.size());
+
+    for (auto* parameter : stateParameters)
+    {
+        stream.writeString (parameter->paramID);
+        stream.writeFloat (parameter->convertFrom0to1 (parameter->getValue()));
+    }
+
+    const ScopedLock lock (impulseResponseLock);
+    stream.writeString (impulseResponseFile.getFullPathName());
 }
 
+/*Reads the binary state, or the XML of the parameter tree that earlier versions saved*/
 void PingPongDelayAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
+    if (readBinaryState (data, sizeInBytes))
+        return;
+
     std::unique_ptr<XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
 
     if (xmlState.get() != nullptr)
@@ -186,16 +1350,70 @@ void PingPongDelayAudioProcessor::setStateInformation (const void* data, int siz
             parameters.apvts.replaceState (ValueTree::fromXml (*xmlState));
 }
 
+bool PingPongDelayAudioProcessor::readBinaryState (const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes < 5 || ByteOrder::littleEndianInt (data) != stateMagic)
+        return false;
+
+    MemoryInputStream stream (data, (size_t)sizeInBytes, false);
+    stream.readInt();
+
+    const int version = stream.readByte();
+
+    if (version < 1)
+        return false;
+
+    const int program = stream.readCompressedInt();
+    const int numParameters = stream.readCompressedInt();
+
+    // IDs this version doesn't know are skipped, parameters the state doesn't have keep their values
+    for (int i = 0; i < numParameters && ! stream.isExhausted(); ++i)
+    {
+        const String paramID = stream.readString();
+        setParameterValue (paramID, stream.readFloat());
+    }
+
+    if (isPositiveAndBelow (program, programs.size()))
+        currentProgram.store (program);
+
+    // an impulse response file that has gone missing leaves the one in use alone
+    if (version >= 2 && ! stream.isExhausted())
+    {
+        const File impulseResponse (stream.readString());
+
+        if (impulseResponse.existsAsFile())
+            loadImpulseResponse (impulseResponse);
+    }
+
+    return true;
+}
+
+void PingPongDelayAudioProcessor::setParameterValue (const String& paramID, float value)
+{
+    if (RangedAudioParameter* parameter = parameters.apvts.getParameter (paramID))
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+}
+
 //==============================================================================
 
+/*Headless builds (the benchmark and other command-line tools) define PINGPONG_HEADLESS so the editor and its
+binary data don't need to be compiled in.*/
 AudioProcessorEditor* PingPongDelayAudioProcessor::createEditor()
 {
+   #if PINGPONG_HEADLESS
+    return nullptr;
+   #else
     return new PingPongDelayAudioProcessorEditor (*this);
+   #endif
 }
 
 bool PingPongDelayAudioProcessor::hasEditor() const
 {
+   #if PINGPONG_HEADLESS
+    return false;
+   #else
     return true; // (change this to false if you choose to not supply an editor)
+   #endif
 }
 
 //==============================================================================
@@ -208,9 +1426,14 @@ bool PingPongDelayAudioProcessor::isBusesLayoutSupported (const BusesLayout& lay
     return true;
   #else
     // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != AudioChannelSet::stereo())
+    // Every layout here has its own delay loop (see DelayKernels.h), the echoes go round its speakers and skip the LFE.
+    const AudioChannelSet output = layouts.getMainOutputChannelSet();
+
+    if (output != AudioChannelSet::mono()
+     && output != AudioChannelSet::stereo()
+     && output != AudioChannelSet::quadraphonic()
+     && output != AudioChannelSet::create5point1()
+     && output != AudioChannelSet::create7point1())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -260,35 +1483,77 @@ bool PingPongDelayAudioProcessor::isMidiEffect() const
    #endif
 }
 
+/*How long the echoes take to decay below -90 dBFS after the input stops, so the host knows when it may suspend the plugin*/
 double PingPongDelayAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    const ParameterSnapshot snapshot = takeParameterSnapshot();
+
+    if (snapshot.multiband.numBands > 0)
+    {
+        double longest = 0.0;
+
+        for (int band = 0; band < snapshot.multiband.numBands; ++band)
+            longest = jmax (longest, getTailLength (snapshot.multiband.bands[band].delayTime, snapshot.multiband.bands[band].feedback));
+
+        return longest;
+    }
+
+    double delayTime = snapshot.delayTime;
+    double loopGain = snapshot.feedback;
+
+    if (snapshot.modulation.shape != DelayModulation::Shape::off)
+        delayTime += (double)snapshot.modulation.depth * 1.0e-3;
+
+    for (int tap = 0; tap < snapshot.numExtraTaps; ++tap)
+    {
+        delayTime = jmax (delayTime, (double)snapshot.taps[tap].delayTime);
+        loopGain += snapshot.taps[tap].crossFeed;
+    }
+
+    if (snapshot.convolution)
+        delayTime += impulseResponseSeconds.load();
+
+    return getTailLength (delayTime, jmin (loopGain, (double)DelayTaps::maximumLoopGain));
 }
 
 //==============================================================================
 
 int PingPongDelayAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return programs.size();
 }
 
 int PingPongDelayAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram.load();
 }
 
+/*Called by the host, usually on the message thread. The parameters are set here so the host and the editor show
+the program, the audio thread only gets the index and crossfades to the new delay time (see beginProgramCrossfade).*/
 void PingPongDelayAudioProcessor::setCurrentProgram (int index)
 {
+    if (! isPositiveAndBelow (index, programs.size()))
+        return;
+
+    const Program& program = programs.getReference (index);
+    setParameterValue (paramBalance.paramID, program.balance);
+    setParameterValue (paramDelayTime.paramID, program.delayTime);
+    setParameterValue (paramFeedback.paramID, program.feedback);
+    setParameterValue (paramMix.paramID, program.mix);
+
+    currentProgram.store (index);
+    pendingProgram.store (index, std::memory_order_release);
 }
 
 const String PingPongDelayAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return isPositiveAndBelow (index, programs.size()) ? programs.getReference (index).name : String();
 }
 
 void PingPongDelayAudioProcessor::changeProgramName (int index, const String& newName)
 {
+    if (isPositiveAndBelow (index, programs.size()))
+        programs.getReference (index).name = newName;
 }
 
 //==============================================================================
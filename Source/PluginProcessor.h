@@ -15,6 +15,18 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "PluginParameter.h"
+#include "DelayLine.h"
+#include "DelayLineResizer.h"
+#include "DelayKernels.h"
+#include "DelayTaps.h"
+#include "DelayModulation.h"
+#include "FeedbackChain.h"
+#include "PartitionedConvolver.h"
+#include "MultibandDelay.h"
+#include "ParameterRamp.h"
+#include "MidiControl.h"
+#include "LevelFeed.h"
+#include "Instrumentation.h"
 
 //==============================================================================
 
@@ -37,6 +49,10 @@ the instance of the object.*/
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
     void processBlock (AudioSampleBuffer&, MidiBuffer&) override;
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+
+    /*Both precisions run the same templated code, so hosts that process in double don't have to convert*/
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
 
@@ -87,13 +103,32 @@ the instance of the object.*/
 
     //==============================================================================
     
-    /*int values of delay parameters (samples,channels,sound position) for the plugin*/
+    /*power-of-two ring buffer holding the delayed samples of every channel and the current write position*/
+
+
+    DelayLine delayLine;
+
+    /*Bytes of audio memory this instance currently uses (delay line, ramp buffers and the processor itself). Safe to call from any thread.*/
+    size_t getMemoryUsage() const { return memoryUsage.load(); }
 
+    /*Message thread. Loads the impulse response of the convolution mode from an audio file (see PartitionedConvolver.h).
+    Returns an error message, or an empty string if it worked.*/
+    String loadImpulseResponse (const File& file);
 
-    AudioSampleBuffer delayBuffer;
-    int delayBufferSamples;
-    int delayBufferChannels;
-    int delayWritePosition;
+    /*Not the audio thread. Uses an impulse response that is already in memory, recorded at sourceSampleRate. Returns
+    false if it is silent. It isn't saved with the state, only one loaded from a file is.*/
+    bool setImpulseResponse (const AudioBuffer<float>& impulseResponse, double sourceSampleRate, const String& name);
+
+    /*Name of the impulse response in use, empty if none has been loaded*/
+    String getImpulseResponseName() const;
+
+    /*Input, delay line and output levels of every block while an editor is open (see LevelFeed.h)*/
+    LevelFeed levelFeed;
+
+   #if PINGPONG_INSTRUMENTATION
+    /*Timing of every block, shown by the editor's load overlay (see Instrumentation.h)*/
+    Instrumentation instrumentation;
+   #endif
 
     //======================================
 
@@ -106,8 +141,250 @@ the instance of the object.*/
     PluginParameterLinSlider paramFeedback;
     PluginParameterLinSlider paramMix;
 
+    //Chooses how the read head interpolates between samples (order of the items matches InterpolationType)
+    PluginParameterComboBox paramInterpolation;
+
+    //Sample format of the delay line (order of the items matches DelayStorage::Format)
+    PluginParameterComboBox paramStorage;
+
+    //How many taps read the delay line: the ping-pong read head plus up to DelayTaps::maxTaps extra ones
+    PluginParameterComboBox paramTaps;
+
+    /*Time, gain, pan and cross-feed of one extra tap ("Tap 2 time" and so on, tap 1 is the read head)*/
+    struct TapParameters
+    {
+        TapParameters (PluginParametersManager& parameters, int tapNumber);
+
+        PluginParameterLinSlider time;
+        PluginParameterLinSlider gain;
+        PluginParameterLinSlider pan;
+        PluginParameterLinSlider crossFeed;
+    };
+
+    OwnedArray<TapParameters> tapParameters;
+
+    //Sweeps the read head (see DelayModulation.h): LFO shape (order of the items matches DelayModulation::Shape), rate, depth and stereo phase
+    PluginParameterComboBox paramModulation;
+    PluginParameterLogSlider paramModulationRate;
+    PluginParameterLinSlider paramModulationDepth;
+    PluginParameterLinSlider paramModulationPhase;
+
+    //The feedback chain (see FeedbackChain.h): damping lowpass and its frequency, the soft clipper and its drive, DC blocker
+    PluginParameterComboBox paramDamping;
+    PluginParameterLogSlider paramDampingFrequency;
+    PluginParameterToggle paramSaturation;
+    PluginParameterLinSlider paramDrive;
+    PluginParameterToggle paramDCBlocker;
+
+    //Convolves the loop with the loaded impulse response
+    PluginParameterToggle paramConvolution;
+
+    //Splits the delay into bands with loops of their own (see MultibandDelay.h), "Off" runs the single loop
+    PluginParameterComboBox paramBands;
+
+    /*Time, feedback and width of one band of the multiband mode ("Band 1 time" and so on, band 1 is the lowest)*/
+    struct BandParameters
+    {
+        BandParameters (PluginParametersManager& parameters, int bandNumber);
+
+        PluginParameterLinSlider time;
+        PluginParameterLinSlider feedback;
+        PluginParameterLinSlider width;
+    };
+
+    OwnedArray<BandParameters> bandParameters;
+
+    /*Frequency between a band and the one above it ("Crossover 1" is between bands 1 and 2)*/
+    OwnedArray<PluginParameterLogSlider> crossoverParameters;
+
 private:
     //==============================================================================
 
+    /*Both processBlock overloads end up here*/
+    template <typename SampleType>
+    void processBlockImpl (AudioBuffer<SampleType>& buffer, MidiBuffer& midiMessages);
+
+    /*Runs the delay over samples [start, end) of the block, in pieces of at most one prepared block*/
+    template <typename SampleType>
+    void processRange (SampleType* const* channelData, int numChannels, int start, int end);
+
+    /*Runs the delay over at most one prepared block of samples*/
+    template <typename SampleType>
+    void processSubBlock (SampleType* const* channelData, int numChannels, int numSamples);
+
+    /*Runs the bands of the multiband mode over at most one prepared block of samples*/
+    template <typename SampleType>
+    void processMultiband (SampleType* const* channelData, int numSamples);
+
+    template <typename SampleType>
+    void processIdle (AudioBuffer<SampleType>& buffer, int numSamples);
+
+    /*The single loop's smoothers jump to their targets and its filters and interpolators forget what they had*/
+    void jumpToTargets();
+
+    /*Longest piece processRange may hand over while taps feed back into the delay line or the feedback chain is on*/
+    int getWriteBackPieceLength() const;
+
+    /*Adds the taps' cross-feed to numSamples samples the modulated loop has written from ring index startPosition*/
+    template <typename SampleType>
+    void addTapSends (int startPosition, int numSamples);
+
+    /*Runs the convolution and the feedback chain over numSamples samples the modulated loop has written from ring
+    index startPosition*/
+    template <typename SampleType>
+    void processWrittenSamples (int startPosition, int numSamples);
+
+    template <typename SampleType>
+    bool isInputSilent (const SampleType* const* channelData, int numChannels, int numSamples) const;
+
+    static double getTailLength (double delayTime, double feedback);
+
+    /*Measures the output into blockLevels and hands the block's levels to the editor*/
+    template <typename SampleType>
+    void publishLevels (const AudioBuffer<SampleType>& buffer, int numSamples);
+
+    /*Widens blockLevels.delay by the numSamples samples written into the delay line from ring index startPosition*/
+    template <typename SampleType>
+    void addDelayLevels (int startPosition, int numSamples);
+
+    /*A factory program: the values of the four sliders, kept ready as numbers so switching never parses anything.
+    The interpolation and the delay storage are quality settings, programs leave them alone.*/
+    struct Program
+    {
+        String name;
+        float balance;
+        float delayTime;
+        float feedback;
+        float mix;
+    };
+
+    /*Moves every parameter to value (in the parameter's own units) and tells the host*/
+    void setParameterValue (const String& paramID, float value);
+
+    /*Compact binary state, see getStateInformation. Returns false if the data isn't in that format.*/
+    bool readBinaryState (const void* data, int sizeInBytes);
+
+    /*Starts the crossfade from the delay the read head is at to the one the new program asks for*/
+    void beginProgramCrossfade (float newDelaySamples);
+
+    /*Every parameter, loaded once at the start of a block so the whole block works with the same values*/
+    struct ParameterSnapshot
+    {
+        float balance;
+        float delayTime;
+        float feedback;
+        float mix;
+        InterpolationType interpolation;
+        DelayStorage::Format storage;
+        int numExtraTaps;
+        DelayTaps::TapSettings taps[DelayTaps::maxTaps];
+        DelayModulation::Settings modulation;
+        FeedbackChain::Settings feedbackChain;
+        bool convolution;
+        MultibandDelay::Settings multiband;
+    };
+
+    ParameterSnapshot takeParameterSnapshot() const;
+    void setRampTargets (const ParameterSnapshot& snapshot);
+    void setTapTargets (const ParameterSnapshot& snapshot);
+    float getDelayTimeInSamples (float delayTime, double sampleRate, InterpolationType type) const;
+    double getLongestDelayTime (const ParameterSnapshot& snapshot) const;
+    int getDelayLineLength (double delaySamples, double sampleRate) const;
+    void updateDelayLineSize (double delaySamples, DelayStorage::Format format);
+    void updateMemoryUsage();
+    void prepareRamps (double sampleRate, int maximumBlockSize);
+    void prepareStorageScratch (int maximumBlockSize);
+    void reprepare (double sampleRate, int samplesPerBlock);
+    DelayKernels::LoopLayout getLoopLayout() const;
+    void prepareConvolver (double sampleRate, int numChannels);
+    PartitionedConvolver* createConvolver() const;
+    void updateConvolver (const ParameterSnapshot& snapshot);
+
+    /*The input channels the loop runs on and their order, set when the processor is prepared*/
+    DelayKernels::LoopLayout loopLayout;
+
+    /*Per-sample smoothing of the parameters, owned by the audio thread. The delay time ramp is in samples.*/
+    ParameterRamp balanceRamp;
+    ParameterRamp delayTimeRamp;
+    ParameterRamp feedbackRamp;
+    ParameterRamp mixRamp;
+
+    /*Interpolation used by the current block, and the recursive state of the allpass interpolator (one per channel)*/
+    InterpolationType interpolation = InterpolationType::linear;
+    double allpassState[DelayKernels::maxChannels] = {};
+
+    /*Programs, the one the host picked last, and one it picked that the audio thread hasn't crossfaded to yet (-1 if
+    none). The message thread sets the parameters to the program's values before it hands the index over.*/
+    Array<Program> programs;
+    std::atomic<int> currentProgram { 0 };
+    std::atomic<int> pendingProgram { -1 };
+
+    /*A program change fades from a tap at the old delay to one at the new delay (0 to 1, see DelayKernels::CrossfadeBlock).
+    The old tap keeps its own allpass state.*/
+    ParameterRamp programCrossfadeRamp;
+    float fadeDelaySamples = 0.0f;
+    double fadeAllpassState[DelayKernels::maxChannels] = {};
+
+    /*The extra taps of the multi-tap mode and their smoothing, owned by the audio thread*/
+    DelayTaps taps;
+
+    /*LFOs of the read head, owned by the audio thread*/
+    DelayModulation modulation;
+
+    /*Damping, saturation and DC blocking of what the delay loop writes, owned by the audio thread*/
+    FeedbackChain feedbackChain;
+
+    /*The bands of the multiband mode, owned by the audio thread. While it is on the single loop isn't run.*/
+    MultibandDelay multiband;
+
+    /*Convolution of what the delay loop writes, owned by the audio thread (nullptr without an impulse response), and
+    whether it runs in the current block. New convolvers come from the message thread through convolverHandOver.*/
+    std::unique_ptr<PartitionedConvolver> convolver;
+    ConvolverHandOver convolverHandOver;
+    bool convolving = false;
+
+    /*The impulse response as it was loaded, its sample rate, its name and the file it came from (none if it was set
+    from memory), and the sample rate and channels convolvers are built for (0 before prepareToPlay). Kept so a
+    convolver can be built again at another sample rate. Guarded by impulseResponseLock, which the audio thread never
+    takes.*/
+    CriticalSection impulseResponseLock;
+    AudioBuffer<float> impulseResponseSource;
+    double impulseResponseSampleRate = 0.0;
+    String impulseResponseName;
+    File impulseResponseFile;
+    double convolverSampleRate = 0.0;
+    int convolverChannels = 0;
+
+    /*Length of the impulse response in seconds, for the tail length*/
+    std::atomic<double> impulseResponseSeconds { 0.0 };
+
+    /*Held note and controller values from the MIDI input, see MidiControl.h*/
+    MidiControl midiControl;
+
+    /*Levels of the block being processed, only measured while levelFeed has a reader*/
+    LevelFeed::BlockLevels blockLevels;
+    bool measuringLevels = false;
+
+    /*Samples of silent input in a row, counted until the tail has decayed. Only used by the idle fast path.*/
+    int64 silentSamples = 0;
+
+    DelayLineResizer delayLineResizer;
+
+    /*Sample rate of the last prepareToPlay, 0 before the first one and after releaseResources*/
+    double preparedSampleRate = 0.0;
+
+    /*Copies of the segment being processed, in the processing precision, when the delay line is stored in another
+    format: two per channel, what it reads (with the guard in front) and what it writes. Only the one for the
+    precision the host prepared is allocated.*/
+    AudioBuffer<float> storageScratch;
+    AudioBuffer<double> storageScratchDouble;
+
+    AudioBuffer<float>& getStorageScratch (float*) { return storageScratch; }
+    AudioBuffer<double>& getStorageScratch (double*) { return storageScratchDouble; }
+
+    std::atomic<size_t> memoryUsage { 0 };
+
+    //==============================================================================
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PingPongDelayAudioProcessor)
 };